@@ -1,720 +1,1220 @@
-#include <iostream> 
-#include <unordered_set> 
-#include <vector> 
-#include <algorithm> 
+#include <unordered_set>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <chrono>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <time.h>
 #include <inttypes.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#define BENCH_WITH_PERF
+#endif
 #include "btas.h"
+#include "btas_mltree.h"
 #include "data_io.h"
 
-std::vector<uint32_t> removeDuplicates(const uint32_t* arr, size_t size, size_t *output_elems) {  
-    std::unordered_set<uint32_t> uniqueElements(arr, arr + size);  
-    std::vector<uint32_t> newArray(uniqueElements.begin(), uniqueElements.end());
-    *output_elems = newArray.size();
-    return newArray;  
-}  
+#define BENCH_SOURCE_MEM    0
+#define BENCH_SOURCE_BIN    1
+#define BENCH_SOURCE_CSV    2
+
+#define BENCH_DEFAULT_WARMUP    1
+#define BENCH_DEFAULT_REPS      3
+#define BENCH_DEFAULT_SEED      20240601
+#define BENCH_DEFAULT_DATASETS  "random,growing"
+#define BENCH_SUITE_REPS        5
+#define BENCH_SUITE_THRESHOLD   10  /* Percent of the baseline median */
+
+/* Hardware (and a few software) counters read around every engine run */
+#define PERF_CYCLES         0
+#define PERF_INSTRUCTIONS   1
+#define PERF_LLC_MISSES     2
+#define PERF_DTLB_MISSES    3
+#define PERF_BRANCH_MISSES  4
+#define PERF_PAGE_FAULTS    5
+#define NUM_PERF_COUNTERS   6
+
+typedef uint32_t* (*export_func)(const uint32_t *, const uint64_t, uint64_t *, int *, btas_stats *);
+typedef uint64_t (*count_func)(const uint32_t *, const uint64_t, int *, btas_stats *);
+typedef uint32_t* (*file_export_func)(const char *, const char *, uint64_t *, int *);
+typedef uint64_t (*file_count_func)(const char *, const char *, int *);
+typedef int (*dataset_func)(uint32_t *, uint64_t, uint32_t, uint64_t);
 
 /**
- * @brief
- *  usage: ./command argv[1] argv[2] CMD_FLAGS
- * 
- * @param [in]
- *  argv[1] indicates the size (number of elems) of the input array
- *  argv[2] indicates the maximun of the random number generated
- *      NOTE: argv[2] doesn't affect the Round 2 of benchmark
- *  CMD_FLAGS: 
- *    --brute  : Execute brute algorithms (might cause OOM if the dataset is large!)
- *    --fio-bin: Execute the file I/O benchmark with binary reading
- *    --fio-csv: Execute the file I/O benchmark with csv reading
- *      NOTE: By default, the CMD_FLAGS are off, meaning that the brute algos would 
- *            not be executed, and no file I/O triggered.
- * 
- * @returns
- *   0 : if everything goes well
- *   1 : if command args not enough
- *   3 : illegal arguments found
- *   5 : Failed to allocate memory for input array
- *   7 : Failed to write data to the binary file
- *   9 : Failed to write data to the csv files
- *  
+ * An engine under benchmark. In the FIO modes, the engines without a file
+ * routine are timed as import_1d_u32() + the in-memory routine.
  */
-int main(int argc, char** argv) {
-    
-    int with_brute = 0, with_fio = 0, with_count = 0;
+typedef struct {
+    const char *name;
+    export_func export_fn;
+    count_func count_fn;            /* NULL if no count variant */
+    file_export_func file_export_fn;/* NULL if no streaming file variant */
+    file_count_func file_count_fn;
+    int is_brute;                   /* Only runs with --brute or if named */
+} bench_engine;
+
+typedef struct {
+    const char *name;
+    dataset_func generate;
+} bench_dataset;
+
+typedef struct {
+    const uint32_t *arr;
+    uint64_t num_elems;
+    int source;
+    const char *file;
+    const char *type;
+} bench_input;
+
+/* A call traced inside an engine, labelled with the benchmark run */
+typedef struct {
+    btas_trace trace;
+    const char *dataset;
+    const char *engine;
+} trace_record;
+
+typedef struct {
+    std::vector<trace_record> records;
+    const char *dataset;            /* Labels of the run in progress */
+    const char *engine;
+} trace_sink;
+
+typedef struct {
+    int fds[NUM_PERF_COUNTERS];     /* -1 if the counter is unavailable */
+    int num_open;
+} perf_counters;
+
+/* Options of a benchmark session, shared by all the datasets run */
+typedef struct {
+    int with_brute;
+    int with_fio;                   /* 0 - memory, 1 - binary file, 2 - csv file */
+    int with_count;
+    int with_mem;
+    const char *engine_list;        /* NULL - all (but the brute ones) */
+    uint32_t warmup;
+    uint32_t reps;
+    const perf_counters *perf;      /* NULL if --perf is off */
+    trace_sink *traces;
+} bench_options;
+
+/* A cell of the scenario suite: the datasets run at one {size, randomness} */
+typedef struct {
+    const char *datasets;
+    uint64_t num_elems;
     uint32_t rand_max;
-    dup_idx_list *dup_idx_list1 = NULL;
-    dup_idx_list *dup_idx_list2 = NULL;
-    char data_file_bin[512] = "", data_file_csv[512] = "";
-    int err_flag = 0;
-    uint64_t num_elems = 0, num_elems_out = 0, num_elems_read = 0, num_elems_out_idx = 0, uniq_count = 0;
-    clock_t start, end;
-    uint32_t *out_brute_opt = NULL;
-    uint32_t *out_brute = NULL;
-    uint32_t *out_ht_stree = NULL;
-    uint32_t *out_ht_dyn = NULL;
-    uint32_t *out_bit_dyn = NULL;
-    uint32_t *out_bit_stc = NULL;
-    out_idx *out_bit_dyn_idx = NULL;
-    uint32_t *arr_input = NULL;
+    int is_large;                   /* Skipped by --suite=quick */
+} bench_scenario;
 
-    std::vector<uint32_t> cpp_output;
+/* A result of a baseline file, keyed by the cell, engine and mode */
+typedef struct {
+    std::string key;
+    double wall_median;
+} baseline_entry;
 
-    if(argc < 3) {
-        printf("ERROR: not enough args. USAGE: ./command argv[1] argv[2] CMD_FLAGS \n");
-        return 1;
+typedef struct {
+    double wall_sec;
+    double cpu_sec;
+    double perf_counts[NUM_PERF_COUNTERS]; /* < 0 if not counted */
+    btas_stats stats;
+    uint64_t num_uniq;
+    int err_flag;
+} bench_sample;
+
+typedef struct {
+    std::string dataset;
+    std::string engine;
+    std::string mode;
+    std::string source;
+    uint64_t num_elems;
+    uint32_t rand_max;
+    uint64_t seed;
+    uint32_t reps;
+    double wall_median;
+    double wall_min;
+    double wall_p95;
+    double cpu_median;
+    double melems_per_sec;
+    double perf_per_elem[NUM_PERF_COUNTERS]; /* < 0 if not counted */
+    btas_stats stats;           /* All 0 if the engine doesn't report them */
+    uint64_t peak_rss;          /* Bytes, 0 if unknown */
+    uint64_t num_uniq;
+    int err_flag;
+} bench_result;
+
+static const char *perf_counter_names[NUM_PERF_COUNTERS] = {
+    "cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses", "page_faults"
+};
+
+static uint32_t* cpp_unordered_set(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    (void)stats;
+    std::unordered_set<uint32_t> uniq_elems(input_arr, input_arr + num_elems);
+    uint32_t *output_arr = (uint32_t *)malloc(sizeof(uint32_t) * (uniq_elems.size() + 1));
+    *err_flag = (output_arr == NULL) ? -1 : 0;
+    *num_elems_out = uniq_elems.size();
+    if(output_arr != NULL) {
+        std::copy(uniq_elems.begin(), uniq_elems.end(), output_arr);
     }
-    if(cmd_flag_parser(argc, argv, "--brute") == 0) {
-        with_brute = 1;
+    return output_arr;
+}
+
+static uint32_t* btas_idx_export(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    dup_idx_list *dup_list = NULL;
+    out_idx *output_idx = fui_bitmap_idx(input_arr, num_elems, num_elems_out, err_flag, &dup_list, stats);
+    free(output_idx);
+    free_dup_idx_list(dup_list);
+    return NULL;
+}
+
+/* BTAS_CTX reuses one context across the runs, as a caller of many batches would. */
+static bitmap_ctx bench_ctx;
+static int bench_ctx_ready = 0;
+
+static uint32_t* btas_ctx_export(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    if(!bench_ctx_ready && (*err_flag = bitmap_ctx_init(&bench_ctx)) != 0) {
+        *num_elems_out = 0;
+        return NULL;
     }
-    if(cmd_flag_parser(argc, argv, "--fio-bin") == 0) {
-        with_fio = 1;
+    bench_ctx_ready = 1;
+    return fui_bitmap_ctx(&bench_ctx, input_arr, num_elems, num_elems_out, err_flag, stats);
+}
+
+static uint64_t btas_ctx_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
+    if(!bench_ctx_ready && (*err_flag = bitmap_ctx_init(&bench_ctx)) != 0) {
+        return 0;
     }
-    else {
-        if(cmd_flag_parser(argc, argv, "--fio-csv") == 0) {
-            with_fio = 2;
+    bench_ctx_ready = 1;
+    return fui_bitmap_ctx_count(&bench_ctx, input_arr, num_elems, err_flag, stats);
+}
+
+/* Drop the context after the runs of an engine, so its branches don't stay resident for the next ones. */
+static void release_bench_ctx(void) {
+    if(bench_ctx_ready) {
+        bitmap_ctx_free(&bench_ctx);
+        bench_ctx_ready = 0;
+    }
+}
+
+static int dataset_random(uint32_t *arr, uint64_t num_elems, uint32_t rand_max, uint64_t seed) {
+    return generate_random_arr_seed(arr, num_elems, rand_max, seed);
+}
+
+static int dataset_growing(uint32_t *arr, uint64_t num_elems, uint32_t rand_max, uint64_t seed) {
+    (void)rand_max;
+    (void)seed;
+    return generate_growing_arr(arr, num_elems);
+}
+
+static int dataset_zipf(uint32_t *arr, uint64_t num_elems, uint32_t rand_max, uint64_t seed) {
+    return generate_zipf_arr(arr, num_elems, rand_max, 0.99, seed);
+}
+
+static int dataset_clustered(uint32_t *arr, uint64_t num_elems, uint32_t rand_max, uint64_t seed) {
+    (void)rand_max;
+    return generate_clustered_arr(arr, num_elems, 16, seed);
+}
+
+static int dataset_nearly_sorted(uint32_t *arr, uint64_t num_elems, uint32_t rand_max, uint64_t seed) {
+    (void)rand_max;
+    return generate_nearly_sorted_arr(arr, num_elems, 10, seed);
+}
+
+static int dataset_reverse(uint32_t *arr, uint64_t num_elems, uint32_t rand_max, uint64_t seed) {
+    (void)rand_max;
+    (void)seed;
+    return generate_reverse_sorted_arr(arr, num_elems);
+}
+
+static const bench_engine bench_engines[] = {
+    {"CPP_UNSORTED_SET", cpp_unordered_set, NULL, NULL, NULL, 0},
+    {"BTAS_DYN", fui_bitmap_dyn, fui_bitmap_dyn_count, dedup_file_u32, dedup_file_u32_count, 0},
+    {"BTAS_CTX", btas_ctx_export, btas_ctx_count, NULL, NULL, 0},
+    {"BTAS_IDX", btas_idx_export, NULL, NULL, NULL, 0},
+    {"BTAS_MLTREE", fui_bitmap_mltree, fui_bitmap_mltree_count, NULL, NULL, 0},
+    {"BTAS_STC", fui_bitmap_stc, fui_bitmap_stc_count, NULL, NULL, 0},
+    {"HTBL", fui_htable, fui_htable_count, NULL, NULL, 0},
+    {"HTBL_DYN", fui_htable_dyn, fui_htable_dyn_count, NULL, NULL, 0},
+    {"HTBL_SWISS", fui_htable_swiss, fui_htable_swiss_count, NULL, NULL, 0},
+    {"RADIX", fui_radix, fui_radix_count, NULL, NULL, 0},
+    {"BRUTE_OPT", fui_brute_opt, fui_brute_opt_count, NULL, NULL, 1},
+    {"BRUTE_ORIG", fui_brute, fui_brute_count, NULL, NULL, 1},
+};
+
+static const bench_dataset bench_datasets[] = {
+    {"random", dataset_random},
+    {"growing", dataset_growing},
+    {"zipf", dataset_zipf},
+    {"clustered", dataset_clustered},
+    {"nearly_sorted", dataset_nearly_sorted},
+    {"reverse", dataset_reverse},
+};
+
+/**
+ * The scenario suite. The first 3 cells are the ones of the tables in
+ * TECHNICAL_REVIEW.md ({100k, 2M}, {10M, 200M}, {100M, 4B}), the others run
+ * the new distributions at the middle size. The zipf cell uses 1M keys.
+ */
+static const bench_scenario bench_suite[] = {
+    {"random,growing", 100000, 2000000, 0},
+    {"random,growing", 10000000, 200000000, 0},
+    {"random,growing", 100000000, 4000000000U, 1},
+    {"zipf", 10000000, 1000000, 0},
+    {"clustered,nearly_sorted,reverse", 10000000, 200000000, 0},
+};
+
+#define NUM_BENCH_ENGINES   (sizeof(bench_engines) / sizeof(bench_engine))
+#define NUM_BENCH_DATASETS  (sizeof(bench_datasets) / sizeof(bench_dataset))
+#define NUM_BENCH_SCENARIOS (sizeof(bench_suite) / sizeof(bench_scenario))
+
+/**
+ * @brief Get the value of an option given as --option=value
+ *
+ * @returns
+ *   NULL if the option is not specified
+ *   Otherwise the pointer to the value
+ */
+static const char* get_option_value(int argc, char **argv, const char *option) {
+    size_t option_len = strlen(option);
+    for(int i = 1; i < argc; i++) {
+        if(strncmp(argv[i], option, option_len) == 0 && argv[i][option_len] == '=') {
+            return argv[i] + option_len + 1;
         }
     }
-    if(cmd_flag_parser(argc, argv, "--count") == 0) {
-        with_count = 1;
+    return NULL;
+}
+
+static int get_u32_option(int argc, char **argv, const char *option, uint32_t default_value, uint32_t *value) {
+    const char *value_str = get_option_value(argc, argv, option);
+    *value = default_value;
+    if(value_str == NULL) {
+        return 0;
     }
-    if(string_to_u64_num(argv[1], &num_elems) != 0 || string_to_u32_num(argv[2], &rand_max) != 0) {
-        printf("ERROR: arguments illegal. Make sure they are plain positive numbers and < 4,294,967,296.\n");
-        return 3;
+    return (string_to_u32_num(value_str, value) == 0) ? 0 : -1;
+}
+
+/* A 64-bit option: plain decimal digits, rejected on overflow. */
+static int get_u64_option(int argc, char **argv, const char *option, uint64_t default_value, uint64_t *value) {
+    const char *value_str = get_option_value(argc, argv, option);
+    uint64_t result = 0;
+    *value = default_value;
+    if(value_str == NULL) {
+        return 0;
     }
-    printf("INPUT_ELEMS:\t%" PRIu64 "\nRANDOM_MAX:\t%u\n\n",num_elems, rand_max);
-    
-    uint32_t *arr_gen = (uint32_t *)malloc(sizeof(uint32_t) * num_elems);
-    if(arr_gen == NULL) {
-        printf("ERROR: Failed to allocate memory for input array.\n");
-        return 5;
+    if(*value_str == '\0') {
+        return -1;
     }
-    
-    printf("Generating a random array for benchmarking ...\n");
-    generate_random_input_arr(arr_gen, num_elems, rand_max);
-    if(with_fio != 0) {
-        printf("Writing data to files ...\n");
-        snprintf(data_file_bin, 512, "random_%s_%s.bin", argv[1], argv[2]);
-        if(export_1d_u32(data_file_bin, "", arr_gen, num_elems) != 0) {
-            printf("ERROR: Failed to export the data to 'random_..._....bin'.\n");
-            free(arr_gen);
-            return 7;
+    for(const char *ptr = value_str; *ptr != '\0'; ptr++) {
+        if(*ptr < '0' || *ptr > '9' || result > (UINT64_MAX - (uint64_t)(*ptr - '0')) / 10) {
+            return -1;
         }
-        snprintf(data_file_csv, 512, "random_%s_%s.csv", argv[1], argv[2]);
-        if(export_1d_u32(data_file_csv, "csv", arr_gen, num_elems) != 0) {
-            printf("ERROR: Failed to export the data to 'random_..._....csv'.\n");
-            free(arr_gen);
-            return 9;
+        result = result * 10 + (uint64_t)(*ptr - '0');
+    }
+    *value = result;
+    return 0;
+}
+
+/* Check whether name is an item of a comma-separated list (case-insensitive). */
+static int name_in_list(const char *name, const char *list) {
+    size_t name_len = strlen(name);
+    const char *item = list;
+    while(*item != '\0') {
+        const char *item_end = strchr(item, ',');
+        size_t item_len = (item_end == NULL) ? strlen(item) : (size_t)(item_end - item);
+        if(item_len == name_len) {
+            size_t i = 0;
+            while(i < name_len && tolower((unsigned char)item[i]) == tolower((unsigned char)name[i])) {
+                i++;
+            }
+            if(i == name_len) {
+                return 1;
+            }
         }
-        free(arr_gen);
-        printf("The binary and csv data files generated.\n\n");
+        if(item_end == NULL) {
+            break;
+        }
+        item = item_end + 1;
     }
+    return 0;
+}
 
-    printf("RANDOM ARRAY INPUT:\n");
-    printf("ALGO_TYPE\t\tTIME_IN_SEC\tUNIQUE_INTEGERS\n");
+/* Check that every item of the list names an engine or a dataset. */
+static int check_name_list(const char *list, int is_engine_list) {
+    std::string items(list);
+    size_t pos = 0;
+    for(;;) {
+        size_t end = items.find(',', pos);
+        std::string item = items.substr(pos, (end == std::string::npos) ? std::string::npos : end - pos);
+        int found = 0;
+        for(size_t i = 0; !found && i < (is_engine_list ? NUM_BENCH_ENGINES : NUM_BENCH_DATASETS); i++) {
+            found = name_in_list(is_engine_list ? bench_engines[i].name : bench_datasets[i].name, item.c_str());
+        }
+        if(!found) {
+            printf("ERROR: unknown %s '%s'.\n", is_engine_list ? "engine" : "dataset", item.c_str());
+            return -1;
+        }
+        if(end == std::string::npos) {
+            return 0;
+        }
+        pos = end + 1;
+    }
+}
 
-    if(with_fio == 0) {
-        start = clock();
-        cpp_output = removeDuplicates(arr_gen, num_elems, &num_elems_out);
-        end = clock();
-        printf("CPP_UNSORTED_SET:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
+/**
+ * @brief Open the counters of the calling process and the threads it
+ *   creates later, counting user space only. Counters that cannot be 
+ *   opened (no PMU in a VM, perf_event_paranoid, seccomp in containers)
+ *   are left out.
+ * 
+ * @returns
+ *   The number of counters opened
+ */
+static int perf_counters_open(perf_counters *perf) {
+    perf->num_open = 0;
+    for(int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        perf->fds[i] = -1;
     }
-    else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-        }
-        else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
+#ifdef BENCH_WITH_PERF
+    const uint32_t types[NUM_PERF_COUNTERS] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+    };
+    const uint64_t configs[NUM_PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_SW_PAGE_FAULTS
+    };
+    for(int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        perf->fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if(perf->fds[i] >= 0) {
+            perf->num_open++;
         }
-        cpp_output = removeDuplicates(arr_gen, num_elems, &num_elems_out);
-        end = clock();
-        free(arr_input);
-        printf("CPP_UNSORTED_SET:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
     }
+#endif
+    return perf->num_open;
+}
 
-    if(with_fio == 0) {
-        start = clock();
-        out_bit_dyn = fui_bitmap_dyn(arr_gen, num_elems, &num_elems_out, &err_flag);
-        end = clock();
-        free(out_bit_dyn);
-        printf("BTAS_DYN_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
+static void perf_counters_close(perf_counters *perf) {
+#ifdef BENCH_WITH_PERF
+    for(int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if(perf->fds[i] >= 0) {
+            close(perf->fds[i]);
+        }
+    }
+#endif
+    perf->num_open = 0;
+}
 
-        if(with_count == 1) {
-            start = clock();
-            uniq_count = fui_bitmap_dyn_count(arr_gen, num_elems, &err_flag);
-            end = clock();
-            printf("BTAS_DYN_NOF_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+static void perf_counters_start(const perf_counters *perf) {
+#ifdef BENCH_WITH_PERF
+    for(int i = 0; perf != NULL && i < NUM_PERF_COUNTERS; i++) {
+        if(perf->fds[i] >= 0) {
+            ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
         }
     }
-    else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+#else
+    (void)perf;
+#endif
+}
+
+/* Read the counters, scaled up if the kernel had to multiplex them. */
+static void perf_counters_stop(const perf_counters *perf, double counts[NUM_PERF_COUNTERS]) {
+    for(int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        counts[i] = -1.0;
+#ifdef BENCH_WITH_PERF
+        uint64_t values[3]; /* value, time enabled, time running */
+        if(perf == NULL || perf->fds[i] < 0) {
+            continue;
         }
-        else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-        }
-        out_bit_dyn = fui_bitmap_dyn(arr_input, num_elems_read, &num_elems_out, &err_flag);
-        end = clock();
-        free(arr_input);
-        free(out_bit_dyn);
-        printf("BTAS_DYN_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-            }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
+        ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if(read(perf->fds[i], values, sizeof(values)) != (ssize_t)sizeof(values) || values[2] == 0) {
+            continue;
+        }
+        counts[i] = (double)values[0] * ((double)values[1] / (double)values[2]);
+#else
+        (void)perf;
+#endif
+    }
+}
+
+/**
+ * @brief Reset the peak RSS (high-water mark) of the process, so that it
+ *   can be read per engine. Only Linux supports it; elsewhere the peak 
+ *   RSS is the high-water mark of the whole process so far.
+ */
+static void reset_peak_rss(void) {
+#if defined(__linux__)
+    FILE *file_p = fopen("/proc/self/clear_refs", "w");
+    if(file_p != NULL) {
+        fputs("5", file_p);
+        fclose(file_p);
+    }
+#endif
+}
+
+/* Peak RSS in bytes: VmHWM (resettable) on Linux, getrusage() elsewhere */
+static uint64_t read_peak_rss(void) {
+    uint64_t peak_kib = 0;
+#if defined(__linux__)
+    char line[256];
+    FILE *file_p = fopen("/proc/self/status", "r");
+    if(file_p != NULL) {
+        while(fgets(line, sizeof(line), file_p) != NULL) {
+            if(strncmp(line, "VmHWM:", 6) == 0 && sscanf(line + 6, "%" SCNu64, &peak_kib) == 1) {
+                break;
             }
-            uniq_count = fui_bitmap_dyn_count(arr_input, num_elems_read, &err_flag);
-            end = clock();
-            free(arr_input);
-            printf("BTAS_DYN_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
         }
+        fclose(file_p);
     }
-    
-    if(with_fio == 0) {
-        start = clock();
-        out_bit_dyn_idx = fui_bitmap_idx(arr_gen, num_elems, &num_elems_out_idx, &err_flag, &dup_idx_list1);
-        end = clock();
-        printf("BTAS_IDX_NOF_EXPORT:\t%lf\t%" PRIu64 "\t::::%d\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out_idx, err_flag);
+    if(peak_kib != 0) {
+        return peak_kib * 1024;
     }
-    else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(__APPLE__)
+        return (uint64_t)usage.ru_maxrss; /* Bytes on macOS */
+#else
+        return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+    }
+#endif
+    return peak_kib;
+}
+
+static bench_sample run_once(const bench_engine *engine, int count_only, const bench_input *input, const perf_counters *perf) {
+    bench_sample sample;
+    uint32_t *output_arr = NULL;
+    uint32_t *arr_input = NULL;
+    uint64_t num_elems_read = 0;
+    sample.num_uniq = 0;
+    sample.err_flag = 0;
+    memset(&sample.stats, 0, sizeof(btas_stats));
+    perf_counters_start(perf);
+    std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+    clock_t cpu_start = clock();
+    if(input->source == BENCH_SOURCE_MEM) {
+        if(count_only) {
+            sample.num_uniq = engine->count_fn(input->arr, input->num_elems, &sample.err_flag, &sample.stats);
         }
         else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
+            output_arr = engine->export_fn(input->arr, input->num_elems, &sample.num_uniq, &sample.err_flag, &sample.stats);
         }
-        out_bit_dyn_idx = fui_bitmap_idx(arr_input, num_elems_read, &num_elems_out_idx, &err_flag, &dup_idx_list1);
-        end = clock();
-        free(arr_input);
-        printf("BTAS_IDX_FIO_EXPORT:\t%lf\t%" PRIu64 "\t::::%d\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out_idx, err_flag);
     }
-
-    if(with_fio == 0) {
-        start = clock();
-        out_bit_stc = fui_bitmap_stc(arr_gen, num_elems, &num_elems_out, &err_flag);
-        end = clock();
-        free(out_bit_stc);
-        printf("BTAS_STC_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            start = clock();
-            uniq_count = fui_bitmap_stc_count(arr_gen, num_elems, &err_flag);
-            end = clock();
-            printf("BTAS_STC_NOF_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
-        }
+    else if(count_only && engine->file_count_fn != NULL) {
+        sample.num_uniq = engine->file_count_fn(input->file, input->type, &sample.err_flag);
+    }
+    else if(!count_only && engine->file_export_fn != NULL) {
+        output_arr = engine->file_export_fn(input->file, input->type, &sample.num_uniq, &sample.err_flag);
     }
     else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-        }
-        else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-        }
-        out_bit_stc = fui_bitmap_stc(arr_input, num_elems_read, &num_elems_out, &err_flag);
-        end = clock();
-        free(arr_input);
-        free(out_bit_stc);
-        printf("BTAS_STC_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+        arr_input = import_1d_u32(input->file, input->type, &num_elems_read, &sample.err_flag);
+        if(arr_input != NULL) {
+            if(count_only) {
+                sample.num_uniq = engine->count_fn(arr_input, num_elems_read, &sample.err_flag, &sample.stats);
             }
             else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
+                output_arr = engine->export_fn(arr_input, num_elems_read, &sample.num_uniq, &sample.err_flag, &sample.stats);
             }
-            uniq_count = fui_bitmap_stc_count(arr_input, num_elems_read, &err_flag);
-            end = clock();
-            free(arr_input);
-            printf("BTAS_STC_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
         }
     }
+    clock_t cpu_end = clock();
+    std::chrono::steady_clock::time_point wall_end = std::chrono::steady_clock::now();
+    perf_counters_stop(perf, sample.perf_counts);
+    free(arr_input);
+    free(output_arr);
+    sample.wall_sec = std::chrono::duration<double>(wall_end - wall_start).count();
+    sample.cpu_sec = (double)(cpu_end - cpu_start) / CLOCKS_PER_SEC;
+    return sample;
+}
+
+/* Nearest-rank percentile of a sorted vector. */
+static double percentile(const std::vector<double> &sorted, double pct) {
+    size_t rank = (size_t)(pct / 100.0 * sorted.size() + 0.999999);
+    rank = (rank < 1) ? 1 : ((rank > sorted.size()) ? sorted.size() : rank);
+    return sorted[rank - 1];
+}
 
-    if(with_fio == 0) {
-        start = clock();
-        out_ht_stree = fui_htable(arr_gen, num_elems, &num_elems_out, &err_flag);
-        end = clock();
-        free(out_ht_stree);
-        printf("HTBL_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    return (values.size() % 2) ? values[mid] : (values[mid - 1] + values[mid]) / 2.0;
+}
 
-        if(with_count == 1) {
-            start = clock();
-            uniq_count = fui_htable_count(arr_gen, num_elems, &err_flag);
-            end = clock();
-            printf("HTBL_NOF_COUNT :\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+static bench_result run_engine(const bench_engine *engine, int count_only, const bench_input *input, uint32_t warmup, uint32_t reps, const perf_counters *perf) {
+    bench_result result;
+    std::vector<double> wall_times, cpu_times;
+    std::vector<double> perf_counts[NUM_PERF_COUNTERS];
+    bench_sample sample;
+    result.engine = engine->name;
+    result.mode = count_only ? "COUNT" : "EXPORT";
+    result.source = (input->source == BENCH_SOURCE_MEM) ? "NOF" : "FIO";
+    result.num_elems = input->num_elems;
+    result.reps = reps;
+    result.err_flag = 0;
+    result.num_uniq = 0;
+    memset(&result.stats, 0, sizeof(btas_stats));
+    reset_peak_rss();
+    for(uint32_t i = 0; i < warmup; i++) {
+        sample = run_once(engine, count_only, input, perf);
+        if(sample.err_flag != 0) {
+            result.err_flag = sample.err_flag;
+            break;
         }
     }
-    else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-        }
-        else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-        }
-        out_ht_stree = fui_htable(arr_input, num_elems_read, &num_elems_out, &err_flag);
-        end = clock();
-        free(arr_input);
-        free(out_ht_stree);
-        printf("HTBL_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+    for(uint32_t i = 0; result.err_flag == 0 && i < reps; i++) {
+        sample = run_once(engine, count_only, input, perf);
+        wall_times.push_back(sample.wall_sec);
+        cpu_times.push_back(sample.cpu_sec);
+        for(int j = 0; j < NUM_PERF_COUNTERS; j++) {
+            if(sample.perf_counts[j] >= 0.0) {
+                perf_counts[j].push_back(sample.perf_counts[j]);
             }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-            }
-            uniq_count = fui_htable_count(arr_input, num_elems_read, &err_flag);
-            end = clock();
-            free(arr_input);
-            printf("HTBL_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
         }
+        result.num_uniq = sample.num_uniq;
+        result.err_flag = sample.err_flag;
+        result.stats = sample.stats;
     }
+    result.peak_rss = read_peak_rss();
+    if(wall_times.empty()) {
+        wall_times.push_back(0.0);
+        cpu_times.push_back(0.0);
+    }
+    std::vector<double> sorted_times(wall_times);
+    std::sort(sorted_times.begin(), sorted_times.end());
+    result.wall_median = median(wall_times);
+    result.wall_min = sorted_times[0];
+    result.wall_p95 = percentile(sorted_times, 95.0);
+    result.cpu_median = median(cpu_times);
+    result.melems_per_sec = (result.wall_median > 0.0) ? (double)input->num_elems / result.wall_median / 1e6 : 0.0;
+    for(int j = 0; j < NUM_PERF_COUNTERS; j++) {
+        result.perf_per_elem[j] = perf_counts[j].empty() ? -1.0 : median(perf_counts[j]) / (double)input->num_elems;
+    }
+    return result;
+}
 
-    if(with_fio == 0) {
-        start = clock();
-        out_ht_dyn = fui_htable_dyn(arr_gen, num_elems, &num_elems_out, &err_flag);
-        end = clock();
-        free(out_ht_dyn);
-        printf("HTBL_DYN_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            start = clock();
-            uniq_count = fui_htable_dyn_count(arr_gen, num_elems, &err_flag);
-            end = clock();
-            printf("HTBL_DYN_NOF_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
-        }
+static void print_result(const bench_result *result) {
+    std::string tag = result->engine + "_" + result->source + "_" + result->mode + ":";
+    printf("%-30s%.6lf\t%.6lf\t%.6lf\t%.6lf\t%.2lf\t\t", tag.c_str(), result->wall_median,
+        result->wall_min, result->wall_p95, result->cpu_median, result->melems_per_sec);
+    if(result->stats.peak_bytes != 0) {
+        printf("%.2lf\t\t", (double)result->stats.peak_bytes / 1048576.0);
     }
     else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+        printf("n/a\t\t");
+    }
+    printf("%.2lf\t\t%" PRIu64, (double)result->peak_rss / 1048576.0, result->num_uniq);
+    if(result->err_flag != 0) {
+        printf("\t::::%d", result->err_flag);
+    }
+    printf("\n");
+}
+
+/* Print the memory accounting of an engine under a result. */
+static void print_mem_result(const bench_result *result) {
+    const btas_stats *stats = &result->stats;
+    if(stats->peak_bytes == 0) {
+        printf("    MEMORY: n/a\n");
+        return;
+    }
+    printf("    MEMORY: branches=%" PRIu64 " stem_length=%" PRIu64 " stem_mib=%.3lf branch_mib=%.3lf index_mib=%.3lf output_mib=%.3lf peak_mib=%.3lf\n",
+        stats->num_branches, stats->stem_length, (double)stats->stem_bytes / 1048576.0, (double)stats->branch_bytes / 1048576.0,
+        (double)stats->index_bytes / 1048576.0, (double)stats->output_bytes / 1048576.0, (double)stats->peak_bytes / 1048576.0);
+}
+
+/* Print the counters per input element (and the IPC) under a result. */
+static void print_perf_result(const bench_result *result) {
+    const double *per_elem = result->perf_per_elem;
+    printf("    PER_ELEM:");
+    for(int i = 0; i < NUM_PERF_COUNTERS; i++) {
+        if(per_elem[i] >= 0.0) {
+            printf(" %s=%.4lf", perf_counter_names[i], per_elem[i]);
         }
         else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-        }
-        out_ht_dyn = fui_htable_dyn(arr_input, num_elems_read, &num_elems_out, &err_flag);
-        end = clock();
-        free(arr_input);
-        free(out_ht_dyn);
-        printf("HTBL_DYN_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-            }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-            }
-            uniq_count = fui_htable_dyn_count(arr_input, num_elems_read, &err_flag);
-            end = clock();
-            free(arr_input);
-            printf("HTBL_DYN_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
-        }
-    }
-    
-    if(with_brute == 1) {
-        if(with_fio == 0) {
-            start = clock();
-            out_brute_opt = fui_brute_opt(arr_gen, num_elems, &num_elems_out, &err_flag);
-            end = clock();
-            free(out_brute_opt);
-            printf("BRUTE_OPT_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-            if(with_count == 1) {
-                start = clock();
-                uniq_count = fui_brute_opt_count(arr_gen, num_elems, &err_flag);
-                end = clock();
-                printf("BRUTE_OPT_NOF_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
-            }
+            printf(" %s=n/a", perf_counter_names[i]);
         }
-        else {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-            }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-            }
-            out_brute_opt = fui_brute_opt(arr_input, num_elems_read, &num_elems_out, &err_flag);
-            end = clock();
-            free(arr_input);
-            free(out_brute_opt);
-            printf("BRUTE_OPT_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-            if(with_count == 1) {
-                if(with_fio == 1) {
-                    start = clock();
-                    arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-                }
-                else {
-                    start = clock();
-                    arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-                }
-                uniq_count = fui_brute_opt_count(arr_input, num_elems_read, &err_flag);
-                end = clock();
-                free(arr_input);
-                printf("BRUTE_OPT_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-            }
+    }
+    if(per_elem[PERF_CYCLES] > 0.0 && per_elem[PERF_INSTRUCTIONS] >= 0.0) {
+        printf(" ipc=%.3lf", per_elem[PERF_INSTRUCTIONS] / per_elem[PERF_CYCLES]);
+    }
+    printf("\n");
+}
+
+/* Print a counter value into a CSV/JSON field, empty/null if not counted. */
+static void fprint_perf_value(FILE *file_p, double value, const char *missing) {
+    if(value >= 0.0) {
+        fprintf(file_p, "%.6lf", value);
+    }
+    else {
+        fprintf(file_p, "%s", missing);
+    }
+}
+
+static int write_results_csv(const char *target_file, const std::vector<bench_result> &results) {
+    FILE *file_p = fopen(target_file, "w");
+    if(file_p == NULL) {
+        return -1;
+    }
+    fprintf(file_p, "dataset,engine,source,mode,num_elems,rand_max,seed,threads,reps,wall_median_sec,wall_min_sec,wall_p95_sec,cpu_median_sec,melems_per_sec,num_uniq,err_flag,"
+        "num_branches,stem_length,stem_bytes,branch_bytes,index_bytes,output_bytes,peak_bytes,peak_rss_bytes");
+    for(int j = 0; j < NUM_PERF_COUNTERS; j++) {
+        fprintf(file_p, ",%s_per_elem", perf_counter_names[j]);
+    }
+    fprintf(file_p, "\n");
+    for(size_t i = 0; i < results.size(); i++) {
+        const bench_result *r = &results[i];
+        fprintf(file_p, "%s,%s,%s,%s,%" PRIu64 ",%u,%" PRIu64 ",%u,%u,%.9lf,%.9lf,%.9lf,%.9lf,%.4lf,%" PRIu64 ",%d",
+            r->dataset.c_str(), r->engine.c_str(), r->source.c_str(), r->mode.c_str(), r->num_elems, r->rand_max, r->seed,
+            get_num_threads(), r->reps, r->wall_median, r->wall_min, r->wall_p95, r->cpu_median, r->melems_per_sec, r->num_uniq, r->err_flag);
+        fprintf(file_p, ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64,
+            r->stats.num_branches, r->stats.stem_length, r->stats.stem_bytes, r->stats.branch_bytes, r->stats.index_bytes,
+            r->stats.output_bytes, r->stats.peak_bytes, r->peak_rss);
+        for(int j = 0; j < NUM_PERF_COUNTERS; j++) {
+            fprintf(file_p, ",");
+            fprint_perf_value(file_p, r->perf_per_elem[j], "");
         }
-        
-        if(with_fio == 0) {
-            start = clock();
-            out_brute = fui_brute(arr_gen, num_elems, &num_elems_out, &err_flag);
-            end = clock();
-            free(out_brute);
-            printf("BRUTE_ORIG_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-            if(with_count == 1) {
-                start = clock();
-                out_brute = fui_brute(arr_gen, num_elems, &num_elems_out, &err_flag);
-                end = clock();
-                free(out_brute);
-                printf("BRUTE_ORIG_NOF_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-            }
+        fprintf(file_p, "\n");
+    }
+    return (fclose(file_p) == 0) ? 0 : -1;
+}
+
+static int write_results_json(const char *target_file, const std::vector<bench_result> &results) {
+    char host_name[256] = "unknown";
+#if defined(__unix__) || defined(__APPLE__)
+    if(gethostname(host_name, sizeof(host_name)) != 0) {
+        strcpy(host_name, "unknown");
+    }
+    host_name[sizeof(host_name) - 1] = '\0';
+#endif
+    FILE *file_p = fopen(target_file, "w");
+    if(file_p == NULL) {
+        return -1;
+    }
+    fprintf(file_p, "{\n  \"host\": {\"name\": \"%s\", \"threads\": %u, \"compiler\": \"%s\", \"timestamp\": %" PRIu64 "},\n  \"results\": [\n",
+        host_name, get_num_threads(),
+#if defined(__VERSION__)
+        __VERSION__,
+#else
+        "unknown",
+#endif
+        (uint64_t)time(NULL));
+    for(size_t i = 0; i < results.size(); i++) {
+        const bench_result *r = &results[i];
+        fprintf(file_p, "    {\"dataset\": \"%s\", \"engine\": \"%s\", \"source\": \"%s\", \"mode\": \"%s\", \"num_elems\": %" PRIu64 ", \"rand_max\": %u, \"seed\": %" PRIu64 ", \"reps\": %u, "
+            "\"wall_median_sec\": %.9lf, \"wall_min_sec\": %.9lf, \"wall_p95_sec\": %.9lf, \"cpu_median_sec\": %.9lf, \"melems_per_sec\": %.4lf, \"num_uniq\": %" PRIu64 ", \"err_flag\": %d, ",
+            r->dataset.c_str(), r->engine.c_str(), r->source.c_str(), r->mode.c_str(), r->num_elems, r->rand_max, r->seed, r->reps,
+            r->wall_median, r->wall_min, r->wall_p95, r->cpu_median, r->melems_per_sec, r->num_uniq, r->err_flag);
+        fprintf(file_p, "\"memory\": {\"num_branches\": %" PRIu64 ", \"stem_length\": %" PRIu64 ", \"stem_bytes\": %" PRIu64 ", \"branch_bytes\": %" PRIu64
+            ", \"index_bytes\": %" PRIu64 ", \"output_bytes\": %" PRIu64 ", \"peak_bytes\": %" PRIu64 ", \"peak_rss_bytes\": %" PRIu64 "}, \"per_elem\": {",
+            r->stats.num_branches, r->stats.stem_length, r->stats.stem_bytes, r->stats.branch_bytes, r->stats.index_bytes,
+            r->stats.output_bytes, r->stats.peak_bytes, r->peak_rss);
+        for(int j = 0; j < NUM_PERF_COUNTERS; j++) {
+            fprintf(file_p, "%s\"%s\": ", (j > 0) ? ", " : "", perf_counter_names[j]);
+            fprint_perf_value(file_p, r->perf_per_elem[j], "null");
         }
-        else {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-            }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
+        fprintf(file_p, "}}%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(file_p, "  ]\n}\n");
+    return (fclose(file_p) == 0) ? 0 : -1;
+}
+
+/* Trace callback of the engines: keep the call for write_trace_json(). */
+static void collect_trace(const btas_trace *trace, void *user_data) {
+    trace_sink *sink = (trace_sink *)user_data;
+    trace_record record;
+    record.trace = *trace;
+    record.dataset = sink->dataset;
+    record.engine = sink->engine;
+    sink->records.push_back(record);
+}
+
+/* The parents go first, so the viewers nest the allocations in INSERT */
+static const int trace_phase_order[BTAS_NUM_PHASES] = {
+    BTAS_PHASE_SETUP, BTAS_PHASE_INSERT, BTAS_PHASE_STEM_GROW, BTAS_PHASE_BRANCH_ALLOC, BTAS_PHASE_TEARDOWN, BTAS_PHASE_OUTPUT
+};
+
+static void fprint_trace_event(FILE *file_p, const char *name, const char *cat, uint64_t ts_ns, uint64_t dur_ns, int *first) {
+    fprintf(file_p, "%s\n    {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.3lf, \"dur\": %.3lf",
+        *first ? "" : ",", name, cat, (double)ts_ns / 1000.0, (double)dur_ns / 1000.0);
+    *first = 0;
+}
+
+/**
+ * @brief Write the traced calls as a Chrome trace (chrome://tracing,
+ *   Perfetto, speedscope). Every call is a slice with its phases nested;
+ *   the stem reallocs and branch callocs are scattered over the insert
+ *   loop, so they are collapsed back-to-back at the start of it, with
+ *   their totals and counts.
+ */
+static int write_trace_json(const char *target_file, const std::vector<trace_record> &records) {
+    FILE *file_p = fopen(target_file, "w");
+    int first = 1;
+    if(file_p == NULL) {
+        return -1;
+    }
+    uint64_t origin = records.empty() ? 0 : records[0].trace.start_ns;
+    fprintf(file_p, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    for(size_t i = 0; i < records.size(); i++) {
+        const btas_trace *trace = &records[i].trace;
+        fprint_trace_event(file_p, trace->engine, "call", trace->start_ns - origin, trace->end_ns - trace->start_ns, &first);
+        fprintf(file_p, ", \"args\": {\"dataset\": \"%s\", \"engine\": \"%s\", \"num_elems\": %" PRIu64 ", \"err_flag\": %d}}",
+            records[i].dataset, records[i].engine, trace->num_elems, trace->err_flag);
+        uint64_t nested_ts = trace->phase_first_ns[BTAS_PHASE_INSERT];
+        for(int k = 0; k < BTAS_NUM_PHASES; k++) {
+            int j = trace_phase_order[k];
+            if(trace->phase_count[j] == 0) {
+                continue;
             }
-            out_brute = fui_brute(arr_input, num_elems_read, &num_elems_out, &err_flag);
-            end = clock();
-            free(arr_input);
-            free(out_brute);
-            printf("BRUTE_ORIG_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-            if(with_count == 1) {
-                if(with_fio == 1) {
-                    start = clock();
-                    arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-                }
-                else {
-                    start = clock();
-                    arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-                }
-                uniq_count = fui_brute_count(arr_input, num_elems_read, &err_flag);
-                end = clock();
-                free(arr_input);
-                printf("BRUTE_ORIG_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+            uint64_t ts = trace->phase_first_ns[j];
+            if(j == BTAS_PHASE_STEM_GROW || j == BTAS_PHASE_BRANCH_ALLOC) {
+                ts = nested_ts;
+                nested_ts += trace->phase_ns[j];
             }
+            fprint_trace_event(file_p, btas_phase_names[j], "phase", ts - origin, trace->phase_ns[j], &first);
+            fprintf(file_p, ", \"args\": {\"count\": %" PRIu64 "}}", trace->phase_count[j]);
         }
     }
-    print_dup_idx_list(dup_idx_list1, 3);
-    print_out_idx(out_bit_dyn_idx, num_elems_out_idx, 5);
-    free(out_bit_dyn_idx);
-    free_dup_idx_list(dup_idx_list1);
-    
-    arr_gen = (uint32_t *)malloc(sizeof(uint32_t) * num_elems);
+    fprintf(file_p, "\n]}\n");
+    return (fclose(file_p) == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Check a generated data file: it must read back as the array, and
+ *   the streaming file dedup must find as many unique integers as the
+ *   in-memory one. A mismatch is reported as a warning, like the engines'.
+ */
+static void check_file_round_trip(const char *data_file, const char *type, const uint32_t *arr, uint64_t num_elems) {
+    int err_flag = 0, mem_err_flag = 0;
+    uint64_t num_elems_read = 0;
+    uint32_t *arr_read = import_1d_u32(data_file, type, &num_elems_read, &err_flag);
+    if(arr_read == NULL || num_elems_read != num_elems || memcmp(arr_read, arr, num_elems * sizeof(uint32_t)) != 0) {
+        printf("WARNING: '%s' doesn't read back as written (error %d).\n", data_file, err_flag);
+    }
+    free(arr_read);
+    uint64_t file_uniq = dedup_file_u32_count(data_file, type, &err_flag);
+    uint64_t mem_uniq = fui_bitmap_dyn_count(arr, num_elems, &mem_err_flag, NULL);
+    if(err_flag != 0 || mem_err_flag != 0 || file_uniq != mem_uniq) {
+        printf("WARNING: Streaming '%s' finds %" PRIu64 " unique integers (error %d), expected %" PRIu64 ".\n", data_file, file_uniq, err_flag, mem_uniq);
+    }
+}
+
+/**
+ * @brief Generate a dataset and run the selected engines on it, appending
+ *   the results.
+ *
+ * @returns
+ *   0 if succeeded, otherwise the exit code of main()
+ */
+static int run_dataset(const bench_dataset *dataset, uint64_t num_elems, uint32_t rand_max, uint64_t seed, const bench_options *opts, std::vector<bench_result> &results) {
+    char data_file[512] = "";
+    uint32_t *arr_gen = (uint32_t *)malloc(sizeof(uint32_t) * num_elems);
     if(arr_gen == NULL) {
         printf("ERROR: Failed to allocate memory for input array.\n");
         return 5;
     }
-
-    printf("Generating a random array for benchmarking ...\n");
-    generate_growing_arr(arr_gen, num_elems);
-    if(with_fio != 0) {
-        printf("Writing data to files ...\n");
-        snprintf(data_file_bin, 512, "growing_%s_%s.bin", argv[1], argv[2]);
-        if(export_1d_u32(data_file_bin, "", arr_gen, num_elems) != 0) {
-            printf("ERROR: Failed to export the data to 'growing_..._....bin'.\n");
-            free(arr_gen);
-            return 7;
-        }
-        snprintf(data_file_csv, 512, "growing_%s_%s.csv", argv[1], argv[2]);
-        if(export_1d_u32(data_file_csv, "csv", arr_gen, num_elems) != 0) {
-            printf("ERROR: Failed to export the data to 'growing_..._....csv'.\n");
+    printf("Generating the %s array for benchmarking ...\n", dataset->name);
+    if(dataset->generate(arr_gen, num_elems, rand_max, seed) != 0) {
+        printf("ERROR: arguments illegal for the %s dataset.\n", dataset->name);
+        free(arr_gen);
+        return 3;
+    }
+    bench_input input;
+    input.arr = arr_gen;
+    input.num_elems = num_elems;
+    input.source = BENCH_SOURCE_MEM;
+    input.file = data_file;
+    input.type = "";
+    if(opts->with_fio != 0) {
+        printf("Writing data to the file ...\n");
+        input.source = (opts->with_fio == 1) ? BENCH_SOURCE_BIN : BENCH_SOURCE_CSV;
+        input.type = (opts->with_fio == 1) ? "" : "csv";
+        snprintf(data_file, 512, "%s_%" PRIu64 "_%u.%s", dataset->name, num_elems, rand_max, (opts->with_fio == 1) ? "bin" : "csv");
+        if(export_1d_u32(data_file, input.type, arr_gen, num_elems) != 0) {
+            printf("ERROR: Failed to export the data to '%s'.\n", data_file);
             free(arr_gen);
-            return 9;
+            return (opts->with_fio == 1) ? 7 : 9;
         }
+        check_file_round_trip(data_file, input.type, arr_gen, num_elems);
+        /* The engines read the file, so release the memory for them. */
         free(arr_gen);
-        printf("The binary and csv data files generated.\n\n");
+        arr_gen = NULL;
+        input.arr = NULL;
+        printf("The %s data file generated.\n", (opts->with_fio == 1) ? "binary" : "csv");
     }
-     
-    printf("GROWING ARRAY INPUT:\n");
-    printf("ALGO_TYPE\t\tTIME_IN_SEC\tUNIQUE_INTEGERS\n");
-
-    if(with_fio == 0) {
-        start = clock();
-        out_bit_dyn = fui_bitmap_dyn(arr_gen, num_elems, &num_elems_out, &err_flag);
-        end = clock();
-        free(out_bit_dyn);
-        printf("BTAS_DYN_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
+    printf("\n%s ARRAY INPUT:\n", dataset->name);
+    printf("ALGO_TYPE\t\tMEDIAN_SEC\tMIN_SEC\t\tP95_SEC\t\tCPU_SEC\t\tMELEMS/S\tPEAK_MIB\tRSS_MIB\t\tUNIQUE_INTEGERS\n");
 
-        if(with_count == 1) {
-            start = clock();
-            uniq_count = fui_bitmap_dyn_count(arr_gen, num_elems, &err_flag);
-            end = clock();
-            printf("BTAS_DYN_NOF_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
-        }
-    }
-    else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+    uint64_t ref_uniq = 0;
+    int has_ref = 0;
+    for(size_t e = 0; e < NUM_BENCH_ENGINES; e++) {
+        const bench_engine *engine = &bench_engines[e];
+        if(opts->engine_list != NULL ? !name_in_list(engine->name, opts->engine_list) : (engine->is_brute && !opts->with_brute)) {
+            continue;
         }
-        else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-        }
-        out_bit_dyn = fui_bitmap_dyn(arr_input, num_elems_read, &num_elems_out, &err_flag);
-        end = clock();
-        free(arr_input);
-        free(out_bit_dyn);
-        printf("BTAS_DYN_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+        for(int count_only = 0; count_only <= opts->with_count; count_only++) {
+            if(count_only && engine->count_fn == NULL) {
+                continue;
             }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
+            opts->traces->dataset = dataset->name;
+            opts->traces->engine = engine->name;
+            bench_result result = run_engine(engine, count_only, &input, opts->warmup, opts->reps, opts->perf);
+            release_bench_ctx();
+            result.dataset = dataset->name;
+            result.rand_max = rand_max;
+            result.seed = seed;
+            print_result(&result);
+            if(opts->with_mem) {
+                print_mem_result(&result);
+            }
+            if(opts->perf != NULL) {
+                print_perf_result(&result);
+            }
+            if(result.err_flag == 0 && has_ref && result.num_uniq != ref_uniq) {
+                printf("WARNING: %s reports %" PRIu64 " unique integers, expected %" PRIu64 ".\n", engine->name, result.num_uniq, ref_uniq);
             }
-            uniq_count = fui_bitmap_dyn_count(arr_input, num_elems_read, &err_flag);
-            end = clock();
-            free(arr_input);
-            printf("BTAS_DYN_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+            if(result.err_flag == 0 && !has_ref) {
+                ref_uniq = result.num_uniq;
+                has_ref = 1;
+            }
+            results.push_back(result);
         }
     }
-    
-    if(with_fio == 0) {
-        start = clock();
-        out_bit_dyn_idx = fui_bitmap_idx(arr_gen, num_elems, &num_elems_out_idx, &err_flag, &dup_idx_list2);
-        end = clock();
-        printf("BTAS_IDX_NOF_EXPORT:\t%lf\t%" PRIu64 "\t::::%d\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out_idx, err_flag);
+    free(arr_gen);
+    printf("\n");
+    return 0;
+}
+
+static std::string baseline_key(const std::string &dataset, const std::string &engine, const std::string &source, const std::string &mode, uint64_t num_elems, uint32_t rand_max) {
+    char cell[64];
+    snprintf(cell, sizeof(cell), "{%" PRIu64 ",%u}", num_elems, rand_max);
+    return dataset + cell + " " + engine + "_" + source + "_" + mode;
+}
+
+/**
+ * @brief Load a baseline, which is a result file written by --csv (or by
+ *   the suite). Failed runs are skipped.
+ *
+ * @returns
+ *  -1 if the file can't be opened
+ *   1 if the header is not the one of a result file
+ *   0 if succeeded
+ */
+static int load_baseline(const char *baseline_file, std::vector<baseline_entry> &entries) {
+    char line[1024];
+    FILE *file_p = fopen(baseline_file, "r");
+    if(file_p == NULL) {
+        return -1;
     }
-    else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+    if(fgets(line, sizeof(line), file_p) == NULL || strncmp(line, "dataset,engine,source,mode,num_elems,rand_max,", 46) != 0) {
+        fclose(file_p);
+        return 1;
+    }
+    while(fgets(line, sizeof(line), file_p) != NULL) {
+        std::vector<std::string> fields;
+        std::string row(line);
+        size_t pos = 0, end;
+        while((end = row.find(',', pos)) != std::string::npos) {
+            fields.push_back(row.substr(pos, end - pos));
+            pos = end + 1;
         }
-        else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
+        fields.push_back(row.substr(pos));
+        /* 0 dataset, 1 engine, 2 source, 3 mode, 4 num_elems, 5 rand_max, 9 wall_median_sec, 15 err_flag */
+        if(fields.size() < 16 || atoi(fields[15].c_str()) != 0) {
+            continue;
         }
-        out_bit_dyn_idx = fui_bitmap_idx(arr_input, num_elems_read, &num_elems_out_idx, &err_flag, &dup_idx_list2);
-        end = clock();
-        free(arr_input);
-        printf("BTAS_IDX_FIO_EXPORT:\t%lf\t%" PRIu64 "\t::::%d\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out_idx, err_flag);
+        baseline_entry entry;
+        entry.key = baseline_key(fields[0], fields[1], fields[2], fields[3], strtoull(fields[4].c_str(), NULL, 10), (uint32_t)strtoul(fields[5].c_str(), NULL, 10));
+        entry.wall_median = atof(fields[9].c_str());
+        entries.push_back(entry);
     }
+    fclose(file_p);
+    return 0;
+}
 
-    if(with_fio == 0) {
-        start = clock();
-        out_bit_stc = fui_bitmap_stc(arr_gen, num_elems, &num_elems_out, &err_flag);
-        end = clock();
-        free(out_bit_stc);
-        printf("BTAS_STC_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            start = clock();
-            uniq_count = fui_bitmap_stc_count(arr_gen, num_elems, &err_flag);
-            end = clock();
-            printf("BTAS_STC_NOF_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+/**
+ * @brief Print the results against a baseline. A result regresses if its
+ *   median is slower than the baseline median by more than threshold %.
+ *
+ * @returns
+ *   The number of regressions
+ */
+static uint32_t print_baseline_diff(const std::vector<baseline_entry> &entries, const std::vector<bench_result> &results, uint32_t threshold) {
+    uint32_t num_regressions = 0, num_improvements = 0;
+    printf("BASELINE DIFF (threshold %u%%):\n", threshold);
+    printf("%-58s%-14s%-14s%-10s%s\n", "CELL ENGINE_SOURCE_MODE", "BASE_SEC", "NOW_SEC", "DELTA", "STATUS");
+    for(size_t i = 0; i < results.size(); i++) {
+        const bench_result *r = &results[i];
+        std::string key = baseline_key(r->dataset, r->engine, r->source, r->mode, r->num_elems, r->rand_max);
+        const baseline_entry *base = NULL;
+        for(size_t j = 0; j < entries.size() && base == NULL; j++) {
+            if(entries[j].key == key) {
+                base = &entries[j];
+            }
         }
-    }
-    else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+        if(r->err_flag != 0) {
+            printf("%-58s%-14s%-14s%-10s%s\n", key.c_str(), "-", "-", "-", "FAILED");
+            num_regressions++;
+            continue;
         }
-        else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-        }
-        out_bit_stc = fui_bitmap_stc(arr_input, num_elems_read, &num_elems_out, &err_flag);
-        end = clock();
-        free(arr_input);
-        free(out_bit_stc);
-        printf("BTAS_STC_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-            }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-            }
-            uniq_count = fui_bitmap_stc_count(arr_input, num_elems_read, &err_flag);
-            end = clock();
-            free(arr_input);
-            printf("BTAS_STC_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+        if(base == NULL || base->wall_median <= 0.0) {
+            printf("%-58s%-14s%-14.6lf%-10s%s\n", key.c_str(), "-", r->wall_median, "-", "NEW");
+            continue;
         }
+        double delta = (r->wall_median - base->wall_median) / base->wall_median * 100.0;
+        const char *status = "ok";
+        if(delta > (double)threshold) {
+            status = "REGRESSION";
+            num_regressions++;
+        }
+        else if(delta < -(double)threshold) {
+            status = "improved";
+            num_improvements++;
+        }
+        printf("%-58s%-14.6lf%-14.6lf%+-10.1lf%s\n", key.c_str(), base->wall_median, r->wall_median, delta, status);
     }
-    
-    if(with_fio == 0) {
-        start = clock();
-        out_ht_stree = fui_htable(arr_gen, num_elems, &num_elems_out, &err_flag);
-        end = clock();
-        free(out_ht_stree);
-        printf("HTBL_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
+    printf("\n%u regression(s), %u improvement(s) over %zu result(s).\n\n", num_regressions, num_improvements, results.size());
+    return num_regressions;
+}
+
+/**
+ * @brief
+ *  usage: ./command argv[1] argv[2] CMD_FLAGS
+ *         ./command --suite[=quick] CMD_FLAGS
+ *
+ * @param [in]
+ *  argv[1] indicates the size (number of elems) of the input array
+ *  argv[2] indicates the maximun of the random number generated
+ *      NOTE: argv[2] only affects the random dataset, and is the number of
+ *            keys (scattered over the 32-bit space) of the zipf dataset
+ *  CMD_FLAGS:
+ *    --brute  : Execute brute algorithms (might cause OOM if the dataset is large!)
+ *    --fio-bin: Execute the file I/O benchmark with binary reading
+ *    --fio-csv: Execute the file I/O benchmark with csv reading
+ *    --count  : Also benchmark the count-only variants
+ *    --engines=NAME,...  : Only run the named engines (e.g. btas_dyn,htbl)
+ *    --datasets=NAME,... : random, growing, zipf, clustered, nearly_sorted,
+ *                          reverse (default: random,growing)
+ *    --warmup=N : Untimed runs per engine (default: 1)
+ *    --reps=N   : Timed runs per engine (default: 3, 5 in the suite)
+ *    --seed=N   : Seed of the generated datasets
+ *    --threads=N: Number of threads for the parallel routines (0 - auto)
+ *    --json=FILE, --csv=FILE: Write the results to a JSON/CSV file
+ *    --mem      : Print the memory accounting of every engine in detail
+ *    --perf     : Report the hardware counters (cycles, instructions, IPC,
+ *                 LLC/dTLB misses, branch mispredicts) per input element.
+ *                 Counters the host doesn't expose are reported as n/a.
+ *    --trace=FILE: Write the phases of the traced engines (btas_dyn,
+ *                 btas_idx, htbl_dyn) as a Chrome trace. Needs a build
+ *                 with -DBTAS_TRACE.
+ *    --suite    : Run the scenario suite (bench_suite[]: the cells of the
+ *                 TECHNICAL_REVIEW.md tables and the new distributions)
+ *                 with fixed seeds, instead of argv[1] and argv[2].
+ *                 --suite=quick skips the {100M, 4B} cell.
+ *    --baseline=FILE: Compare the results with FILE (a --csv result file)
+ *                 and flag the regressions. If FILE doesn't exist, the
+ *                 results are saved to it as the baseline.
+ *    --update-baseline: Overwrite the baseline with the results after the
+ *                 comparison.
+ *    --threshold=PCT: Noise threshold of the comparison (default: 10)
+ *      NOTE: By default, the CMD_FLAGS are off, meaning that the brute algos would
+ *            not be executed, and no file I/O triggered.
+ *
+ *  Every engine reports the median, min and p95 of the wall-clock time,
+ *  the median CPU time (of all threads) and the throughput over the median,
+ *  with the peak bytes the engine held (from btas_stats) and the peak RSS.
+ *
+ * @returns
+ *   0 : if everything goes well
+ *   1 : if command args not enough
+ *   3 : illegal arguments found
+ *   5 : Failed to allocate memory for input array
+ *   7 : Failed to write data to the binary file
+ *   9 : Failed to write data to the csv files
+ *  11 : Failed to write the result files
+ *  13 : Regressions found against the baseline (or the baseline is invalid)
+ *
+ */
+int main(int argc, char** argv) {
+
+    int with_perf = 0, with_suite = 0, ret = 0;
+    perf_counters perf;
+    uint32_t rand_max = 0, num_threads, threshold;
+    uint64_t num_elems = 0, seed = BENCH_DEFAULT_SEED;
+    const char *dataset_list = get_option_value(argc, argv, "--datasets");
+    const char *json_file = get_option_value(argc, argv, "--json");
+    const char *csv_file = get_option_value(argc, argv, "--csv");
+    const char *trace_file = get_option_value(argc, argv, "--trace");
+    const char *baseline_file = get_option_value(argc, argv, "--baseline");
+    const char *suite_level = get_option_value(argc, argv, "--suite");
+    std::vector<bench_result> results;
+    std::vector<baseline_entry> baseline;
+    bench_options opts;
+    trace_sink traces;
 
-        if(with_count == 1) {
-            start = clock();
-            uniq_count = fui_htable_count(arr_gen, num_elems, &err_flag);
-            end = clock();
-            printf("HTBL_NOF_COUNT :\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+    memset(&opts, 0, sizeof(bench_options));
+    opts.engine_list = get_option_value(argc, argv, "--engines");
+    opts.traces = &traces;
+    if(cmd_flag_parser(argc, argv, "--suite") == 0 || suite_level != NULL) {
+        with_suite = 1;
+        if(suite_level != NULL && strcmp(suite_level, "quick") != 0) {
+            printf("ERROR: unknown suite level '%s'.\n", suite_level);
+            return 3;
         }
     }
+    if(!with_suite && argc < 3) {
+        printf("ERROR: not enough args. USAGE: ./command argv[1] argv[2] CMD_FLAGS \n");
+        return 1;
+    }
+    if(cmd_flag_parser(argc, argv, "--brute") == 0) {
+        opts.with_brute = 1;
+    }
+    if(cmd_flag_parser(argc, argv, "--fio-bin") == 0) {
+        opts.with_fio = 1;
+    }
     else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
+        if(cmd_flag_parser(argc, argv, "--fio-csv") == 0) {
+            opts.with_fio = 2;
         }
-        else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-        }
-        out_ht_stree = fui_htable(arr_input, num_elems_read, &num_elems_out, &err_flag);
-        end = clock();
-        free(arr_input);
-        free(out_ht_stree);
-        printf("HTBL_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-            }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
+    }
+    if(cmd_flag_parser(argc, argv, "--count") == 0) {
+        opts.with_count = 1;
+    }
+    if(cmd_flag_parser(argc, argv, "--mem") == 0) {
+        opts.with_mem = 1;
+    }
+    if(cmd_flag_parser(argc, argv, "--perf") == 0) {
+        with_perf = 1;
+    }
+    if(!with_suite && (string_to_u64_num(argv[1], &num_elems) != 0 || string_to_u32_num(argv[2], &rand_max) != 0 || num_elems == 0)) {
+        printf("ERROR: arguments illegal. Make sure they are plain positive numbers and < 4,294,967,296.\n");
+        return 3;
+    }
+    if(get_u32_option(argc, argv, "--warmup", BENCH_DEFAULT_WARMUP, &opts.warmup) != 0 ||
+        get_u32_option(argc, argv, "--reps", with_suite ? BENCH_SUITE_REPS : BENCH_DEFAULT_REPS, &opts.reps) != 0 || opts.reps == 0 ||
+        get_u32_option(argc, argv, "--threads", 0, &num_threads) != 0 ||
+        get_u64_option(argc, argv, "--seed", BENCH_DEFAULT_SEED, &seed) != 0 ||
+        get_u32_option(argc, argv, "--threshold", BENCH_SUITE_THRESHOLD, &threshold) != 0) {
+        printf("ERROR: illegal --warmup, --reps, --threads, --seed or --threshold value.\n");
+        return 3;
+    }
+    if(dataset_list == NULL) {
+        dataset_list = BENCH_DEFAULT_DATASETS;
+    }
+    if(check_name_list(dataset_list, 0) != 0 || (opts.engine_list != NULL && check_name_list(opts.engine_list, 1) != 0)) {
+        return 3;
+    }
+    if(baseline_file != NULL) {
+        int load_flag = load_baseline(baseline_file, baseline);
+        if(load_flag == 1) {
+            printf("ERROR: '%s' is not a result file of this benchmark.\n", baseline_file);
+            return 13;
+        }
+        if(load_flag != 0) {
+            printf("NOTE: No baseline at '%s', the results will be saved as the baseline.\n", baseline_file);
+        }
+    }
+    set_num_threads(num_threads);
+    if(with_perf) {
+        if(perf_counters_open(&perf) < NUM_PERF_COUNTERS) {
+            printf("NOTE: Counters unavailable on this host:");
+            for(int i = 0; i < NUM_PERF_COUNTERS; i++) {
+                if(perf.fds[i] < 0) {
+                    printf(" %s", perf_counter_names[i]);
+                }
             }
-            uniq_count = fui_htable_count(arr_input, num_elems_read, &err_flag);
-            end = clock();
-            free(arr_input);
-            printf("HTBL_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+            printf(".\n");
         }
+        opts.perf = &perf;
+    }
+    traces.dataset = "";
+    traces.engine = "";
+    if(trace_file != NULL && btas_set_trace_callback(collect_trace, &traces) != 0) {
+        printf("NOTE: The trace points are not compiled in, rebuild with -DBTAS_TRACE for --trace.\n");
+        trace_file = NULL;
     }
 
-    if(with_fio == 0) {
-        start = clock();
-        out_ht_dyn = fui_htable_dyn(arr_gen, num_elems, &num_elems_out, &err_flag);
-        end = clock();
-        free(out_ht_dyn);
-        printf("HTBL_DYN_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            start = clock();
-            uniq_count = fui_htable_dyn_count(arr_gen, num_elems, &err_flag);
-            end = clock();
-            printf("HTBL_DYN_NOF_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+    if(with_suite) {
+        printf("SCENARIO SUITE:\t%s\nSEED:\t\t%" PRIu64 "\nTHREADS:\t%u\nWARMUP/REPS:\t%u/%u\n\n",
+            (suite_level != NULL) ? suite_level : "full", seed, get_num_threads(), opts.warmup, opts.reps);
+        for(size_t c = 0; c < NUM_BENCH_SCENARIOS && ret == 0; c++) {
+            const bench_scenario *cell = &bench_suite[c];
+            if(cell->is_large && suite_level != NULL) {
+                continue;
+            }
+            printf("CELL {%" PRIu64 ", %u}\n", cell->num_elems, cell->rand_max);
+            for(size_t d = 0; d < NUM_BENCH_DATASETS && ret == 0; d++) {
+                if(name_in_list(bench_datasets[d].name, cell->datasets)) {
+                    ret = run_dataset(&bench_datasets[d], cell->num_elems, cell->rand_max, seed, &opts, results);
+                }
+            }
         }
     }
     else {
-        if(with_fio == 1) {
-            start = clock();
-            arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-        }
-        else {
-            start = clock();
-            arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-        }
-        out_ht_dyn = fui_htable_dyn(arr_input, num_elems_read, &num_elems_out, &err_flag);
-        end = clock();
-        free(arr_input);
-        free(out_ht_dyn);
-        printf("HTBL_DYN_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-        if(with_count == 1) {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-            }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-            }
-            uniq_count = fui_htable_dyn_count(arr_input, num_elems_read, &err_flag);
-            end = clock();
-            free(arr_input);
-            printf("HTBL_DYN_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
-        }
-    }
-    
-    if(with_brute == 1) {
-        if(with_fio == 0) {
-            start = clock();
-            out_brute_opt = fui_brute_opt(arr_gen, num_elems, &num_elems_out, &err_flag);
-            end = clock();
-            free(out_brute_opt);
-            printf("BRUTE_OPT_NOF_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-            if(with_count == 1) {
-                start = clock();
-                uniq_count = fui_brute_opt_count(arr_gen, num_elems, &err_flag);
-                end = clock();
-                printf("BRUTE_OPT_NOF_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, uniq_count);
+        printf("INPUT_ELEMS:\t%" PRIu64 "\nRANDOM_MAX:\t%u\nSEED:\t\t%" PRIu64 "\nTHREADS:\t%u\nWARMUP/REPS:\t%u/%u\n\n",
+            num_elems, rand_max, seed, get_num_threads(), opts.warmup, opts.reps);
+        for(size_t d = 0; d < NUM_BENCH_DATASETS && ret == 0; d++) {
+            if(name_in_list(bench_datasets[d].name, dataset_list)) {
+                ret = run_dataset(&bench_datasets[d], num_elems, rand_max, seed, &opts, results);
             }
         }
-        else {
-            if(with_fio == 1) {
-                start = clock();
-                arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-            }
-            else {
-                start = clock();
-                arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-            }
-            out_brute_opt = fui_brute_opt(arr_input, num_elems_read, &num_elems_out, &err_flag);
-            end = clock();
-            free(arr_input);
-            free(out_brute_opt);
-            printf("BRUTE_OPT_FIO_EXPORT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
-
-            if(with_count == 1) {
-                if(with_fio == 1) {
-                    start = clock();
-                    arr_input = import_1d_u32(data_file_bin, "", &num_elems_read, &err_flag);
-                }
-                else {
-                    start = clock();
-                    arr_input = import_1d_u32(data_file_csv, "csv", &num_elems_read, &err_flag);
-                }
-                uniq_count = fui_brute_opt_count(arr_input, num_elems_read, &err_flag);
-                end = clock();
-                free(arr_input);
-                printf("BRUTE_OPT_FIO_COUNT:\t%lf\t%" PRIu64 "\n", (double)(end - start)/CLOCKS_PER_SEC, num_elems_out);
+    }
+    if(with_perf) {
+        perf_counters_close(&perf);
+    }
+    if(ret != 0) {
+        return ret;
+    }
+    if(trace_file != NULL) {
+        btas_set_trace_callback(NULL, NULL);
+        if(write_trace_json(trace_file, traces.records) != 0) {
+            printf("ERROR: Failed to write the trace to '%s'.\n", trace_file);
+            return 11;
+        }
+    }
+    if(json_file != NULL && write_results_json(json_file, results) != 0) {
+        printf("ERROR: Failed to write the results to '%s'.\n", json_file);
+        return 11;
+    }
+    if(csv_file != NULL && write_results_csv(csv_file, results) != 0) {
+        printf("ERROR: Failed to write the results to '%s'.\n", csv_file);
+        return 11;
+    }
+    if(baseline_file != NULL) {
+        int has_baseline = !baseline.empty();
+        if(has_baseline && print_baseline_diff(baseline, results, threshold) != 0) {
+            ret = 13;
+        }
+        if(!has_baseline || cmd_flag_parser(argc, argv, "--update-baseline") == 0) {
+            if(write_results_csv(baseline_file, results) != 0) {
+                printf("ERROR: Failed to write the baseline to '%s'.\n", baseline_file);
+                return 11;
             }
+            printf("Baseline saved to '%s'.\n", baseline_file);
         }
     }
-    print_dup_idx_list(dup_idx_list2, 3);
-    print_out_idx(out_bit_dyn_idx, num_elems_out_idx, 5);
-    free_dup_idx_list(dup_idx_list2);
-    free(out_bit_dyn_idx);
-    printf("\nBenchmark done.\n\n");
-    return 0;
+    printf("Benchmark done.\n\n");
+    return ret;
 }
@@ -7,12 +7,35 @@
  * 
  */
 
+#if defined(BTAS_TRACE) && defined(__unix__) && !defined(_POSIX_C_SOURCE) && !defined(_GNU_SOURCE)
+#define _POSIX_C_SOURCE 200809L /* clock_gettime() */
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <math.h>
 #include <inttypes.h>
+#include <pthread.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "btas.h"
+#if defined(BTAS_TRACE) && defined(BTAS_TRACE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define BTAS_USDT_ENABLED
+#endif
+#endif
+
+static uint32_t num_threads_conf = 0; /* 0 - detect automatically */
+
+const char *btas_phase_names[BTAS_NUM_PHASES] = {
+    "setup", "stem_grow", "branch_alloc", "insert", "teardown", "output"
+};
 
 /**
  * @brief Convert a *unsigned* string ('\0' terminated!) 
@@ -106,7 +129,7 @@ void print_arr(const uint32_t *arr, uint64_t num_elems, uint64_t max_elems) {
     }
     uint64_t i;
     for(i = 0; i < num_elems && i < max_elems; i++) {
-        printf("%d\t", arr[i]);
+        printf("%" PRIu32 "\t", arr[i]);
         if((i + 1) % 10 == 0) {
             printf("\n");
         }
@@ -132,9 +155,152 @@ int compare_arr(const uint32_t *arr_a, const uint32_t *arr_b, uint64_t num_elems
     return 0;
 }
 
+/**
+ * The generators are counter-based: element i is a pure function of 
+ * (seed, i), so the arrays are filled in parallel and a given seed gives
+ * the same array regardless of the number of threads.
+ */
+typedef struct {
+    void *arr;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t num_elems;
+    uint64_t seed;
+    uint64_t range;
+    uint32_t gen_type;
+    uint32_t param;
+    double zipf_skew;
+    double zipf_norm;
+} gen_task;
+
+/* SplitMix64 finalizer over a Weyl sequence. */
+static uint64_t gen_mix64(uint64_t seed, uint64_t counter) {
+    uint64_t z = seed + (counter + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* A bijection over 32-bit integers (MurmurHash3 fmix32). */
+static uint32_t gen_scatter_u32(uint32_t key) {
+    key ^= key >> 16;
+    key *= 0x85EBCA6BU;
+    key ^= key >> 13;
+    key *= 0xC2B2AE35U;
+    return key ^ (key >> 16);
+}
+
+/* floor(rand_bits * range / 2^64): multiply-shift, no modulo bias. */
+static uint32_t gen_range_u32(uint64_t rand_bits, uint32_t range) {
+    uint64_t high = (rand_bits >> 32) * range;
+    uint64_t low = ((rand_bits & 0xFFFFFFFFULL) * range) >> 32;
+    return (uint32_t)((high + low) >> 32);
+}
+
+static uint64_t gen_range_u64(uint64_t rand_bits, uint64_t range) {
+    if(range <= 0xFFFFFFFFULL) {
+        return gen_range_u32(rand_bits, (uint32_t)range);
+    }
+    return rand_bits % range;
+}
+
+/* Inverse-CDF sampling of the continuous approximation of Zipf(s, N). */
+static uint32_t gen_zipf_rank(uint64_t rand_bits, uint64_t num_keys, double skew, double norm) {
+    double u = (double)(rand_bits >> 11) * (1.0 / 9007199254740992.0);
+    double rank = (skew == 1.0) ? exp(u * norm) : pow(1.0 + (1.0 - skew) * u * norm, 1.0 / (1.0 - skew));
+    uint64_t k = (rank < 1.0) ? 1 : (uint64_t)rank;
+    return (uint32_t)((k > num_keys) ? num_keys - 1 : k - 1);
+}
+
+static void *gen_fill_task(void *arg) {
+    gen_task *task = (gen_task *)arg;
+    uint32_t *arr = (uint32_t *)task->arr;
+    uint64_t i;
+    switch(task->gen_type) {
+    case GEN_RANDOM:
+        for(i = task->begin; i < task->end; i++) {
+            arr[i] = gen_range_u32(gen_mix64(task->seed, i), (uint32_t)task->range);
+        }
+        break;
+    case GEN_ZIPF:
+        for(i = task->begin; i < task->end; i++) {
+            uint32_t rank = gen_zipf_rank(gen_mix64(task->seed, i), task->range, task->zipf_skew, task->zipf_norm);
+            arr[i] = gen_scatter_u32(rank ^ (uint32_t)task->seed);
+        }
+        break;
+    case GEN_CLUSTERED:
+        for(i = task->begin; i < task->end; i++) {
+            uint64_t rand_bits = gen_mix64(task->seed, i);
+            uint32_t stem_idx = gen_range_u32(rand_bits, task->param);
+            uint32_t stem = (uint32_t)(gen_mix64(~task->seed, stem_idx) >> 48);
+            arr[i] = (stem << 16) | (uint32_t)(rand_bits & 0xFFFF);
+        }
+        break;
+    case GEN_NEARLY_SORTED:
+        for(i = task->begin; i < task->end; i++) {
+            uint64_t rand_bits = gen_mix64(task->seed, i);
+            int64_t displaced = (int64_t)i;
+            if(gen_range_u32(rand_bits, 1000) < task->param) {
+                displaced += (int64_t)gen_range_u32(gen_mix64(~task->seed, i), 2 * GEN_SORTED_WINDOW + 1) - GEN_SORTED_WINDOW;
+                /* Saturate at the ends, instead of wrapping around to outliers. */
+                displaced = (displaced < 0) ? 0 : ((displaced > (int64_t)task->num_elems - 1) ? (int64_t)task->num_elems - 1 : displaced);
+            }
+            arr[i] = (displaced > (int64_t)UINT32_MAX) ? UINT32_MAX : (uint32_t)displaced;
+        }
+        break;
+    case GEN_REVERSE_SORTED:
+        for(i = task->begin; i < task->end; i++) {
+            arr[i] = (uint32_t)(task->num_elems - 1 - i);
+        }
+        break;
+    case GEN_SPARSE_U64:
+        for(i = task->begin; i < task->end; i++) {
+            ((uint64_t *)task->arr)[i] = gen_mix64(~task->seed, gen_range_u64(gen_mix64(task->seed, i), task->range));
+        }
+        break;
+    default:
+        break;
+    }
+    return NULL;
+}
+
+/* Split [0, num_elems) into one range per worker thread and fill them. */
+static int gen_fill_parallel(gen_task *proto) {
+    uint32_t num_tasks = get_num_threads();
+    if(proto->num_elems < (uint64_t)num_tasks * GEN_TASK_MIN_ELEMS) {
+        num_tasks = (uint32_t)(proto->num_elems / GEN_TASK_MIN_ELEMS);
+        num_tasks = (num_tasks < 1) ? 1 : num_tasks;
+    }
+    gen_task *tasks = (gen_task *)calloc(num_tasks, sizeof(gen_task));
+    if(tasks == NULL) {
+        proto->begin = 0;
+        proto->end = proto->num_elems;
+        gen_fill_task(proto);
+        return 0;
+    }
+    for(uint32_t i = 0; i < num_tasks; i++) {
+        tasks[i] = *proto;
+        tasks[i].begin = proto->num_elems * i / num_tasks;
+        tasks[i].end = proto->num_elems * (i + 1) / num_tasks;
+    }
+    run_parallel_tasks(gen_fill_task, tasks, sizeof(gen_task), num_tasks);
+    free(tasks);
+    return 0;
+}
+
+static void gen_task_init(gen_task *task, void *arr, uint64_t num_elems, uint32_t gen_type, uint64_t seed) {
+    memset(task, 0, sizeof(gen_task));
+    task->arr = arr;
+    task->num_elems = num_elems;
+    task->gen_type = gen_type;
+    task->seed = seed;
+}
+
 /**
  * 
  * @brief Generate random integers and put them into an given array
+ *  The seed is taken from the clock. Use generate_random_arr_seed() 
+ *  for a reproducible array.
  * 
  * @param [in]
  *  *arr is the array pointer
@@ -149,7 +315,28 @@ int compare_arr(const uint32_t *arr_a, const uint32_t *arr_b, uint64_t num_elems
  * 
  */
 int generate_random_input_arr(uint32_t *arr, uint64_t num_elems, uint32_t rand_max) {
-    uint32_t rand_num = 0;
+    return generate_random_arr_seed(arr, num_elems, rand_max, (uint64_t)time(0) ^ ((uint64_t)clock() << 32));
+}
+
+/**
+ * 
+ * @brief Generate uniformly distributed random integers in [0, rand_max)
+ * 
+ * @param [in]
+ *  *arr is the array pointer
+ *  num_elems is the size of the given integer array
+ *  rand_max is the upper bound (exclusive) of the generated numbers
+ *  seed selects the sequence. The same seed gives the same array.
+ * 
+ * @returns
+ *  0 if succeeded
+ *  -5 if the arr pointer is null
+ *  -3 if the num_elems is 0
+ *  -1 if the rand_max is 0
+ * 
+ */
+int generate_random_arr_seed(uint32_t *arr, uint64_t num_elems, uint32_t rand_max, uint64_t seed) {
+    gen_task task;
     if(arr == NULL) {
         return -5;
     }
@@ -159,18 +346,177 @@ int generate_random_input_arr(uint32_t *arr, uint64_t num_elems, uint32_t rand_m
     if(rand_max < 1) {
         return -1;
     }
-    srand(time(0));
-    for(uint64_t i = 0; i < num_elems; i++) {
-        if(RAND_MAX == 0x7fff) {
-            rand_num = (((uint32_t)rand() << 16) | (uint32_t)rand()) % rand_max;
-        }
-        else{
-            rand_num = (uint32_t)rand() % rand_max;
-        }
-        arr[i] = rand_num;
+    gen_task_init(&task, arr, num_elems, GEN_RANDOM, seed);
+    task.range = rand_max;
+    return gen_fill_parallel(&task);
+}
+
+/**
+ * 
+ * @brief Generate a skewed (Zipfian) integer array: the k-th most frequent
+ *  key appears with a probability proportional to 1/k^skew. The num_keys 
+ *  keys are scattered over the whole 32-bit space.
+ * 
+ * @param [in]
+ *  *arr is the array pointer
+ *  num_elems is the size of the given integer array
+ *  num_keys is the number of distinct keys to draw from
+ *  skew is the Zipf exponent, e.g. 0.99 (> 0)
+ *  seed selects the sequence
+ * 
+ * @returns
+ *  0 if succeeded
+ *  -5 if the arr pointer is null
+ *  -3 if the num_elems is 0
+ *  -1 if the num_keys is 0 or the skew is not positive
+ * 
+ */
+int generate_zipf_arr(uint32_t *arr, uint64_t num_elems, uint32_t num_keys, double skew, uint64_t seed) {
+    gen_task task;
+    if(arr == NULL) {
+        return -5;
     }
-    //print_arr(arr, num_elems);
-    return 0;
+    if(num_elems < 1) {
+        return -3;
+    }
+    if(num_keys < 1 || !(skew > 0.0)) {
+        return -1;
+    }
+    gen_task_init(&task, arr, num_elems, GEN_ZIPF, seed);
+    task.range = num_keys;
+    task.zipf_skew = skew;
+    /* The integral of x^-skew over [1, num_keys + 1) */
+    task.zipf_norm = (skew == 1.0) ? log((double)num_keys + 1.0) : (pow((double)num_keys + 1.0, 1.0 - skew) - 1.0) / (1.0 - skew);
+    return gen_fill_parallel(&task);
+}
+
+/**
+ * 
+ * @brief Generate integers clustered in a few h16 stems: every element
+ *  falls into one of num_stems randomly chosen 65536-wide ranges.
+ * 
+ * @param [in]
+ *  *arr is the array pointer
+ *  num_elems is the size of the given integer array
+ *  num_stems is the number of stems (1 ~ 65536) to cluster in
+ *  seed selects the sequence
+ * 
+ * @returns
+ *  0 if succeeded
+ *  -5 if the arr pointer is null
+ *  -3 if the num_elems is 0
+ *  -1 if the num_stems is out of range
+ * 
+ */
+int generate_clustered_arr(uint32_t *arr, uint64_t num_elems, uint32_t num_stems, uint64_t seed) {
+    gen_task task;
+    if(arr == NULL) {
+        return -5;
+    }
+    if(num_elems < 1) {
+        return -3;
+    }
+    if(num_stems < 1 || num_stems > 65536) {
+        return -1;
+    }
+    gen_task_init(&task, arr, num_elems, GEN_CLUSTERED, seed);
+    task.param = num_stems;
+    return gen_fill_parallel(&task);
+}
+
+/**
+ * 
+ * @brief Generate a nearly-sorted integer array: a growing array where 
+ *  disorder_permille of every 1000 elements are moved by up to 
+ *  GEN_SORTED_WINDOW (plus or minus).
+ * 
+ * @param [in]
+ *  *arr is the array pointer
+ *  num_elems is the size of the given integer array
+ *  disorder_permille is the share (0 ~ 1000) of displaced elements
+ *  seed selects the sequence
+ * 
+ * @returns
+ *  0 if succeeded
+ *  -5 if the arr pointer is null
+ *  -3 if the num_elems is 0
+ *  -1 if the disorder_permille is > 1000
+ * 
+ */
+int generate_nearly_sorted_arr(uint32_t *arr, uint64_t num_elems, uint32_t disorder_permille, uint64_t seed) {
+    gen_task task;
+    if(arr == NULL) {
+        return -5;
+    }
+    if(num_elems < 1) {
+        return -3;
+    }
+    if(disorder_permille > 1000) {
+        return -1;
+    }
+    gen_task_init(&task, arr, num_elems, GEN_NEARLY_SORTED, seed);
+    task.param = disorder_permille;
+    return gen_fill_parallel(&task);
+}
+
+/**
+ * 
+ * @brief Generate a reverse-sorted (single-direction decreasing) array
+ * 
+ * @param [in]
+ *  *arr is the array pointer
+ *  num_elems is the size of the given integer array
+ * 
+ * @returns
+ *  0 if succeeded
+ *  -5 if the arr pointer is null
+ *  -3 if the num_elems is 0
+ * 
+ */
+int generate_reverse_sorted_arr(uint32_t *arr, uint64_t num_elems) {
+    gen_task task;
+    if(arr == NULL) {
+        return -5;
+    }
+    if(num_elems < 1) {
+        return -3;
+    }
+    gen_task_init(&task, arr, num_elems, GEN_REVERSE_SORTED, 0);
+    return gen_fill_parallel(&task);
+}
+
+/**
+ * 
+ * @brief Generate sparse 64-bit keys: num_distinct distinct keys spread
+ *  over the whole 64-bit space, drawn uniformly.
+ * 
+ * @param [in]
+ *  *arr is the array pointer
+ *  num_elems is the size of the given integer array
+ *  num_distinct is the number of distinct keys to draw from
+ *  seed selects the sequence
+ * 
+ * @returns
+ *  0 if succeeded
+ *  -5 if the arr pointer is null
+ *  -3 if the num_elems is 0
+ *  -1 if the num_distinct is 0
+ * 
+ */
+int generate_sparse_u64_arr(uint64_t *arr, uint64_t num_elems, uint64_t num_distinct, uint64_t seed) {
+    gen_task task;
+    if(arr == NULL) {
+        return -5;
+    }
+    if(num_elems < 1) {
+        return -3;
+    }
+    if(num_distinct < 1) {
+        return -1;
+    }
+    gen_task_init(&task, arr, num_elems, GEN_SPARSE_U64, seed);
+    task.range = num_distinct;
+    return gen_fill_parallel(&task);
 }
 
 /**
@@ -231,101 +577,429 @@ int cmd_flag_parser(int argc, char **argv, const char *cmd_flag) {
 }
 
 /**
+ * @brief Set the number of worker threads used by the parallel routines
+ *   (e.g. the CSV parser). 0 restores the automatic detection.
+ */
+void set_num_threads(uint32_t num_threads) {
+    num_threads_conf = num_threads;
+}
+
+/**
+ * @brief Get the number of worker threads used by the parallel routines
  * 
- * @brief Filter out the unique integers from a given array in the 
- *  brute/naive way
+ * @returns
+ *   The number set by set_num_threads(), or the number of online
+ *   processors if not set, or 1 if it cannot be detected
+ */
+uint32_t get_num_threads(void) {
+    if(num_threads_conf > 0) {
+        return num_threads_conf;
+    }
+#if defined(_SC_NPROCESSORS_ONLN)
+    long num_procs = sysconf(_SC_NPROCESSORS_ONLN);
+    if(num_procs > 0) {
+        return (uint32_t)num_procs;
+    }
+#endif
+    return 1;
+}
+
+/**
+ * @brief Run num_tasks tasks in parallel. The task 0 runs in the calling
+ *   thread, the others run in new threads. If a thread cannot be created,
+ *   its task runs in the calling thread after the others are launched.
  * 
  * @param [in]
- *  *input_arr is the given array pointer
- *  num_elems is the number of the integer elems in the given array
- *  
- * @param [out]
- *  *num_elems_out is the number of the output unique integers
- *  *err_flag is for debugging errors
+ *   task_func is the worker function
+ *   task_args is an array of num_tasks task arguments, each arg_size bytes
  * 
  * @returns
- *  The pointer of the allocated output array if succeeded
- *  NULL if any error happens
- * 
+ *   -3 if task_func or task_args is NULL
+ *   -1 if num_tasks is 0
+ *    0 if all the tasks finished
  */
-uint32_t* fui_brute(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag){
-    uint64_t i, j = 1, k;
-    uint32_t tmp = 0;
-    uint32_t *final_output_arr = NULL;
-    *err_flag = 0;
-    *num_elems_out = 0;
-    if (input_arr == NULL) {
-        *err_flag = -5;
-        return NULL;
-    }
-    if (num_elems < 1){
-        *err_flag = -3;
-        return NULL;
-    }
-    uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
-    if (output_arr == NULL) {
-        *err_flag = -1;
-        return NULL;
-    }
-    output_arr[0] = input_arr[0];
-    for(i = 1; i < num_elems; i++) {
-        tmp = input_arr[i];
-        for(k = 0; k < j; k++) {
-            if(tmp == output_arr[k]) {
-                break;
-            }
-        }
-        if(k == j) {
-            output_arr[j] = tmp;
-            j++;
-        }
+int run_parallel_tasks(void *(*task_func)(void *), void *task_args, size_t arg_size, uint32_t num_tasks) {
+    if(task_func == NULL || task_args == NULL) {
+        return -3;
     }
-    final_output_arr = (uint32_t *)realloc(output_arr, j * sizeof(uint32_t));
-    if(final_output_arr == NULL) {
-        free(output_arr);
-        *err_flag = 1;
-        return NULL;
+    if(num_tasks < 1) {
+        return -1;
     }
-    *num_elems_out = j;
-    return final_output_arr;
-}
-
-uint64_t fui_brute_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag) {
-    uint64_t i, j = 1, k;
-    uint32_t tmp = 0;
-    *err_flag = 0;
-    if (input_arr == NULL) {
-        *err_flag = -5;
+    char *args = (char *)task_args;
+    if(num_tasks == 1) {
+        task_func(args);
         return 0;
     }
-    if (num_elems < 1){
-        *err_flag = -3;
+    pthread_t *threads = (pthread_t *)calloc(num_tasks, sizeof(pthread_t));
+    uint8_t *launched = (uint8_t *)calloc(num_tasks, sizeof(uint8_t));
+    if(threads == NULL || launched == NULL) {
+        free(threads);
+        free(launched);
+        for(uint32_t i = 0; i < num_tasks; i++) {
+            task_func(args + i * arg_size);
+        }
         return 0;
     }
-    uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
-    if (output_arr == NULL) {
-        *err_flag = -1;
-        return 0;
+    for(uint32_t i = 1; i < num_tasks; i++) {
+        launched[i] = (pthread_create(&threads[i], NULL, task_func, args + i * arg_size) == 0);
     }
-    output_arr[0] = input_arr[0];
-    for(i = 1; i < num_elems; i++) {
-        tmp = input_arr[i];
-        for(k = 0; k < j; k++) {
-            if(tmp == output_arr[k]) {
-                break;
-            }
+    task_func(args);
+    for(uint32_t i = 1; i < num_tasks; i++) {
+        if(launched[i]) {
+            pthread_join(threads[i], NULL);
         }
-        if(k == j) {
-            output_arr[j] = tmp;
-            j++;
+        else {
+            task_func(args + i * arg_size);
         }
     }
-    free(output_arr);
-    return j;
+    free(threads);
+    free(launched);
+    return 0;
 }
 
 /**
- * 
+ * @brief Clear the memory accounting of a call (if requested)
+ */
+static void stats_reset(btas_stats *stats) {
+    if(stats != NULL) {
+        memset(stats, 0, sizeof(btas_stats));
+    }
+}
+
+/**
+ * @brief Account a BitTree stem of stem_length entries, its branches and 
+ *   the output buffer. The stem is scanned only if stats is requested.
+ */
+static void stats_count_bitmap(btas_stats *stats, const bitmap_base *bitmap_head, uint32_t stem_length, uint64_t output_bytes) {
+    if(stats == NULL || bitmap_head == NULL) {
+        return;
+    }
+    for(uint32_t i = 0; i < stem_length; i++) {
+        stats->num_branches += (bitmap_head[i].ptr_branch != NULL);
+    }
+    stats->stem_length = stem_length;
+    stats->stem_bytes = (uint64_t)stem_length * sizeof(bitmap_base);
+    stats->branch_bytes = stats->num_branches * BITMAP_BRANCH_SIZE;
+    stats->output_bytes = output_bytes;
+    stats->peak_bytes = stats->stem_bytes + stats->branch_bytes + stats->output_bytes;
+}
+
+/**
+ * @brief Account a reusable context without scanning its stem. The spare
+ *   branches are held memory, so they are counted as well.
+ */
+static void stats_count_ctx(btas_stats *stats, const bitmap_ctx *ctx, uint64_t output_bytes) {
+    if(stats == NULL) {
+        return;
+    }
+    stats->num_branches = (uint64_t)ctx->tree.num_branches + ctx->num_spare;
+    stats->stem_length = ctx->tree.bitmap_base_size;
+    stats->stem_bytes = (uint64_t)ctx->tree.bitmap_base_size * sizeof(bitmap_base);
+    stats->branch_bytes = stats->num_branches * BITMAP_BRANCH_SIZE;
+    stats->index_bytes = (uint64_t)BITMAP_LENGTH_MAX * (sizeof(uint16_t) + sizeof(uint8_t *));
+    stats->output_bytes = output_bytes;
+    stats->peak_bytes = stats->stem_bytes + stats->branch_bytes + stats->index_bytes + stats->output_bytes;
+}
+
+static void stats_count_htable(btas_stats *stats, uint8_t *const hash_table[], uint32_t stem_length, uint64_t output_bytes) {
+    if(stats == NULL) {
+        return;
+    }
+    for(uint32_t i = 0; i < stem_length; i++) {
+        stats->num_branches += (hash_table[i] != NULL);
+    }
+    stats->stem_length = stem_length;
+    stats->stem_bytes = (uint64_t)stem_length * sizeof(uint8_t *);
+    stats->branch_bytes = stats->num_branches * HT_BRANCH_SIZE;
+    stats->output_bytes = output_bytes;
+    stats->peak_bytes = stats->stem_bytes + stats->branch_bytes + stats->output_bytes;
+}
+
+static void stats_count_htable_new(btas_stats *stats, const htable_base hash_table[], uint32_t stem_length, uint64_t output_bytes) {
+    if(stats == NULL || hash_table == NULL) {
+        return;
+    }
+    for(uint32_t i = 0; i < stem_length; i++) {
+        if(hash_table[i].ptr_branch != NULL) {
+            stats->num_branches++;
+            stats->branch_bytes += hash_table[i].branch_size;
+        }
+    }
+    stats->stem_length = stem_length;
+    stats->stem_bytes = (uint64_t)stem_length * sizeof(htable_base);
+    stats->output_bytes = output_bytes;
+    stats->peak_bytes = stats->stem_bytes + stats->branch_bytes + stats->output_bytes;
+}
+
+/**
+ * Small-input path. Below SMALL_INPUT_MAX integers, the stems, the branches
+ * and the output shrinking of the engines cost more than the dedup itself.
+ * A small open-addressing table on the stack (at most 32 KiB, so it stays
+ * in L1) dedups them instead, keeping the order of the first occurrences
+ * as the engines do. The slot value 0 means empty, so 0 is tracked apart.
+ */
+static uint64_t small_dedup(const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr) {
+    uint32_t table[SMALL_TABLE_SIZE];
+    uint32_t table_bits = 4, has_zero = 0;
+    uint64_t i, j = 0;
+    while((1ULL << table_bits) < (num_elems << 1)) {
+        table_bits++;
+    }
+    uint32_t mask = (1U << table_bits) - 1;
+    memset(table, 0, (mask + 1) * sizeof(uint32_t));
+    for(i = 0; i < num_elems; i++) {
+        uint32_t tmp = input_arr[i];
+        if(tmp == 0) {
+            if(has_zero) {
+                continue;
+            }
+            has_zero = 1;
+        }
+        else {
+            uint32_t slot = (tmp * 0x9E3779B1U) >> (32 - table_bits);
+            while(table[slot] != 0 && table[slot] != tmp) {
+                slot = (slot + 1) & mask;
+            }
+            if(table[slot] == tmp) {
+                continue;
+            }
+            table[slot] = tmp;
+        }
+        if(output_arr != NULL) {
+            output_arr[j] = tmp;
+        }
+        j++;
+    }
+    return j;
+}
+
+static void stats_count_small(btas_stats *stats, uint64_t num_elems, uint64_t output_bytes) {
+    if(stats == NULL) {
+        return;
+    }
+    uint64_t table_size = 16;
+    while(table_size < (num_elems << 1)) {
+        table_size <<= 1;
+    }
+    stats->index_bytes = table_size * sizeof(uint32_t) + num_elems * sizeof(uint32_t);
+    stats->output_bytes = output_bytes;
+    stats->peak_bytes = stats->index_bytes + stats->output_bytes;
+}
+
+/* Dedup to a stack buffer first, so the output is allocated at its size. */
+static uint32_t* fui_small(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    uint32_t uniq_arr[SMALL_INPUT_MAX];
+    uint64_t j = small_dedup(input_arr, num_elems, uniq_arr);
+    uint32_t *output_arr = (uint32_t *)malloc(j * sizeof(uint32_t));
+    if(output_arr == NULL) {
+        *err_flag = -1;
+        return NULL;
+    }
+    memcpy(output_arr, uniq_arr, j * sizeof(uint32_t));
+    stats_count_small(stats, num_elems, j * sizeof(uint32_t));
+    *num_elems_out = j;
+    return output_arr;
+}
+
+static uint64_t fui_small_count(const uint32_t *input_arr, const uint64_t num_elems, btas_stats *stats) {
+    stats_count_small(stats, num_elems, 0);
+    return small_dedup(input_arr, num_elems, NULL);
+}
+
+/**
+ * Trace points. They expand to nothing unless compiled with -DBTAS_TRACE,
+ * so the engines pay nothing for them by default.
+ */
+#ifdef BTAS_TRACE
+static btas_trace_func trace_callback = NULL;
+static void *trace_user_data = NULL;
+
+#define TRACE_DECL(tr)                  btas_trace tr
+#define TRACE_BEGIN(tr, name, n)        trace_begin(&(tr), (name), (n))
+#define TRACE_PHASE_BEGIN(tr, phase)    trace_phase_begin(&(tr), (phase))
+#define TRACE_PHASE_END(tr, phase)      trace_phase_end(&(tr), (phase))
+#define TRACE_END(tr, err)              trace_end(&(tr), (err))
+
+static uint64_t trace_now_ns(void) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+#else
+    return (uint64_t)clock() * (1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+
+static void trace_begin(btas_trace *trace, const char *engine, uint64_t num_elems) {
+    memset(trace, 0, sizeof(btas_trace));
+    trace->engine = engine;
+    trace->num_elems = num_elems;
+    trace->start_ns = trace_now_ns();
+}
+
+static void trace_phase_begin(btas_trace *trace, int phase) {
+    uint64_t now = trace_now_ns();
+    if(trace->phase_count[phase] == 0) {
+        trace->phase_first_ns[phase] = now;
+    }
+    trace->phase_open_ns[phase] = now;
+}
+
+static void trace_phase_end(btas_trace *trace, int phase) {
+    trace->phase_ns[phase] += trace_now_ns() - trace->phase_open_ns[phase];
+    trace->phase_count[phase]++;
+}
+
+static void trace_end(btas_trace *trace, int err_flag) {
+    trace->end_ns = trace_now_ns();
+    trace->err_flag = err_flag;
+#ifdef BTAS_USDT_ENABLED
+    DTRACE_PROBE4(btas, call, trace->engine, trace->num_elems, trace->end_ns - trace->start_ns, err_flag);
+    for(int i = 0; i < BTAS_NUM_PHASES; i++) {
+        if(trace->phase_count[i] != 0) {
+            DTRACE_PROBE4(btas, phase, trace->engine, i, trace->phase_ns[i], trace->phase_count[i]);
+        }
+    }
+#endif
+    if(trace_callback != NULL) {
+        trace_callback(trace, trace_user_data);
+    }
+}
+#else
+#define TRACE_DECL(tr)
+#define TRACE_BEGIN(tr, name, n)        ((void)0)
+#define TRACE_PHASE_BEGIN(tr, phase)    ((void)0)
+#define TRACE_PHASE_END(tr, phase)      ((void)0)
+#define TRACE_END(tr, err)              ((void)0)
+#endif
+
+/**
+ * @brief Set (or clear with NULL) the callback that receives the trace of
+ *   every traced call. Set it before running the engines, it is not
+ *   synchronized with the calls.
+ * 
+ * @returns
+ *  0 if set
+ *  -1 if the trace points are not compiled in (build with -DBTAS_TRACE)
+ */
+int btas_set_trace_callback(btas_trace_func func, void *user_data) {
+#ifdef BTAS_TRACE
+    trace_callback = func;
+    trace_user_data = user_data;
+    return 0;
+#else
+    (void)func;
+    (void)user_data;
+    return -1;
+#endif
+}
+
+/**
+ * 
+ * @brief Filter out the unique integers from a given array in the 
+ *  brute/naive way
+ * 
+ * @param [in]
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the integer elems in the given array
+ *  
+ * @param [out]
+ *  *num_elems_out is the number of the output unique integers
+ *  *err_flag is for debugging errors
+ * 
+ * @returns
+ *  The pointer of the allocated output array if succeeded
+ *  NULL if any error happens
+ * 
+ */
+uint32_t* fui_brute(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats){
+    uint64_t i, j = 1, k;
+    uint32_t tmp = 0;
+    uint32_t *final_output_arr = NULL;
+    *err_flag = 0;
+    stats_reset(stats);
+    *num_elems_out = 0;
+    if (input_arr == NULL) {
+        *err_flag = -5;
+        return NULL;
+    }
+    if (num_elems < 1){
+        *err_flag = -3;
+        return NULL;
+    }
+    uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
+    if (output_arr == NULL) {
+        *err_flag = -1;
+        return NULL;
+    }
+    if(stats != NULL) {
+        stats->output_bytes = num_elems * sizeof(uint32_t);
+        stats->peak_bytes = stats->output_bytes;
+    }
+    output_arr[0] = input_arr[0];
+    for(i = 1; i < num_elems; i++) {
+        tmp = input_arr[i];
+        for(k = 0; k < j; k++) {
+            if(tmp == output_arr[k]) {
+                break;
+            }
+        }
+        if(k == j) {
+            output_arr[j] = tmp;
+            j++;
+        }
+    }
+    final_output_arr = (uint32_t *)realloc(output_arr, j * sizeof(uint32_t));
+    if(final_output_arr == NULL) {
+        free(output_arr);
+        *err_flag = 1;
+        return NULL;
+    }
+    *num_elems_out = j;
+    return final_output_arr;
+}
+
+uint64_t fui_brute_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
+    uint64_t i, j = 1, k;
+    uint32_t tmp = 0;
+    *err_flag = 0;
+    stats_reset(stats);
+    if (input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    if (num_elems < 1){
+        *err_flag = -3;
+        return 0;
+    }
+    uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
+    if (output_arr == NULL) {
+        *err_flag = -1;
+        return 0;
+    }
+    if(stats != NULL) {
+        stats->output_bytes = num_elems * sizeof(uint32_t);
+        stats->peak_bytes = stats->output_bytes;
+    }
+    output_arr[0] = input_arr[0];
+    for(i = 1; i < num_elems; i++) {
+        tmp = input_arr[i];
+        for(k = 0; k < j; k++) {
+            if(tmp == output_arr[k]) {
+                break;
+            }
+        }
+        if(k == j) {
+            output_arr[j] = tmp;
+            j++;
+        }
+    }
+    free(output_arr);
+    return j;
+}
+
+/**
+ * 
  * @brief Filter out the unique integers from a given array in improved
  *  algorithm
  * 
@@ -342,13 +1016,14 @@ uint64_t fui_brute_count(const uint32_t *input_arr, const uint64_t num_elems, in
  *  NULL if any error happens
  * 
  */
-uint32_t* fui_brute_opt(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag){
+uint32_t* fui_brute_opt(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats){
     uint64_t i, j = 1, k;
     uint32_t max_current, min_current, diff_to_max = 0, diff_to_min = 0;
     int64_t tmp_diff_to_max = 0, tmp_diff_to_min = 0;
     uint32_t tmp = 0;
     uint32_t *final_output_arr = NULL;
     *err_flag = 0;
+    stats_reset(stats);
     *num_elems_out = 0;
     if (input_arr == NULL) {
         *err_flag = -5;
@@ -365,6 +1040,10 @@ uint32_t* fui_brute_opt(const uint32_t *input_arr, const uint64_t num_elems, uin
     }
     max_current = input_arr[0];
     min_current = input_arr[0];
+    if(stats != NULL) {
+        stats->output_bytes = num_elems * sizeof(uint32_t);
+        stats->peak_bytes = stats->output_bytes;
+    }
     output_arr[0] = input_arr[0];
     for(i = 1; i < num_elems; i++) {
         tmp = input_arr[i];
@@ -417,12 +1096,13 @@ uint32_t* fui_brute_opt(const uint32_t *input_arr, const uint64_t num_elems, uin
     return final_output_arr;
 }
 
-uint64_t fui_brute_opt_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag) {
+uint64_t fui_brute_opt_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 1, k;
     uint32_t max_current, min_current, diff_to_max = 0, diff_to_min = 0;
     int64_t tmp_diff_to_max = 0, tmp_diff_to_min = 0;
     uint32_t tmp = 0;
     *err_flag = 0;
+    stats_reset(stats);
     if (input_arr == NULL) {
         *err_flag = -5;
         return 0;
@@ -438,6 +1118,10 @@ uint64_t fui_brute_opt_count(const uint32_t *input_arr, const uint64_t num_elems
     }
     max_current = input_arr[0];
     min_current = input_arr[0];
+    if(stats != NULL) {
+        stats->output_bytes = num_elems * sizeof(uint32_t);
+        stats->peak_bytes = stats->output_bytes;
+    }
     output_arr[0] = input_arr[0];
     for(i = 1; i < num_elems; i++) {
         tmp = input_arr[i];
@@ -518,13 +1202,13 @@ void free_hash_table_new(htable_base hash_table_new[], uint32_t num_elems) {
  *  NULL if any error happens
  * 
  */
-uint32_t* fui_htable(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag) {
+uint32_t* fui_htable(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0;
     uint32_t *final_output_arr = NULL;
-    uint8_t *hash_table_base[HT_STEM_SIZE] = {NULL,};
     *err_flag = 0;
+    stats_reset(stats);
     *num_elems_out = 0;
     if (input_arr == NULL) {
         *err_flag = -5;
@@ -534,6 +1218,10 @@ uint32_t* fui_htable(const uint32_t *input_arr, const uint64_t num_elems, uint64
         *err_flag = -3;
         return NULL;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small(input_arr, num_elems, num_elems_out, err_flag, stats);
+    }
+    uint8_t *hash_table_base[HT_STEM_SIZE] = {NULL,};
     uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(int32_t));
     if (output_arr == NULL) {
         *err_flag = -1;
@@ -557,6 +1245,7 @@ uint32_t* fui_htable(const uint32_t *input_arr, const uint64_t num_elems, uint64
         (hash_table_base[h16])[l16] = 1;
     }
 free_memory:
+    stats_count_htable(stats, hash_table_base, HT_STEM_SIZE, num_elems * sizeof(uint32_t));
     free_hash_table(hash_table_base, HT_STEM_SIZE);
     if(*err_flag != 0) {
         free(output_arr);
@@ -572,12 +1261,12 @@ free_memory:
     return final_output_arr;
 }
 
-uint64_t fui_htable_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag) {
+uint64_t fui_htable_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0;
-    uint8_t *hash_table_base[HT_STEM_SIZE] = {NULL,};
     *err_flag = 0;
+    stats_reset(stats);
     if (input_arr == NULL) {
         *err_flag = -5;
         return 0;
@@ -586,6 +1275,10 @@ uint64_t fui_htable_count(const uint32_t *input_arr, const uint64_t num_elems, i
         *err_flag = -3;
         return 0;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small_count(input_arr, num_elems, stats);
+    }
+    uint8_t *hash_table_base[HT_STEM_SIZE] = {NULL,};
     for(i = 0; i < num_elems; i++) {
         tmp = input_arr[i];
         h16 = (uint16_t)(tmp >> 16);
@@ -603,6 +1296,7 @@ uint64_t fui_htable_count(const uint32_t *input_arr, const uint64_t num_elems, i
         (hash_table_base[h16])[l16] = 1;
     }
 free_memory:
+    stats_count_htable(stats, hash_table_base, HT_STEM_SIZE, 0);
     free_hash_table(hash_table_base, HT_STEM_SIZE);
     if(*err_flag != 0) {
         return 0;
@@ -628,14 +1322,14 @@ free_memory:
  *  NULL if any error happens
  * 
  */
-uint32_t* fui_htable_new(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag) {
+uint32_t* fui_htable_new(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0;
     uint32_t *final_output_arr = NULL;
     uint8_t *tmp_realloc_ptr = NULL;
-    htable_base hash_table_base[HT_STEM_SIZE] = {{0, NULL},};
     *err_flag = 0;
+    stats_reset(stats);
     *num_elems_out = 0;
     if (input_arr == NULL) {
         *err_flag = -5;
@@ -645,6 +1339,10 @@ uint32_t* fui_htable_new(const uint32_t *input_arr, const uint64_t num_elems, ui
         *err_flag = -3;
         return NULL;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small(input_arr, num_elems, num_elems_out, err_flag, stats);
+    }
+    htable_base hash_table_base[HT_STEM_SIZE] = {{0, NULL},};
     uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
     if (output_arr == NULL) {
         *err_flag = -1;
@@ -684,6 +1382,7 @@ uint32_t* fui_htable_new(const uint32_t *input_arr, const uint64_t num_elems, ui
         (hash_table_base[h16].ptr_branch)[l16] = 1;
     }
 free_memory:
+    stats_count_htable_new(stats, hash_table_base, HT_STEM_SIZE, num_elems * sizeof(uint32_t));
     free_hash_table_new(hash_table_base, HT_STEM_SIZE);
     if(*err_flag != 0) {
         free(output_arr);
@@ -699,13 +1398,13 @@ free_memory:
     return final_output_arr;
 }
 
-uint64_t fui_htable_new_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag) {
+uint64_t fui_htable_new_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0;
     uint8_t *tmp_realloc_ptr = NULL;
-    htable_base hash_table_base[HT_STEM_SIZE] = {{0, NULL},};
     *err_flag = 0;
+    stats_reset(stats);
     if (input_arr == NULL) {
         *err_flag = -5;
         return 0;
@@ -714,6 +1413,10 @@ uint64_t fui_htable_new_count(const uint32_t *input_arr, const uint64_t num_elem
         *err_flag = -3;
         return 0;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small_count(input_arr, num_elems, stats);
+    }
+    htable_base hash_table_base[HT_STEM_SIZE] = {{0, NULL},};
     for(i = 0; i < num_elems; i++) {
         tmp = input_arr[i];
         h16 = (uint16_t)(tmp >> 16);
@@ -747,6 +1450,7 @@ uint64_t fui_htable_new_count(const uint32_t *input_arr, const uint64_t num_elem
         (hash_table_base[h16].ptr_branch)[l16] = 1;
     }
 free_memory:
+    stats_count_htable_new(stats, hash_table_base, HT_STEM_SIZE, 0);
     free_hash_table_new(hash_table_base, HT_STEM_SIZE);
     if(*err_flag != 0) {
         return 0;
@@ -773,7 +1477,7 @@ free_memory:
  *  NULL if any error happens
  * 
  */
-uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag) {
+uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0;
@@ -781,7 +1485,9 @@ uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, ui
     uint8_t *tmp_realloc_ptr = NULL;
     htable_base *hash_table_base = NULL, *tmp_ht_realloc_ptr = NULL;
     uint32_t ht_base_length = HT_DYN_INI_SIZE;
+    TRACE_DECL(trace);
     *err_flag = 0;
+    stats_reset(stats);
     *num_elems_out = 0;
     if (input_arr == NULL) {
         *err_flag = -5;
@@ -791,22 +1497,32 @@ uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, ui
         *err_flag = -3;
         return NULL;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small(input_arr, num_elems, num_elems_out, err_flag, stats);
+    }
+    TRACE_BEGIN(trace, "fui_htable_dyn", num_elems);
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_SETUP);
     hash_table_base = (htable_base *)calloc(HT_DYN_INI_SIZE, sizeof(htable_base));
     if(hash_table_base == NULL) {
         *err_flag = 5;
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
     uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
     if (output_arr == NULL) {
         free(hash_table_base);
         *err_flag = -1;
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
+    TRACE_PHASE_END(trace, BTAS_PHASE_SETUP);
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_INSERT);
     for(i = 0; i < num_elems; i++) {
         tmp = input_arr[i];
         h16 = (uint16_t)(tmp >> 16);
         l16 = (uint16_t)(tmp & 0xFFFF);
         if((h16 + 1) > ht_base_length) {
+            TRACE_PHASE_BEGIN(trace, BTAS_PHASE_STEM_GROW);
             tmp_ht_realloc_ptr = (htable_base *)realloc(hash_table_base, (h16 + 1) * sizeof(htable_base));
             if(tmp_ht_realloc_ptr == NULL) {
                 *err_flag = 7;
@@ -815,8 +1531,10 @@ uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, ui
             memset(tmp_ht_realloc_ptr + ht_base_length, 0, (h16 + 1 - ht_base_length) * sizeof(htable_base));
             hash_table_base = tmp_ht_realloc_ptr;
             ht_base_length = (h16 + 1);
+            TRACE_PHASE_END(trace, BTAS_PHASE_STEM_GROW);
         }
         if(hash_table_base[h16].ptr_branch == NULL) {
+            TRACE_PHASE_BEGIN(trace, BTAS_PHASE_BRANCH_ALLOC);
             if((hash_table_base[h16].ptr_branch = (uint8_t *)calloc(l16 + 1, sizeof(uint8_t))) == NULL) {
                 *err_flag = 1;
                 goto free_memory;
@@ -824,9 +1542,11 @@ uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, ui
             else {
                 hash_table_base[h16].branch_size = l16 + 1;
             }
+            TRACE_PHASE_END(trace, BTAS_PHASE_BRANCH_ALLOC);
         }
         else {
             if(hash_table_base[h16].branch_size < (l16 + 1)){
+                TRACE_PHASE_BEGIN(trace, BTAS_PHASE_BRANCH_ALLOC);
                 if((tmp_realloc_ptr = (uint8_t *)realloc(hash_table_base[h16].ptr_branch, (l16 + 1) * sizeof(uint8_t))) == NULL) {
                     *err_flag = 1;
                     goto free_memory;
@@ -836,6 +1556,7 @@ uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, ui
                     memset(tmp_realloc_ptr + hash_table_base[h16].branch_size, 0, sizeof(uint8_t) * (l16 + 1 - hash_table_base[h16].branch_size));
                     hash_table_base[h16].branch_size = l16 + 1;
                 }
+                TRACE_PHASE_END(trace, BTAS_PHASE_BRANCH_ALLOC);
             }
         }
         if(hash_table_base[h16].ptr_branch != NULL && (hash_table_base[h16].ptr_branch)[l16] != 0) {
@@ -846,22 +1567,32 @@ uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, ui
         (hash_table_base[h16].ptr_branch)[l16] = 1;
     }
 free_memory:
+    TRACE_PHASE_END(trace, BTAS_PHASE_INSERT);
+    stats_count_htable_new(stats, hash_table_base, ht_base_length, num_elems * sizeof(uint32_t));
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_TEARDOWN);
     free_hash_table_new(hash_table_base, ht_base_length);
+    free(hash_table_base);
+    TRACE_PHASE_END(trace, BTAS_PHASE_TEARDOWN);
     if(*err_flag != 0) {
         free(output_arr);
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_OUTPUT);
     final_output_arr = (uint32_t *)realloc(output_arr, j * sizeof(uint32_t));
+    TRACE_PHASE_END(trace, BTAS_PHASE_OUTPUT);
     if(final_output_arr == NULL) {
         free(output_arr);
         *err_flag = 3;
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
     *num_elems_out = j;
+    TRACE_END(trace, *err_flag);
     return final_output_arr;
 }
 
-uint64_t fui_htable_dyn_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag) {
+uint64_t fui_htable_dyn_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0;
@@ -869,6 +1600,7 @@ uint64_t fui_htable_dyn_count(const uint32_t *input_arr, const uint64_t num_elem
     htable_base *hash_table_base = NULL, *tmp_ht_realloc_ptr = NULL;
     uint32_t ht_base_length = HT_DYN_INI_SIZE;
     *err_flag = 0;
+    stats_reset(stats);
     if (input_arr == NULL) {
         *err_flag = -5;
         return 0;
@@ -877,6 +1609,9 @@ uint64_t fui_htable_dyn_count(const uint32_t *input_arr, const uint64_t num_elem
         *err_flag = -3;
         return 0;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small_count(input_arr, num_elems, stats);
+    }
     hash_table_base = (htable_base *)calloc(HT_DYN_INI_SIZE, sizeof(htable_base));
     if(hash_table_base == NULL) {
         *err_flag = 5;
@@ -925,71 +1660,331 @@ uint64_t fui_htable_dyn_count(const uint32_t *input_arr, const uint64_t num_elem
         (hash_table_base[h16].ptr_branch)[l16] = 1;
     }
 free_memory:
+    stats_count_htable_new(stats, hash_table_base, ht_base_length, 0);
     free_hash_table_new(hash_table_base, ht_base_length);
+    free(hash_table_base);
     if(*err_flag != 0) {
         return 0;
     }
     return j;
 }
 
-void free_dup_idx_list(dup_idx_list *dup_idx_head) {
-    dup_idx_list *ptr_current = dup_idx_head;
-    dup_idx_list *ptr_next;
-    while(ptr_current != NULL){
-        ptr_next = ptr_current->ptr_next;
-        free(ptr_current);
-        ptr_current = ptr_next;
-    }
+/**
+ * The Swiss-table set of fui_htable_swiss. A control byte per slot holds
+ * 7 bits of the hash (or HT_SWISS_EMPTY), and the slots are probed a group
+ * of HT_SWISS_GROUP control bytes at a time: one SSE2 compare finds the
+ * candidates of a group. The set never deletes, so the first group with an
+ * empty slot ends a lookup. It grows by doubling at 7/8 load.
+ */
+typedef struct {
+    uint8_t *ctrl;
+    uint32_t *slots;
+    uint64_t capacity;  /* A power of 2, at least HT_SWISS_GROUP */
+    uint64_t num_elems;
+} swiss_set;
+
+static inline uint64_t swiss_hash(uint32_t key) {
+    uint64_t hash = (uint64_t)key * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 32);
 }
 
-int insert_dup_idx_list(dup_idx_list **dup_idx_head, uint64_t idx_a, uint64_t idx_b) {
-    dup_idx_list *new_node = (dup_idx_list *)calloc(1, sizeof(dup_idx_list));
-    if(new_node == NULL) {
-        return -1;
-    }
-    new_node->index_a = idx_a;
-    new_node->index_b = idx_b;
-    if(*dup_idx_head == NULL) {
-        *dup_idx_head = new_node;
-        new_node->ptr_next = NULL;
-        return 0;
-    }
-    new_node->ptr_next = *dup_idx_head;
-    *dup_idx_head = new_node;
-    return 0;
+/* A bit per slot of the group whose control byte equals ctrl_byte. */
+static inline uint32_t swiss_match(const uint8_t *group, uint8_t ctrl_byte) {
+#if defined(__SSE2__)
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)ctrl_byte)));
+#else
+    uint32_t mask = 0;
+    for(uint32_t i = 0; i < HT_SWISS_GROUP; i++) {
+        mask |= (uint32_t)(group[i] == ctrl_byte) << i;
+    }
+    return mask;
+#endif
 }
 
-void print_dup_idx_list(dup_idx_list *dup_idx_head, uint64_t max_nodes) {
-    dup_idx_list *ptr_current = dup_idx_head;
-    printf("\n");
-    if(ptr_current == NULL) {
-        printf("NULL LIST!\n");
-        return;
-    }
-    uint64_t i = 0;
-    printf("\nIndex pairs of duplicate elements:\n");
-    while(ptr_current != NULL && i < max_nodes) {
-        printf("{%" PRIu64 "\t%" PRIu64 "}\n", ptr_current->index_a, ptr_current->index_b);
-        ptr_current = ptr_current->ptr_next;
+static inline uint32_t swiss_lowest_bit(uint32_t mask) {
+#if defined(__GNUC__) || defined(__clang__)
+    return (uint32_t)__builtin_ctz(mask);
+#else
+    uint32_t i = 0;
+    for(; (mask & 1) == 0; mask >>= 1) {
         i++;
     }
-    if(i == max_nodes) {
-        printf("... Remaining elements not printed ...\n");
-    }
-    else {
-        printf("Print done.\n");
-    }
+    return i;
+#endif
 }
 
-void print_out_idx(out_idx *output_index, uint64_t num_elems, uint64_t max_elems) {
-    if(output_index == NULL) {
-        printf("NULL OUTPUT AND INDEX!\n");
-        return;
+static int swiss_init(swiss_set *set, uint64_t capacity) {
+    set->num_elems = 0;
+    set->capacity = capacity;
+    set->ctrl = (uint8_t *)malloc(capacity * sizeof(uint8_t));
+    set->slots = (uint32_t *)malloc(capacity * sizeof(uint32_t));
+    if(set->ctrl == NULL || set->slots == NULL) {
+        free(set->ctrl);
+        free(set->slots);
+        set->ctrl = NULL;
+        set->slots = NULL;
+        return 1;
+    }
+    memset(set->ctrl, HT_SWISS_EMPTY, capacity * sizeof(uint8_t));
+    return 0;
+}
+
+static void swiss_free(swiss_set *set) {
+    free(set->ctrl);
+    free(set->slots);
+    set->ctrl = NULL;
+    set->slots = NULL;
+}
+
+/* Place a key known to be absent at the first empty slot of its probe. */
+static void swiss_place(swiss_set *set, uint32_t key, uint64_t hash) {
+    uint64_t group_mask = (set->capacity / HT_SWISS_GROUP) - 1;
+    uint64_t group = (hash >> 7) & group_mask, step = 0;
+    uint32_t empty_mask;
+    while((empty_mask = swiss_match(set->ctrl + group * HT_SWISS_GROUP, HT_SWISS_EMPTY)) == 0) {
+        group = (group + (++step)) & group_mask;
+    }
+    uint64_t slot = group * HT_SWISS_GROUP + swiss_lowest_bit(empty_mask);
+    set->ctrl[slot] = (uint8_t)(hash & 0x7F);
+    set->slots[slot] = key;
+    set->num_elems++;
+}
+
+static int swiss_grow(swiss_set *set) {
+    swiss_set new_set;
+    if(swiss_init(&new_set, set->capacity << 1) != 0) {
+        return 1;
     }
-    uint64_t i;
-    printf("\nRaw index and duplicate elements:\n");
-    for(i = 0; i < max_elems && i < num_elems; i++) {
-        printf("%" PRIu64 "\t%u\n", output_index[i].raw_index, output_index[i].out_elem);
+    for(uint64_t i = 0; i < set->capacity; i++) {
+        if(set->ctrl[i] != HT_SWISS_EMPTY) {
+            swiss_place(&new_set, set->slots[i], swiss_hash(set->slots[i]));
+        }
+    }
+    swiss_free(set);
+    *set = new_set;
+    return 0;
+}
+
+/**
+ * @returns
+ *  1 if the key is inserted
+ *  0 if the key is present already
+ *  -1 if failed to grow the set
+ */
+static int swiss_insert(swiss_set *set, uint32_t key) {
+    uint64_t hash = swiss_hash(key);
+    uint64_t group_mask = (set->capacity / HT_SWISS_GROUP) - 1;
+    uint64_t group = (hash >> 7) & group_mask, step = 0;
+    uint8_t ctrl_byte = (uint8_t)(hash & 0x7F);
+    while(1) {
+        const uint8_t *ctrl = set->ctrl + group * HT_SWISS_GROUP;
+        uint32_t match_mask = swiss_match(ctrl, ctrl_byte);
+        for(; match_mask != 0; match_mask &= match_mask - 1) {
+            if(set->slots[group * HT_SWISS_GROUP + swiss_lowest_bit(match_mask)] == key) {
+                return 0;
+            }
+        }
+        uint32_t empty_mask = swiss_match(ctrl, HT_SWISS_EMPTY);
+        if(empty_mask != 0) {
+            if(set->num_elems + 1 > (set->capacity >> 3) * 7) {
+                if(swiss_grow(set) != 0) {
+                    return -1;
+                }
+                swiss_place(set, key, hash);
+                return 1;
+            }
+            uint64_t slot = group * HT_SWISS_GROUP + swiss_lowest_bit(empty_mask);
+            set->ctrl[slot] = ctrl_byte;
+            set->slots[slot] = key;
+            set->num_elems++;
+            return 1;
+        }
+        group = (group + (++step)) & group_mask;
+    }
+}
+
+static void stats_count_swiss(btas_stats *stats, const swiss_set *set, uint64_t output_bytes) {
+    if(stats == NULL || set->ctrl == NULL) {
+        return;
+    }
+    stats->num_branches = set->capacity / HT_SWISS_GROUP;
+    stats->stem_length = set->capacity;
+    stats->stem_bytes = set->capacity * sizeof(uint8_t);
+    stats->branch_bytes = set->capacity * sizeof(uint32_t);
+    stats->output_bytes = output_bytes;
+    stats->peak_bytes = stats->stem_bytes + stats->branch_bytes + stats->output_bytes;
+}
+
+/**
+ * 
+ * @brief Filter out the unique integers from a given array with an
+ *  open-addressing Swiss-table set. Its memory scales with the number of
+ *  the unique integers, at 5 bytes per slot, rather than with their range.
+ * 
+ * @param [in]
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the integer elems in the given array
+ *  
+ * @param [out]
+ *  *num_elems_out is the number of the output unique integers
+ *  *err_flag is for debugging errors
+ * 
+ * @returns
+ *  The pointer of the allocated output array if succeeded
+ *  NULL if any error happens
+ * 
+ */
+uint32_t* fui_htable_swiss(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    uint64_t i, j = 0;
+    uint32_t *final_output_arr = NULL;
+    swiss_set set;
+    *err_flag = 0;
+    stats_reset(stats);
+    *num_elems_out = 0;
+    if (input_arr == NULL) {
+        *err_flag = -5;
+        return NULL;
+    }
+    if (num_elems < 1){
+        *err_flag = -3;
+        return NULL;
+    }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small(input_arr, num_elems, num_elems_out, err_flag, stats);
+    }
+    if(swiss_init(&set, HT_SWISS_INI_SIZE) != 0) {
+        *err_flag = 5;
+        return NULL;
+    }
+    uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
+    if (output_arr == NULL) {
+        swiss_free(&set);
+        *err_flag = -1;
+        return NULL;
+    }
+    for(i = 0; i < num_elems; i++) {
+        int insert_flag = swiss_insert(&set, input_arr[i]);
+        if(insert_flag < 0) {
+            *err_flag = 1;
+            break;
+        }
+        if(insert_flag == 0) {
+            continue;
+        }
+        output_arr[j] = input_arr[i];
+        j++;
+    }
+    stats_count_swiss(stats, &set, num_elems * sizeof(uint32_t));
+    swiss_free(&set);
+    if(*err_flag != 0) {
+        free(output_arr);
+        return NULL;
+    }
+    final_output_arr = (uint32_t *)realloc(output_arr, j * sizeof(uint32_t));
+    if(final_output_arr == NULL) {
+        free(output_arr);
+        *err_flag = 3;
+        return NULL;
+    }
+    *num_elems_out = j;
+    return final_output_arr;
+}
+
+uint64_t fui_htable_swiss_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
+    uint64_t i, j = 0;
+    swiss_set set;
+    *err_flag = 0;
+    stats_reset(stats);
+    if (input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    if (num_elems < 1){
+        *err_flag = -3;
+        return 0;
+    }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small_count(input_arr, num_elems, stats);
+    }
+    if(swiss_init(&set, HT_SWISS_INI_SIZE) != 0) {
+        *err_flag = 5;
+        return 0;
+    }
+    for(i = 0; i < num_elems; i++) {
+        int insert_flag = swiss_insert(&set, input_arr[i]);
+        if(insert_flag < 0) {
+            *err_flag = 1;
+            break;
+        }
+        j += (uint64_t)insert_flag;
+    }
+    stats_count_swiss(stats, &set, 0);
+    swiss_free(&set);
+    if(*err_flag != 0) {
+        return 0;
+    }
+    return j;
+}
+
+void free_dup_idx_list(dup_idx_list *dup_idx_head) {
+    dup_idx_list *ptr_current = dup_idx_head;
+    dup_idx_list *ptr_next;
+    while(ptr_current != NULL){
+        ptr_next = ptr_current->ptr_next;
+        free(ptr_current);
+        ptr_current = ptr_next;
+    }
+}
+
+int insert_dup_idx_list(dup_idx_list **dup_idx_head, uint64_t idx_a, uint64_t idx_b) {
+    dup_idx_list *new_node = (dup_idx_list *)calloc(1, sizeof(dup_idx_list));
+    if(new_node == NULL) {
+        return -1;
+    }
+    new_node->index_a = idx_a;
+    new_node->index_b = idx_b;
+    if(*dup_idx_head == NULL) {
+        *dup_idx_head = new_node;
+        new_node->ptr_next = NULL;
+        return 0;
+    }
+    new_node->ptr_next = *dup_idx_head;
+    *dup_idx_head = new_node;
+    return 0;
+}
+
+void print_dup_idx_list(dup_idx_list *dup_idx_head, uint64_t max_nodes) {
+    dup_idx_list *ptr_current = dup_idx_head;
+    printf("\n");
+    if(ptr_current == NULL) {
+        printf("NULL LIST!\n");
+        return;
+    }
+    uint64_t i = 0;
+    printf("\nIndex pairs of duplicate elements:\n");
+    while(ptr_current != NULL && i < max_nodes) {
+        printf("{%" PRIu64 "\t%" PRIu64 "}\n", ptr_current->index_a, ptr_current->index_b);
+        ptr_current = ptr_current->ptr_next;
+        i++;
+    }
+    if(i == max_nodes) {
+        printf("... Remaining elements not printed ...\n");
+    }
+    else {
+        printf("Print done.\n");
+    }
+}
+
+void print_out_idx(out_idx *output_index, uint64_t num_elems, uint64_t max_elems) {
+    if(output_index == NULL) {
+        printf("NULL OUTPUT AND INDEX!\n");
+        return;
+    }
+    uint64_t i;
+    printf("\nRaw index and duplicate elements:\n");
+    for(i = 0; i < max_elems && i < num_elems; i++) {
+        printf("%" PRIu64 "\t%u\n", output_index[i].raw_index, output_index[i].out_elem);
     }
     if(max_elems != num_elems && i == max_elems) {
         printf("... %" PRIu64 " remaining elements not printed ...\n", num_elems - max_elems);
@@ -1050,14 +2045,119 @@ void free_idx_ht_64(idx_ht_64 *idx_ht_head, uint32_t num_elems) {
     }
 }
 
-uint32_t* fui_bitmap_stc(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag) {
+/**
+ * Run-aware path of the dynamic BitTree inserts. Sequential inputs (IDs,
+ * timestamps) come as runs of consecutive integers, ascending or
+ * descending. Within a run, a stretch of at least BITMAP_RUN_MIN integers
+ * not recorded before is recorded by a range fill of the branch and output
+ * by a single copy, instead of a bit op per integer. The integers already
+ * recorded (e.g. the strays of a nearly-sorted input) go the usual way.
+ */
+typedef struct {
+    uint64_t end;           /* End of the run measured */
+    uint64_t retry_at;      /* Don't look for a stretch before this */
+    int is_ascending;
+} bitmap_run;
+
+/* The number of clear bits from l16 on, in the direction of the run. */
+static uint32_t branch_clear_span(const uint8_t *branch, uint32_t l16, uint32_t max_length, int is_ascending) {
+    uint32_t length = 0;
+    uint64_t word;
+    while(length < max_length) {
+        uint32_t pos = is_ascending ? (l16 + length) : (l16 - length);
+        /* 64 bits at a time once aligned to a byte. */
+        if(max_length - length >= 64 && (pos & 0x07) == (is_ascending ? 0 : 7)) {
+            memcpy(&word, branch + (is_ascending ? (pos >> 3) : ((pos >> 3) - 7)), sizeof(uint64_t));
+            if(word == 0) {
+                length += 64;
+                continue;
+            }
+        }
+        if(check_bit(branch[pos >> 3], pos & 0x07)) {
+            break;
+        }
+        length++;
+    }
+    return length;
+}
+
+static void branch_fill_range(uint8_t *branch, uint32_t lo, uint32_t hi) {
+    uint32_t head = lo >> 3, tail = hi >> 3;
+    uint8_t head_mask = (uint8_t)(0xFF >> (lo & 0x07)), tail_mask = (uint8_t)(0xFF << (7 - (hi & 0x07)));
+    if(head == tail) {
+        branch[head] |= (head_mask & tail_mask);
+        return;
+    }
+    branch[head] |= head_mask;
+    memset(branch + head + 1, 0xFF, tail - head - 1);
+    branch[tail] |= tail_mask;
+}
+
+/**
+ * @brief Fill the stretch of the run starting at input_arr[i], measuring
+ *   the run first if i is past the last one. Called once per block of
+ *   BITMAP_RUN_MIN elems, so the per-elem loop stays as tight as before.
+ *
+ * @returns
+ *  The length of the stretch filled, 0 if not filled
+ */
+static uint64_t bitmap_fill_run(const bitmap_base *bitmap_head, uint32_t bitmap_base_size, const uint32_t *input_arr, uint64_t i, uint64_t num_elems, bitmap_run *run) {
+    uint32_t first = input_arr[i], l16 = first & 0xFFFF;
+    uint8_t *branch = NULL;
+    if(num_elems - i < BITMAP_RUN_MIN || i < run->retry_at) {
+        return 0;
+    }
+    /* The branch is allocated by the per-elem loop. */
+    if((first >> 16) >= bitmap_base_size || (branch = bitmap_head[first >> 16].ptr_branch) == NULL) {
+        return 0;
+    }
+    if(i >= run->end) {
+        uint64_t k = i + 1, limit;
+        uint32_t last = input_arr[i + BITMAP_RUN_MIN - 1];
+        /* Not a run if the block doesn't span BITMAP_RUN_MIN integers. */
+        if(last - first != BITMAP_RUN_MIN - 1 && first - last != BITMAP_RUN_MIN - 1) {
+            return 0;
+        }
+        run->is_ascending = (input_arr[i + 1] == input_arr[i] + 1);
+        /* A run ends at the edge of its branch. */
+        limit = run->is_ascending ? (i + (0x10000 - l16)) : (i + l16 + 1);
+        limit = (limit > num_elems) ? num_elems : limit;
+        if(run->is_ascending) {
+            while(k < limit && input_arr[k] == input_arr[k - 1] + 1) {
+                k++;
+            }
+        }
+        else {
+            while(k < limit && input_arr[k] == input_arr[k - 1] - 1) {
+                k++;
+            }
+        }
+        run->end = k;
+        if(k - i < BITMAP_RUN_MIN) {
+            run->retry_at = k;
+            return 0;
+        }
+    }
+    uint32_t max_length = (uint32_t)(run->end - i);
+    uint32_t length = branch_clear_span(branch, l16, max_length, run->is_ascending);
+    if(length < BITMAP_RUN_MIN) {
+        /* input_arr[i + length] is recorded: retry after it. */
+        run->retry_at = i + length + 1;
+        return 0;
+    }
+    length = (length > max_length) ? max_length : length;
+    branch_fill_range(branch, run->is_ascending ? l16 : (l16 + 1 - length), run->is_ascending ? (l16 + length - 1) : l16);
+    return length;
+}
+
+uint32_t* fui_bitmap_stc(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0, *final_output_arr = NULL;
-    bitmap_base bitmap_head[BITMAP_LENGTH_MAX] = {{0, NULL},};
     uint16_t tmp_byte_index = 0;
     uint8_t tmp_bit_position = 0;
     *err_flag = 0;
+    stats_reset(stats);
     *num_elems_out = 0;
     if (input_arr == NULL) {
         *err_flag = -5;
@@ -1067,6 +2167,10 @@ uint32_t* fui_bitmap_stc(const uint32_t *input_arr, const uint64_t num_elems, ui
         *err_flag = -3;
         return NULL;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small(input_arr, num_elems, num_elems_out, err_flag, stats);
+    }
+    bitmap_base bitmap_head[BITMAP_LENGTH_MAX] = {{0, NULL},};
     uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
     if (output_arr == NULL) {
         *err_flag = -1;
@@ -1092,6 +2196,7 @@ uint32_t* fui_bitmap_stc(const uint32_t *input_arr, const uint64_t num_elems, ui
         flip_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position);
     }
 free_memory:
+    stats_count_bitmap(stats, bitmap_head, BITMAP_LENGTH_MAX, num_elems * sizeof(uint32_t));
     free_bitmap(bitmap_head, BITMAP_LENGTH_MAX);
     if(*err_flag != 0) {
         free(output_arr);
@@ -1107,14 +2212,14 @@ free_memory:
     return final_output_arr;
 }
 
-uint64_t fui_bitmap_stc_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag) {
+uint64_t fui_bitmap_stc_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0;
-    bitmap_base bitmap_head[BITMAP_LENGTH_MAX] = {{0, NULL},};
     uint16_t tmp_byte_index = 0;
     uint8_t tmp_bit_position = 0;
     *err_flag = 0;
+    stats_reset(stats);
     if (input_arr == NULL) {
         *err_flag = -5;
         return 0;
@@ -1123,6 +2228,10 @@ uint64_t fui_bitmap_stc_count(const uint32_t *input_arr, const uint64_t num_elem
         *err_flag = -3;
         return 0;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small_count(input_arr, num_elems, stats);
+    }
+    bitmap_base bitmap_head[BITMAP_LENGTH_MAX] = {{0, NULL},};
     for(i = 0; i < num_elems; i++) {
         tmp = input_arr[i];
         h16 = (uint16_t)(tmp >> 16);
@@ -1142,6 +2251,7 @@ uint64_t fui_bitmap_stc_count(const uint32_t *input_arr, const uint64_t num_elem
         flip_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position);
     }
 free_memory:
+    stats_count_bitmap(stats, bitmap_head, BITMAP_LENGTH_MAX, 0);
     free_bitmap(bitmap_head, BITMAP_LENGTH_MAX);
     if(*err_flag != 0) {
         return 0;
@@ -1149,15 +2259,19 @@ free_memory:
     return j;
 }
 
-uint32_t* fui_bitmap_dyn(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag) {
+uint32_t* fui_bitmap_dyn(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
+    uint64_t run_length = 0, block_end = 0;
+    bitmap_run run = {0, 0, 0};
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0, *final_output_arr = NULL;
     bitmap_base *bitmap_head = NULL, *tmp_bitmap_realloc = NULL;
     uint32_t bitmap_base_size = BITMAP_INIT_LENGTH, bitmap_base_size_target = 0;
     uint16_t tmp_byte_index = 0;
     uint8_t tmp_bit_position = 0;
+    TRACE_DECL(trace);
     *err_flag = 0;
+    stats_reset(stats);
     *num_elems_out = 0;
     if (input_arr == NULL) {
         *err_flag = -5;
@@ -1167,66 +2281,100 @@ uint32_t* fui_bitmap_dyn(const uint32_t *input_arr, const uint64_t num_elems, ui
         *err_flag = -3;
         return NULL;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small(input_arr, num_elems, num_elems_out, err_flag, stats);
+    }
+    TRACE_BEGIN(trace, "fui_bitmap_dyn", num_elems);
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_SETUP);
     bitmap_head = (bitmap_base *)calloc(BITMAP_INIT_LENGTH, sizeof(bitmap_base));
     if(bitmap_head == NULL) {
         *err_flag = 5;
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
     uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
     if (output_arr == NULL) {
         free(bitmap_head);
         *err_flag = -1;
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
-    for(i = 0; i < num_elems; i++) {
-        tmp = input_arr[i];
-        h16 = (uint16_t)(tmp >> 16);
-        l16 = (uint16_t)(tmp & 0xFFFF);
-        tmp_byte_index = l16 >> 3;
-        tmp_bit_position = l16 & 0x07;
-        /* Grow the tree if needed. */
-        if((h16 + 1) > bitmap_base_size) {
-            bitmap_base_size_target = (((h16 + 1) << 1) > BITMAP_LENGTH_MAX) ? BITMAP_LENGTH_MAX : ((h16 + 1) << 1);
-            if((tmp_bitmap_realloc = (bitmap_base *)realloc(bitmap_head, bitmap_base_size_target * sizeof(bitmap_base))) == NULL) {
-                *err_flag = 7;
-                goto free_memory;
-            }
-            memset(tmp_bitmap_realloc + bitmap_base_size, 0, (bitmap_base_size_target - bitmap_base_size) * sizeof(bitmap_base));
-            bitmap_head = tmp_bitmap_realloc;
-            bitmap_base_size = bitmap_base_size_target;
+    TRACE_PHASE_END(trace, BTAS_PHASE_SETUP);
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_INSERT);
+    for(i = 0; i < num_elems; ) {
+        run_length = bitmap_fill_run(bitmap_head, bitmap_base_size, input_arr, i, num_elems, &run);
+        if(run_length > 0) {
+            memmove(output_arr + j, input_arr + i, run_length * sizeof(uint32_t));
+            j += run_length;
+            i += run_length;
+            continue;
         }
-        if(bitmap_head[h16].ptr_branch == NULL) {
-            if((bitmap_head[h16].ptr_branch = (uint8_t *)calloc(BITMAP_BRANCH_SIZE, sizeof(uint8_t))) == NULL) {
-                *err_flag = 1;
-                goto free_memory;
+        block_end = (num_elems - i > BITMAP_RUN_MIN) ? (i + BITMAP_RUN_MIN) : num_elems;
+        for(; i < block_end; i++) {
+            tmp = input_arr[i];
+            h16 = (uint16_t)(tmp >> 16);
+            l16 = (uint16_t)(tmp & 0xFFFF);
+            tmp_byte_index = l16 >> 3;
+            tmp_bit_position = l16 & 0x07;
+            /* Grow the tree if needed. */
+            if((h16 + 1) > bitmap_base_size) {
+                bitmap_base_size_target = (((h16 + 1) << 1) > BITMAP_LENGTH_MAX) ? BITMAP_LENGTH_MAX : ((h16 + 1) << 1);
+                TRACE_PHASE_BEGIN(trace, BTAS_PHASE_STEM_GROW);
+                if((tmp_bitmap_realloc = (bitmap_base *)realloc(bitmap_head, bitmap_base_size_target * sizeof(bitmap_base))) == NULL) {
+                    *err_flag = 7;
+                    goto free_memory;
+                }
+                memset(tmp_bitmap_realloc + bitmap_base_size, 0, (bitmap_base_size_target - bitmap_base_size) * sizeof(bitmap_base));
+                bitmap_head = tmp_bitmap_realloc;
+                bitmap_base_size = bitmap_base_size_target;
+                TRACE_PHASE_END(trace, BTAS_PHASE_STEM_GROW);
             }
+            if(bitmap_head[h16].ptr_branch == NULL) {
+                TRACE_PHASE_BEGIN(trace, BTAS_PHASE_BRANCH_ALLOC);
+                if((bitmap_head[h16].ptr_branch = (uint8_t *)calloc(BITMAP_BRANCH_SIZE, sizeof(uint8_t))) == NULL) {
+                    *err_flag = 1;
+                    goto free_memory;
+                }
+                TRACE_PHASE_END(trace, BTAS_PHASE_BRANCH_ALLOC);
+            }
+            if(bitmap_head[h16].ptr_branch != NULL && check_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position)) {
+                continue;
+            }
+            output_arr[j] = tmp;
+            j++;
+            flip_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position);
         }
-        if(bitmap_head[h16].ptr_branch != NULL && check_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position)) {
-            continue;
-        }
-        output_arr[j] = tmp;
-        j++;
-        flip_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position);
     }
 free_memory:
+    TRACE_PHASE_END(trace, BTAS_PHASE_INSERT);
+    stats_count_bitmap(stats, bitmap_head, bitmap_base_size, num_elems * sizeof(uint32_t));
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_TEARDOWN);
     free_bitmap(bitmap_head, bitmap_base_size);
     free(bitmap_head);
+    TRACE_PHASE_END(trace, BTAS_PHASE_TEARDOWN);
     if(*err_flag != 0) {
         free(output_arr);
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_OUTPUT);
     final_output_arr = (uint32_t *)realloc(output_arr, j * sizeof(uint32_t));
+    TRACE_PHASE_END(trace, BTAS_PHASE_OUTPUT);
     if(final_output_arr == NULL) {
         free(output_arr);
         *err_flag = 3;
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
     *num_elems_out = j;
+    TRACE_END(trace, *err_flag);
     return final_output_arr;
 }
 
-uint64_t fui_bitmap_dyn_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag) {
+uint64_t fui_bitmap_dyn_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
     uint64_t i, j = 0;
+    uint64_t run_length = 0, block_end = 0;
+    bitmap_run run = {0, 0, 0};
     uint16_t h16 = 0, l16 = 0;
     uint32_t tmp = 0;
     bitmap_base *bitmap_head = NULL, *tmp_bitmap_realloc = NULL;
@@ -1234,6 +2382,7 @@ uint64_t fui_bitmap_dyn_count(const uint32_t *input_arr, const uint64_t num_elem
     uint16_t tmp_byte_index = 0;
     uint8_t tmp_bit_position = 0;
     *err_flag = 0;
+    stats_reset(stats);
     if (input_arr == NULL) {
         *err_flag = -5;
         return 0;
@@ -1242,41 +2391,54 @@ uint64_t fui_bitmap_dyn_count(const uint32_t *input_arr, const uint64_t num_elem
         *err_flag = -3;
         return 0;
     }
+    if(num_elems <= SMALL_INPUT_MAX) {
+        return fui_small_count(input_arr, num_elems, stats);
+    }
     bitmap_head = (bitmap_base *)calloc(BITMAP_INIT_LENGTH, sizeof(bitmap_base));
     if(bitmap_head == NULL) {
         *err_flag = 5;
         return 0;
     }
-    for(i = 0; i < num_elems; i++) {
-        tmp = input_arr[i];
-        h16 = (uint16_t)(tmp >> 16);
-        l16 = (uint16_t)(tmp & 0xFFFF);
-        tmp_byte_index = l16 >> 3;
-        tmp_bit_position = l16 & 0x07;
-        /* Grow the tree if needed. */
-        if((h16 + 1) > bitmap_base_size) {
-            bitmap_base_size_target = (((h16 + 1) << 1) > BITMAP_LENGTH_MAX) ? BITMAP_LENGTH_MAX : ((h16 + 1) << 1);
-            if((tmp_bitmap_realloc = (bitmap_base *)realloc(bitmap_head, bitmap_base_size_target * sizeof(bitmap_base))) == NULL) {
-                *err_flag = 7;
-                goto free_memory;
-            }
-            memset(tmp_bitmap_realloc + bitmap_base_size, 0, (bitmap_base_size_target - bitmap_base_size) * sizeof(bitmap_base));
-            bitmap_head = tmp_bitmap_realloc;
-            bitmap_base_size = bitmap_base_size_target;
-        }
-        if(bitmap_head[h16].ptr_branch == NULL) {
-            if((bitmap_head[h16].ptr_branch = (uint8_t *)calloc(BITMAP_BRANCH_SIZE, sizeof(uint8_t))) == NULL) {
-                *err_flag = 1;
-                goto free_memory;
-            }
-        }
-        if(bitmap_head[h16].ptr_branch != NULL && check_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position)) {
+    for(i = 0; i < num_elems; ) {
+        run_length = bitmap_fill_run(bitmap_head, bitmap_base_size, input_arr, i, num_elems, &run);
+        if(run_length > 0) {
+            j += run_length;
+            i += run_length;
             continue;
         }
-        j++;
-        flip_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position);
+        block_end = (num_elems - i > BITMAP_RUN_MIN) ? (i + BITMAP_RUN_MIN) : num_elems;
+        for(; i < block_end; i++) {
+            tmp = input_arr[i];
+            h16 = (uint16_t)(tmp >> 16);
+            l16 = (uint16_t)(tmp & 0xFFFF);
+            tmp_byte_index = l16 >> 3;
+            tmp_bit_position = l16 & 0x07;
+            /* Grow the tree if needed. */
+            if((h16 + 1) > bitmap_base_size) {
+                bitmap_base_size_target = (((h16 + 1) << 1) > BITMAP_LENGTH_MAX) ? BITMAP_LENGTH_MAX : ((h16 + 1) << 1);
+                if((tmp_bitmap_realloc = (bitmap_base *)realloc(bitmap_head, bitmap_base_size_target * sizeof(bitmap_base))) == NULL) {
+                    *err_flag = 7;
+                    goto free_memory;
+                }
+                memset(tmp_bitmap_realloc + bitmap_base_size, 0, (bitmap_base_size_target - bitmap_base_size) * sizeof(bitmap_base));
+                bitmap_head = tmp_bitmap_realloc;
+                bitmap_base_size = bitmap_base_size_target;
+            }
+            if(bitmap_head[h16].ptr_branch == NULL) {
+                if((bitmap_head[h16].ptr_branch = (uint8_t *)calloc(BITMAP_BRANCH_SIZE, sizeof(uint8_t))) == NULL) {
+                    *err_flag = 1;
+                    goto free_memory;
+                }
+            }
+            if(bitmap_head[h16].ptr_branch != NULL && check_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position)) {
+                continue;
+            }
+            j++;
+            flip_bit((bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position);
+        }
     }
 free_memory:
+    stats_count_bitmap(stats, bitmap_head, bitmap_base_size, 0);
     free_bitmap(bitmap_head, bitmap_base_size);
     free(bitmap_head);
     if(*err_flag != 0) {
@@ -1285,7 +2447,7 @@ free_memory:
     return j;
 }
 
-out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, dup_idx_list **dup_idx_head) {
+out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, dup_idx_list **dup_idx_head, btas_stats *stats) {
     uint64_t i, j = 0;
     uint64_t tmp_dup_raw_index;
     uint16_t h16 = 0, l16 = 0;
@@ -1298,7 +2460,9 @@ out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uin
     uint16_t tmp_byte = 0;
     uint8_t tmp_bit_position = 0;
     uint8_t raw_index_range = 0;
+    TRACE_DECL(trace);
     *err_flag = 0;
+    stats_reset(stats);
     *num_elems_out = 0;
     if(*dup_idx_head != NULL) {
         *err_flag = -9;
@@ -1308,15 +2472,19 @@ out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uin
         *err_flag = -7;
         return NULL;
     }
+    TRACE_BEGIN(trace, "fui_bitmap_idx", num_elems);
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_SETUP);
     bitmap_head = (bitmap_base *)calloc(BITMAP_INIT_LENGTH, sizeof(bitmap_base));
     if(bitmap_head == NULL) {
         *err_flag = 5;
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
     out_idx *output_arr = (out_idx *)calloc(num_elems, sizeof(out_idx));
     if (output_arr == NULL) {
         free(bitmap_head);
         *err_flag = -1;
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
     if (num_elems < 1){
@@ -1357,8 +2525,11 @@ out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uin
     if(*err_flag != 0) {
         free(bitmap_head);
         free(output_arr);
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
+    TRACE_PHASE_END(trace, BTAS_PHASE_SETUP);
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_INSERT);
     for(i = 0; i < num_elems; i++) {
         tmp = input_arr[i];
         h16 = (uint16_t)(tmp >> 16);
@@ -1369,6 +2540,7 @@ out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uin
         /* Grow the tree if needed. */
         if((h16 + 1) > bitmap_base_size) {
             bitmap_base_size_target = (((h16 + 1) << 1) > BITMAP_LENGTH_MAX) ? BITMAP_LENGTH_MAX : ((h16 + 1) << 1);
+            TRACE_PHASE_BEGIN(trace, BTAS_PHASE_STEM_GROW);
             if((tmp_bitmap_head = (bitmap_base *)realloc(bitmap_head, bitmap_base_size_target * sizeof(bitmap_base))) == NULL) {
                 *err_flag = 7;
                 goto free_memory;
@@ -1408,12 +2580,15 @@ out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uin
                 idx_adj_head = (idx_ht_8 *)tmp_idx_adj;
             }
             bitmap_base_size = bitmap_base_size_target;
+            TRACE_PHASE_END(trace, BTAS_PHASE_STEM_GROW);
         }
         if(bitmap_head[h16].ptr_branch == NULL) {
+            TRACE_PHASE_BEGIN(trace, BTAS_PHASE_BRANCH_ALLOC);
             if(((bitmap_head[h16].ptr_branch) = (uint8_t *)calloc(BITMAP_BRANCH_SIZE, sizeof(uint8_t))) == NULL) {
                 *err_flag = 1;
                 goto free_memory;
             }
+            TRACE_PHASE_END(trace, BTAS_PHASE_BRANCH_ALLOC);
         }
         if(raw_index_range == 64) {
             if(((idx_ht_64 *)idx_adj_head)[h16].ptr_branch == NULL) {
@@ -1481,6 +2656,17 @@ out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uin
         }
     }
 free_memory:
+    TRACE_PHASE_END(trace, BTAS_PHASE_INSERT);
+    if(stats != NULL) {
+        stats_count_bitmap(stats, bitmap_head, bitmap_base_size, num_elems * sizeof(out_idx));
+        /* The index branches are allocated along with the bitmap branches. */
+        stats->index_bytes = (uint64_t)bitmap_base_size * sizeof(idx_ht_64) + stats->num_branches * IDX_ADJ_BRCH_SIZE * (raw_index_range >> 3);
+        for(dup_idx_list *node = dup_idx_head_tmp; node != NULL; node = node->ptr_next) {
+            stats->index_bytes += sizeof(dup_idx_list);
+        }
+        stats->peak_bytes += stats->index_bytes;
+    }
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_TEARDOWN);
     free_bitmap(bitmap_head, bitmap_base_size);
     free(bitmap_head);
     if(raw_index_range == 64 ) {
@@ -1495,23 +2681,714 @@ free_memory:
     else{
         free_idx_ht_8((idx_ht_8 *)idx_adj_head, bitmap_base_size);    
     }
+    free(idx_adj_head);
+    TRACE_PHASE_END(trace, BTAS_PHASE_TEARDOWN);
     if(*err_flag != 0) {
         free(output_arr);
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
+    TRACE_PHASE_BEGIN(trace, BTAS_PHASE_OUTPUT);
     final_output_arr = (out_idx *)realloc(output_arr, j * sizeof(out_idx));
+    TRACE_PHASE_END(trace, BTAS_PHASE_OUTPUT);
     if(final_output_arr == NULL) {
         free(output_arr);
         *err_flag = 3;
+        TRACE_END(trace, *err_flag);
         return NULL;
     }
     *num_elems_out = j;
     *dup_idx_head = dup_idx_head_tmp;
+    TRACE_END(trace, *err_flag);
+    return final_output_arr;
+}
+
+/**
+ * @brief Initialize an empty streaming BitTree
+ * 
+ * @returns
+ *  -5 if the tree pointer is null
+ *   5 if failed to allocate the stem
+ *   0 if succeeded
+ */
+int bitmap_tree_init(bitmap_tree *tree) {
+    if(tree == NULL) {
+        return -5;
+    }
+    tree->bitmap_base_size = BITMAP_INIT_LENGTH;
+    tree->num_branches = 0;
+    tree->num_elems = 0;
+    tree->bitmap_head = (bitmap_base *)calloc(BITMAP_INIT_LENGTH, sizeof(bitmap_base));
+    if(tree->bitmap_head == NULL) {
+        tree->bitmap_base_size = 0;
+        return 5;
+    }
+    return 0;
+}
+
+void bitmap_tree_free(bitmap_tree *tree) {
+    if(tree == NULL || tree->bitmap_head == NULL) {
+        return;
+    }
+    free_bitmap(tree->bitmap_head, tree->bitmap_base_size);
+    free(tree->bitmap_head);
+    tree->bitmap_head = NULL;
+    tree->bitmap_base_size = 0;
+    tree->num_branches = 0;
+    tree->num_elems = 0;
+}
+
+int bitmap_tree_contains(const bitmap_tree *tree, uint32_t elem) {
+    uint16_t h16 = (uint16_t)(elem >> 16), l16 = (uint16_t)(elem & 0xFFFF);
+    if(tree == NULL || h16 >= tree->bitmap_base_size || tree->bitmap_head[h16].ptr_branch == NULL) {
+        return 0;
+    }
+    return check_bit((tree->bitmap_head[h16].ptr_branch)[l16 >> 3], l16 & 0x07) ? 1 : 0;
+}
+
+/**
+ * 
+ * @brief Insert a block of integers to a streaming BitTree
+ * 
+ * @param [in]
+ *  *tree is an initialized streaming BitTree
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the integer elems in the given array
+ *  
+ * @param [out]
+ *  *output_arr receives the integers not recorded before, in the order of
+ *   the input. It must be able to hold num_elems integers. NULL to skip.
+ *  *err_flag is for debugging errors
+ * 
+ * @returns
+ *  The number of integers not recorded before. If an error occurred, the
+ *  integers inserted before the error are kept in the tree.
+ * 
+ */
+uint64_t bitmap_tree_insert_arr(bitmap_tree *tree, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag) {
+    uint64_t i, j = 0;
+    uint64_t run_length = 0, block_end = 0;
+    bitmap_run run = {0, 0, 0};
+    uint16_t h16 = 0, l16 = 0;
+    uint32_t tmp = 0;
+    bitmap_base *tmp_bitmap_realloc = NULL;
+    uint32_t bitmap_base_size_target = 0;
+    uint16_t tmp_byte_index = 0;
+    uint8_t tmp_bit_position = 0;
+    *err_flag = 0;
+    if(tree == NULL || tree->bitmap_head == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    for(i = 0; i < num_elems; ) {
+        run_length = bitmap_fill_run(tree->bitmap_head, tree->bitmap_base_size, input_arr, i, num_elems, &run);
+        if(run_length > 0) {
+            /* A move: the output may be the input, j <= i. */
+            if(output_arr != NULL) {
+                memmove(output_arr + j, input_arr + i, run_length * sizeof(uint32_t));
+            }
+            j += run_length;
+            i += run_length;
+            continue;
+        }
+        block_end = (num_elems - i > BITMAP_RUN_MIN) ? (i + BITMAP_RUN_MIN) : num_elems;
+        for(; i < block_end; i++) {
+            tmp = input_arr[i];
+            h16 = (uint16_t)(tmp >> 16);
+            l16 = (uint16_t)(tmp & 0xFFFF);
+            tmp_byte_index = l16 >> 3;
+            tmp_bit_position = l16 & 0x07;
+            /* Grow the tree if needed. */
+            if((uint32_t)(h16 + 1) > tree->bitmap_base_size) {
+                bitmap_base_size_target = (((h16 + 1) << 1) > BITMAP_LENGTH_MAX) ? BITMAP_LENGTH_MAX : ((h16 + 1) << 1);
+                if((tmp_bitmap_realloc = (bitmap_base *)realloc(tree->bitmap_head, bitmap_base_size_target * sizeof(bitmap_base))) == NULL) {
+                    *err_flag = 7;
+                    break;
+                }
+                memset(tmp_bitmap_realloc + tree->bitmap_base_size, 0, (bitmap_base_size_target - tree->bitmap_base_size) * sizeof(bitmap_base));
+                tree->bitmap_head = tmp_bitmap_realloc;
+                tree->bitmap_base_size = bitmap_base_size_target;
+            }
+            if(tree->bitmap_head[h16].ptr_branch == NULL) {
+                if((tree->bitmap_head[h16].ptr_branch = (uint8_t *)calloc(BITMAP_BRANCH_SIZE, sizeof(uint8_t))) == NULL) {
+                    *err_flag = 1;
+                    break;
+                }
+                tree->num_branches++;
+            }
+            if(check_bit((tree->bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position)) {
+                continue;
+            }
+            if(output_arr != NULL) {
+                output_arr[j] = tmp;
+            }
+            j++;
+            flip_bit((tree->bitmap_head[h16].ptr_branch)[tmp_byte_index], tmp_bit_position);
+        }
+        if(*err_flag != 0) {
+            break;
+        }
+    }
+    tree->num_elems += j;
+    return j;
+}
+
+/**
+ * @brief Initialize an empty reusable context
+ * 
+ * @returns
+ *  -5 if the context pointer is null
+ *   5 if failed to allocate memory
+ *   0 if succeeded
+ */
+int bitmap_ctx_init(bitmap_ctx *ctx) {
+    if(ctx == NULL) {
+        return -5;
+    }
+    memset(ctx, 0, sizeof(bitmap_ctx));
+    if(bitmap_tree_init(&ctx->tree) != 0) {
+        return 5;
+    }
+    ctx->used_list = (uint16_t *)malloc(BITMAP_LENGTH_MAX * sizeof(uint16_t));
+    ctx->spare_branches = (uint8_t **)malloc(BITMAP_LENGTH_MAX * sizeof(uint8_t *));
+    if(ctx->used_list == NULL || ctx->spare_branches == NULL) {
+        bitmap_ctx_free(ctx);
+        return 5;
+    }
+    return 0;
+}
+
+void bitmap_ctx_free(bitmap_ctx *ctx) {
+    if(ctx == NULL) {
+        return;
+    }
+    /* The branches in use are on the used list: free them without a stem walk. */
+    for(uint32_t i = 0; ctx->tree.bitmap_head != NULL && i < ctx->tree.num_branches; i++) {
+        free(ctx->tree.bitmap_head[ctx->used_list[i]].ptr_branch);
+    }
+    for(uint32_t i = 0; i < ctx->num_spare; i++) {
+        free(ctx->spare_branches[i]);
+    }
+    free(ctx->tree.bitmap_head);
+    free(ctx->used_list);
+    free(ctx->spare_branches);
+    memset(ctx, 0, sizeof(bitmap_ctx));
+}
+
+/**
+ * @brief Empty the context. Only the branches in use are zeroed, and they
+ *   become spares. The stem stays allocated.
+ */
+void bitmap_ctx_reset(bitmap_ctx *ctx) {
+    if(ctx == NULL || ctx->tree.bitmap_head == NULL) {
+        return;
+    }
+    for(uint32_t i = 0; i < ctx->tree.num_branches; i++) {
+        bitmap_base *base = ctx->tree.bitmap_head + ctx->used_list[i];
+        memset(base->ptr_branch, 0, BITMAP_BRANCH_SIZE);
+        ctx->spare_branches[ctx->num_spare++] = base->ptr_branch;
+        base->ptr_branch = NULL;
+    }
+    ctx->tree.num_branches = 0;
+    ctx->tree.num_elems = 0;
+}
+
+/**
+ * 
+ * @brief Insert a block of integers to a reusable context. The same as
+ *   bitmap_tree_insert_arr(), but a new branch is a spare if any.
+ * 
+ */
+uint64_t bitmap_ctx_insert_arr(bitmap_ctx *ctx, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag) {
+    uint64_t i, j = 0;
+    uint64_t run_length = 0, block_end = 0;
+    bitmap_run run = {0, 0, 0};
+    uint16_t h16 = 0, l16 = 0;
+    uint32_t tmp = 0;
+    bitmap_base *tmp_bitmap_realloc = NULL;
+    uint32_t bitmap_base_size_target = 0;
+    uint16_t tmp_byte_index = 0;
+    uint8_t tmp_bit_position = 0;
+    *err_flag = 0;
+    if(ctx == NULL || ctx->tree.bitmap_head == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    /* Keep the hot fields in locals: the byte stores to the branches may
+     * alias the context, so the compiler would reload them every time. */
+    bitmap_base *bitmap_head = ctx->tree.bitmap_head;
+    uint32_t bitmap_base_size = ctx->tree.bitmap_base_size;
+    for(i = 0; i < num_elems; ) {
+        run_length = bitmap_fill_run(bitmap_head, bitmap_base_size, input_arr, i, num_elems, &run);
+        if(run_length > 0) {
+            if(output_arr != NULL) {
+                memmove(output_arr + j, input_arr + i, run_length * sizeof(uint32_t));
+            }
+            j += run_length;
+            i += run_length;
+            continue;
+        }
+        block_end = (num_elems - i > BITMAP_RUN_MIN) ? (i + BITMAP_RUN_MIN) : num_elems;
+        for(; i < block_end; i++) {
+            tmp = input_arr[i];
+            h16 = (uint16_t)(tmp >> 16);
+            l16 = (uint16_t)(tmp & 0xFFFF);
+            tmp_byte_index = l16 >> 3;
+            tmp_bit_position = l16 & 0x07;
+            /* Grow the tree if needed. */
+            if((uint32_t)(h16 + 1) > bitmap_base_size) {
+                bitmap_base_size_target = (((h16 + 1) << 1) > BITMAP_LENGTH_MAX) ? BITMAP_LENGTH_MAX : ((h16 + 1) << 1);
+                if((tmp_bitmap_realloc = (bitmap_base *)realloc(bitmap_head, bitmap_base_size_target * sizeof(bitmap_base))) == NULL) {
+                    *err_flag = 7;
+                    break;
+                }
+                memset(tmp_bitmap_realloc + bitmap_base_size, 0, (bitmap_base_size_target - bitmap_base_size) * sizeof(bitmap_base));
+                bitmap_head = tmp_bitmap_realloc;
+                bitmap_base_size = bitmap_base_size_target;
+            }
+            uint8_t *branch = bitmap_head[h16].ptr_branch;
+            if(branch == NULL) {
+                if(ctx->num_spare > 0) {
+                    branch = ctx->spare_branches[--ctx->num_spare];
+                }
+                else if((branch = (uint8_t *)calloc(BITMAP_BRANCH_SIZE, sizeof(uint8_t))) == NULL) {
+                    *err_flag = 1;
+                    break;
+                }
+                bitmap_head[h16].ptr_branch = branch;
+                ctx->used_list[ctx->tree.num_branches++] = h16;
+            }
+            if(check_bit(branch[tmp_byte_index], tmp_bit_position)) {
+                continue;
+            }
+            if(output_arr != NULL) {
+                output_arr[j] = tmp;
+            }
+            j++;
+            flip_bit(branch[tmp_byte_index], tmp_bit_position);
+        }
+        if(*err_flag != 0) {
+            break;
+        }
+    }
+    ctx->tree.bitmap_head = bitmap_head;
+    ctx->tree.bitmap_base_size = bitmap_base_size;
+    ctx->tree.num_elems += j;
+    return j;
+}
+
+/**
+ * 
+ * @brief The same as fui_bitmap_dyn(), but reusing the stem and branches
+ *   of a context. The context is reset at the start of the call, so the
+ *   unique integers of the call stay queryable in ctx->tree until the next
+ *   call. The context must not be shared by concurrent calls.
+ * 
+ */
+uint32_t* fui_bitmap_ctx(bitmap_ctx *ctx, const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    uint64_t j = 0;
+    uint32_t *final_output_arr = NULL;
+    *err_flag = 0;
+    stats_reset(stats);
+    *num_elems_out = 0;
+    if(ctx == NULL || ctx->tree.bitmap_head == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return NULL;
+    }
+    if(num_elems < 1) {
+        *err_flag = -3;
+        return NULL;
+    }
+    bitmap_ctx_reset(ctx);
+    uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
+    if(output_arr == NULL) {
+        *err_flag = -1;
+        return NULL;
+    }
+    j = bitmap_ctx_insert_arr(ctx, input_arr, num_elems, output_arr, err_flag);
+    stats_count_ctx(stats, ctx, num_elems * sizeof(uint32_t));
+    if(*err_flag != 0) {
+        free(output_arr);
+        return NULL;
+    }
+    final_output_arr = (uint32_t *)realloc(output_arr, j * sizeof(uint32_t));
+    if(final_output_arr == NULL) {
+        free(output_arr);
+        *err_flag = 3;
+        return NULL;
+    }
+    *num_elems_out = j;
     return final_output_arr;
 }
 
-uint64_t* fui_bitmap_dyn64(const uint64_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag) {
-    
+uint64_t fui_bitmap_ctx_count(bitmap_ctx *ctx, const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
+    uint64_t j = 0;
+    *err_flag = 0;
+    stats_reset(stats);
+    if(ctx == NULL || ctx->tree.bitmap_head == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    if(num_elems < 1) {
+        *err_flag = -3;
+        return 0;
+    }
+    bitmap_ctx_reset(ctx);
+    j = bitmap_ctx_insert_arr(ctx, input_arr, num_elems, NULL, err_flag);
+    stats_count_ctx(stats, ctx, 0);
+    if(*err_flag != 0) {
+        return 0;
+    }
+    return j;
+}
+
+/**
+ * A chunk of the radix sort. Every pass, each chunk scatters its elements
+ * to the offsets its digit counts got, so the chunks run in parallel and
+ * the sort stays stable. With a single chunk, the counts of all the passes
+ * come from one read of the input.
+ */
+typedef struct {
+    const void *src;
+    void *dst;
+    uint64_t begin;
+    uint64_t end;
+    uint32_t key_bytes;         /* 4 or 8 */
+    uint32_t shift;             /* Of the digit of the current pass */
+    uint64_t *hist;             /* key_bytes passes x RADIX_BUCKETS counts */
+    uint64_t offsets[RADIX_BUCKETS];
+    uint64_t num_uniq;
+    uint64_t out_begin;
+} radix_task;
+
+static void *radix_hist_task(void *arg) {
+    radix_task *task = (radix_task *)arg;
+    uint64_t *hist = task->hist;
+    if(task->key_bytes == 4) {
+        const uint32_t *src = (const uint32_t *)task->src;
+        for(uint64_t i = task->begin; i < task->end; i++) {
+            uint32_t key = src[i];
+            hist[key & 0xFF]++;
+            hist[RADIX_BUCKETS + ((key >> 8) & 0xFF)]++;
+            hist[2 * RADIX_BUCKETS + ((key >> 16) & 0xFF)]++;
+            hist[3 * RADIX_BUCKETS + (key >> 24)]++;
+        }
+    }
+    else {
+        const uint64_t *src = (const uint64_t *)task->src;
+        for(uint64_t i = task->begin; i < task->end; i++) {
+            uint64_t key = src[i];
+            for(uint32_t pass = 0; pass < 8; pass++) {
+                hist[pass * RADIX_BUCKETS + ((key >> (pass * RADIX_BITS)) & 0xFF)]++;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Count the digit of the current pass in the chunk, to task->offsets. */
+static void *radix_digit_task(void *arg) {
+    radix_task *task = (radix_task *)arg;
+    uint64_t *counts = task->offsets;
+    uint32_t shift = task->shift;
+    memset(counts, 0, RADIX_BUCKETS * sizeof(uint64_t));
+    if(task->key_bytes == 4) {
+        const uint32_t *src = (const uint32_t *)task->src;
+        for(uint64_t i = task->begin; i < task->end; i++) {
+            counts[(src[i] >> shift) & 0xFF]++;
+        }
+    }
+    else {
+        const uint64_t *src = (const uint64_t *)task->src;
+        for(uint64_t i = task->begin; i < task->end; i++) {
+            counts[(src[i] >> shift) & 0xFF]++;
+        }
+    }
+    return NULL;
+}
+
+static void *radix_scatter_task(void *arg) {
+    radix_task *task = (radix_task *)arg;
+    uint64_t *offsets = task->offsets;
+    uint32_t shift = task->shift;
+    if(task->key_bytes == 4) {
+        const uint32_t *src = (const uint32_t *)task->src;
+        uint32_t *dst = (uint32_t *)task->dst;
+        for(uint64_t i = task->begin; i < task->end; i++) {
+            dst[offsets[(src[i] >> shift) & 0xFF]++] = src[i];
+        }
+    }
+    else {
+        const uint64_t *src = (const uint64_t *)task->src;
+        uint64_t *dst = (uint64_t *)task->dst;
+        for(uint64_t i = task->begin; i < task->end; i++) {
+            dst[offsets[(src[i] >> shift) & 0xFF]++] = src[i];
+        }
+    }
+    return NULL;
+}
+
+/* Count the uniques of a chunk of the sorted array, or write them if dst. */
+static void *radix_unique_task(void *arg) {
+    radix_task *task = (radix_task *)arg;
+    uint64_t j = task->out_begin;
+    if(task->key_bytes == 4) {
+        const uint32_t *src = (const uint32_t *)task->src;
+        uint32_t *dst = (uint32_t *)task->dst;
+        for(uint64_t i = task->begin; i < task->end; i++) {
+            if(i == 0 || src[i] != src[i - 1]) {
+                if(dst != NULL) {
+                    dst[j] = src[i];
+                }
+                j++;
+            }
+        }
+    }
+    else {
+        const uint64_t *src = (const uint64_t *)task->src;
+        uint64_t *dst = (uint64_t *)task->dst;
+        for(uint64_t i = task->begin; i < task->end; i++) {
+            if(i == 0 || src[i] != src[i - 1]) {
+                if(dst != NULL) {
+                    dst[j] = src[i];
+                }
+                j++;
+            }
+        }
+    }
+    task->num_uniq = j - task->out_begin;
+    return NULL;
+}
+
+/**
+ * @brief Sort and unique the keys. The sorted uniques are written to
+ *   output_arr (num_elems keys of room) if it isn't NULL.
+ * 
+ * @returns
+ *  The number of the unique keys, or 0 with *err_flag 5 if failed to
+ *  allocate the scratch memory.
+ */
+static uint64_t radix_sort_unique(const void *input_arr, const uint64_t num_elems, uint32_t key_bytes, void *output_arr, int *err_flag, btas_stats *stats) {
+    uint64_t num_tasks = get_num_threads(), j = 0;
+    uint32_t num_passes = key_bytes, num_sort_passes = 0, i, t;
+    uint8_t is_trivial[8] = {0};
+    void *scratch = NULL, *sort_buffer = NULL, *dst = NULL;
+    const void *src = input_arr;
+    num_tasks = (num_elems / RADIX_TASK_MIN_ELEMS < num_tasks) ? (num_elems / RADIX_TASK_MIN_ELEMS) : num_tasks;
+    num_tasks = (num_tasks == 0) ? 1 : num_tasks;
+    radix_task *tasks = (radix_task *)calloc(num_tasks, sizeof(radix_task));
+    uint64_t *hists = (uint64_t *)calloc(num_tasks * num_passes * RADIX_BUCKETS, sizeof(uint64_t));
+    if(tasks == NULL || hists == NULL) {
+        *err_flag = 5;
+        goto free_memory;
+    }
+    for(t = 0; t < num_tasks; t++) {
+        tasks[t].src = input_arr;
+        tasks[t].begin = num_elems * t / num_tasks;
+        tasks[t].end = num_elems * (t + 1) / num_tasks;
+        tasks[t].key_bytes = key_bytes;
+        tasks[t].hist = hists + (uint64_t)t * num_passes * RADIX_BUCKETS;
+    }
+    run_parallel_tasks(radix_hist_task, tasks, sizeof(radix_task), (uint32_t)num_tasks);
+    /* A digit the same for all the keys doesn't move them: skip its pass. */
+    for(i = 0; i < num_passes; i++) {
+        for(uint32_t d = 0; d < RADIX_BUCKETS && !is_trivial[i]; d++) {
+            uint64_t bucket_total = 0;
+            for(t = 0; t < num_tasks; t++) {
+                bucket_total += tasks[t].hist[i * RADIX_BUCKETS + d];
+            }
+            is_trivial[i] = (bucket_total == num_elems);
+        }
+        num_sort_passes += !is_trivial[i];
+    }
+    /* The passes alternate between the output (or a 2nd scratch) and the
+     * scratch, and the last one lands in the scratch, so the unique pass
+     * moves the keys to the output. */
+    if(num_sort_passes > 0) {
+        scratch = malloc(num_elems * key_bytes);
+        sort_buffer = (output_arr != NULL) ? output_arr : ((num_sort_passes > 1) ? malloc(num_elems * key_bytes) : scratch);
+        if(scratch == NULL || sort_buffer == NULL) {
+            *err_flag = 5;
+            goto free_memory;
+        }
+    }
+    dst = (num_sort_passes % 2 == 1) ? scratch : sort_buffer;
+    for(i = 0; i < num_passes; i++) {
+        uint64_t offset = 0;
+        if(is_trivial[i]) {
+            continue;
+        }
+        for(t = 0; t < num_tasks; t++) {
+            tasks[t].src = src;
+            tasks[t].dst = dst;
+            tasks[t].shift = i * RADIX_BITS;
+        }
+        /* The chunks of the input were counted already. A chunk of a sorted
+         * buffer holds other keys, so it is counted again. */
+        if(src == input_arr) {
+            for(t = 0; t < num_tasks; t++) {
+                memcpy(tasks[t].offsets, tasks[t].hist + i * RADIX_BUCKETS, RADIX_BUCKETS * sizeof(uint64_t));
+            }
+        }
+        else if(num_tasks > 1) {
+            run_parallel_tasks(radix_digit_task, tasks, sizeof(radix_task), (uint32_t)num_tasks);
+        }
+        else {
+            memcpy(tasks[0].offsets, tasks[0].hist + i * RADIX_BUCKETS, RADIX_BUCKETS * sizeof(uint64_t));
+        }
+        for(uint32_t d = 0; d < RADIX_BUCKETS; d++) {
+            for(t = 0; t < num_tasks; t++) {
+                uint64_t count = tasks[t].offsets[d];
+                tasks[t].offsets[d] = offset;
+                offset += count;
+            }
+        }
+        run_parallel_tasks(radix_scatter_task, tasks, sizeof(radix_task), (uint32_t)num_tasks);
+        src = dst;
+        dst = (dst == scratch) ? sort_buffer : scratch;
+    }
+    /* Count the uniques per chunk, then write them from the chunk offsets. */
+    for(t = 0; t < num_tasks; t++) {
+        tasks[t].src = src;
+        tasks[t].dst = NULL;
+        tasks[t].out_begin = 0;
+    }
+    run_parallel_tasks(radix_unique_task, tasks, sizeof(radix_task), (uint32_t)num_tasks);
+    for(t = 0; t < num_tasks; t++) {
+        tasks[t].out_begin = j;
+        tasks[t].dst = output_arr;
+        j += tasks[t].num_uniq;
+    }
+    if(output_arr != NULL) {
+        run_parallel_tasks(radix_unique_task, tasks, sizeof(radix_task), (uint32_t)num_tasks);
+    }
+    if(stats != NULL) {
+        uint64_t num_scratch = (num_sort_passes == 0) ? 0 : ((output_arr != NULL || num_sort_passes == 1) ? 1 : 2);
+        stats->num_branches = num_tasks;
+        stats->index_bytes = num_tasks * (num_passes * RADIX_BUCKETS * sizeof(uint64_t) + sizeof(radix_task));
+        stats->branch_bytes = num_scratch * num_elems * key_bytes;
+        stats->output_bytes = (output_arr != NULL) ? num_elems * key_bytes : 0;
+        stats->peak_bytes = stats->index_bytes + stats->branch_bytes + stats->output_bytes;
+    }
+free_memory:
+    if(sort_buffer != output_arr && sort_buffer != scratch) {
+        free(sort_buffer);
+    }
+    free(scratch);
+    free(hists);
+    free(tasks);
+    return (*err_flag == 0) ? j : 0;
+}
+
+/**
+ * 
+ * @brief Filter out the unique integers from a given array by a parallel
+ *  radix sort. The output is in ascending order.
+ * 
+ * @param [in]
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the integer elems in the given array
+ *  
+ * @param [out]
+ *  *num_elems_out is the number of the output unique integers
+ *  *err_flag is for debugging errors
+ * 
+ * @returns
+ *  The pointer of the allocated output array if succeeded
+ *  NULL if any error happens
+ * 
+ */
+uint32_t* fui_radix(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    uint64_t j = 0;
+    uint32_t *final_output_arr = NULL;
+    *err_flag = 0;
+    stats_reset(stats);
+    *num_elems_out = 0;
+    if (input_arr == NULL) {
+        *err_flag = -5;
+        return NULL;
+    }
+    if (num_elems < 1){
+        *err_flag = -3;
+        return NULL;
+    }
+    uint32_t *output_arr = (uint32_t *)malloc(num_elems * sizeof(uint32_t));
+    if (output_arr == NULL) {
+        *err_flag = -1;
+        return NULL;
+    }
+    j = radix_sort_unique(input_arr, num_elems, sizeof(uint32_t), output_arr, err_flag, stats);
+    if(*err_flag != 0) {
+        free(output_arr);
+        return NULL;
+    }
+    final_output_arr = (uint32_t *)realloc(output_arr, j * sizeof(uint32_t));
+    if(final_output_arr == NULL) {
+        free(output_arr);
+        *err_flag = 3;
+        return NULL;
+    }
+    *num_elems_out = j;
+    return final_output_arr;
+}
+
+uint64_t fui_radix_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
+    *err_flag = 0;
+    stats_reset(stats);
+    if (input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    if (num_elems < 1){
+        *err_flag = -3;
+        return 0;
+    }
+    return radix_sort_unique(input_arr, num_elems, sizeof(uint32_t), NULL, err_flag, stats);
+}
+
+/* The same as fui_radix, for 64-bit integers. */
+uint64_t* fui_radix_u64(const uint64_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    uint64_t j = 0;
+    uint64_t *final_output_arr = NULL;
+    *err_flag = 0;
+    stats_reset(stats);
+    *num_elems_out = 0;
+    if (input_arr == NULL) {
+        *err_flag = -5;
+        return NULL;
+    }
+    if (num_elems < 1){
+        *err_flag = -3;
+        return NULL;
+    }
+    uint64_t *output_arr = (uint64_t *)malloc(num_elems * sizeof(uint64_t));
+    if (output_arr == NULL) {
+        *err_flag = -1;
+        return NULL;
+    }
+    j = radix_sort_unique(input_arr, num_elems, sizeof(uint64_t), output_arr, err_flag, stats);
+    if(*err_flag != 0) {
+        free(output_arr);
+        return NULL;
+    }
+    final_output_arr = (uint64_t *)realloc(output_arr, j * sizeof(uint64_t));
+    if(final_output_arr == NULL) {
+        free(output_arr);
+        *err_flag = 3;
+        return NULL;
+    }
+    *num_elems_out = j;
+    return final_output_arr;
+}
+
+/* Not implemented yet: fails with err_flag 13. fui_radix_u64() dedups 64-bit integers. */
+uint64_t* fui_bitmap_dyn64(const uint64_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    (void)input_arr;
+    (void)num_elems;
+    stats_reset(stats);
+    *num_elems_out = 0;
+    *err_flag = 13;
+    return NULL;
 }
 
 /*
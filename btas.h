@@ -11,6 +11,7 @@
 #define BTAS_H_
 
 #include <stdint.h> /* C99 is required. */
+#include <stddef.h>
 
 /**
  * If the header failed to get included. Define the types by typedefs.
@@ -50,23 +51,111 @@ typedef signed char         int8_t;
  *  - Print out an array
  *  - Compare 2 arrays
  *  - Generate a RANDOM input signed integer array
+ *  - Generate seeded RANDOM, ZIPFIAN, CLUSTERED, NEARLY-SORTED, REVERSE-SORTED
+ *    and SPARSE 64-bit input arrays (filled in parallel)
  *  - Generate a GROWING input signed integer array
+ *  - Get/Set the number of worker threads used by the parallel routines
+ *  - Run a group of tasks in parallel threads
  */
+#define GEN_RANDOM          0
+#define GEN_ZIPF            1
+#define GEN_CLUSTERED       2
+#define GEN_NEARLY_SORTED   3
+#define GEN_REVERSE_SORTED  4
+#define GEN_SPARSE_U64      5
+#define GEN_TASK_MIN_ELEMS  1048576 /* Below this, a generator runs in 1 thread */
+#define GEN_SORTED_WINDOW   1024
+
 int string_to_u64_num(const char* string, uint64_t *unsigned_num);
 int string_to_u32_num(const char* string, uint32_t *unsigned_num);
 void print_arr(const uint32_t *arr, uint64_t num_elems, uint64_t max_elems);
 int compare_arr(const uint32_t *arr_a, const uint32_t *arr_b, uint64_t num_elems);
 int generate_random_input_arr(uint32_t *arr, uint64_t num_elems, uint32_t rand_max);
+int generate_random_arr_seed(uint32_t *arr, uint64_t num_elems, uint32_t rand_max, uint64_t seed);
+int generate_zipf_arr(uint32_t *arr, uint64_t num_elems, uint32_t num_keys, double skew, uint64_t seed);
+int generate_clustered_arr(uint32_t *arr, uint64_t num_elems, uint32_t num_stems, uint64_t seed);
+int generate_nearly_sorted_arr(uint32_t *arr, uint64_t num_elems, uint32_t disorder_permille, uint64_t seed);
+int generate_reverse_sorted_arr(uint32_t *arr, uint64_t num_elems);
+int generate_sparse_u64_arr(uint64_t *arr, uint64_t num_elems, uint64_t num_distinct, uint64_t seed);
 int generate_growing_arr(uint32_t *arr, uint64_t num_elems);
 int cmd_flag_parser(int argc, char **argv, const char *cmd_flag);
+void set_num_threads(uint32_t num_threads);
+uint32_t get_num_threads(void);
+int run_parallel_tasks(void *(*task_func)(void *), void *task_args, size_t arg_size, uint32_t num_tasks);
+
+/**
+ * Memory accounting of a single fui_* call. Every fui_* function takes a
+ * trailing btas_stats pointer. Pass NULL to skip the accounting, which
+ * costs a scan of the stem at teardown otherwise.
+ * 
+ * peak_bytes is the memory held at the end of the insertion, which is the
+ * peak of a call: stem + branches + index + output buffer (allocated for
+ * all the input elements, shrunk to the unique ones afterwards).
+ */
+typedef struct {
+    uint64_t num_branches;  /* Branches (BitTree) or hash table rows allocated */
+    uint64_t stem_length;   /* Length of the stem array reached */
+    uint64_t stem_bytes;
+    uint64_t branch_bytes;
+    uint64_t index_bytes;   /* Adjacent index hashmap and duplicate list */
+    uint64_t output_bytes;
+    uint64_t peak_bytes;
+} btas_stats;
+
+/**
+ * Per-phase tracing of fui_bitmap_dyn, fui_bitmap_idx and fui_htable_dyn.
+ * The trace points are compiled in only with -DBTAS_TRACE; otherwise they
+ * are empty and btas_set_trace_callback() returns -1.
+ *
+ * A call records the total duration, the first start and the count of every
+ * phase, and hands the record to the callback when it returns (failed calls
+ * included, except those rejecting the input). STEM_GROW and BRANCH_ALLOC 
+ * are nested in INSERT. Times are CLOCK_MONOTONIC nanoseconds.
+ *
+ * With -DBTAS_TRACE_USDT and <sys/sdt.h>, the USDT probes btas:call and
+ * btas:phase fire as well, with or without a callback.
+ */
+#define BTAS_PHASE_SETUP        0   /* Stem and output allocation */
+#define BTAS_PHASE_STEM_GROW    1   /* Stem reallocs */
+#define BTAS_PHASE_BRANCH_ALLOC 2   /* Branch callocs (and reallocs) */
+#define BTAS_PHASE_INSERT       3   /* The insert loop */
+#define BTAS_PHASE_TEARDOWN     4   /* Free the branches and the stem */
+#define BTAS_PHASE_OUTPUT       5   /* Shrink (or build) the output */
+#define BTAS_NUM_PHASES         6
+
+typedef struct {
+    const char *engine;
+    uint64_t num_elems;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t phase_first_ns[BTAS_NUM_PHASES];
+    uint64_t phase_ns[BTAS_NUM_PHASES];
+    uint64_t phase_count[BTAS_NUM_PHASES];
+    uint64_t phase_open_ns[BTAS_NUM_PHASES]; /* Internal */
+    int err_flag;
+} btas_trace;
+
+typedef void (*btas_trace_func)(const btas_trace *trace, void *user_data);
+
+extern const char *btas_phase_names[BTAS_NUM_PHASES];
+int btas_set_trace_callback(btas_trace_func func, void *user_data);
+
+/**
+ * Small-input path. The hash table and BitTree fui_* engines (all but
+ * fui_bitmap_idx and fui_bitmap_ctx) dedup up to SMALL_INPUT_MAX integers
+ * with a small stack table instead, in well under a microsecond for a few
+ * hundred. The output is the same. These calls are not traced.
+ */
+#define SMALL_INPUT_MAX     4096
+#define SMALL_TABLE_SIZE    (SMALL_INPUT_MAX * 2)
 
 /**
  * Section B. Brute and Brute-Opt algorithms
  */
-uint32_t* fui_brute(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag);
-uint64_t fui_brute_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag);
-uint32_t* fui_brute_opt(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag);
-uint64_t fui_brute_opt_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag);
+uint32_t* fui_brute(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_brute_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
+uint32_t* fui_brute_opt(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_brute_opt_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
 
 
 /**
@@ -88,14 +177,25 @@ typedef struct {
 void free_hash_table(uint8_t *hash_table[], uint32_t num_elems);
 void free_hash_table_new(htable_base hash_table_new[], uint32_t num_elems);
 
-uint32_t* fui_htable(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag);
-uint64_t fui_htable_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag);
+uint32_t* fui_htable(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_htable_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
+
+uint32_t* fui_htable_new(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_htable_new_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
+
+uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_htable_dyn_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
 
-uint32_t* fui_htable_new(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag);
-uint64_t fui_htable_new_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag);
+/**
+ * An open-addressing set with Swiss-table control bytes (SSE2-probed when
+ * available). Memory scales with the unique integers, not their range.
+ */
+#define HT_SWISS_GROUP      16
+#define HT_SWISS_EMPTY      0x80
+#define HT_SWISS_INI_SIZE   1024
 
-uint32_t* fui_htable_dyn(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag);
-uint64_t fui_htable_dyn_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag);
+uint32_t* fui_htable_swiss(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_htable_swiss_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
 
 /**
  * Section D. BitTree Algorithms.
@@ -109,6 +209,7 @@ uint64_t fui_htable_dyn_count(const uint32_t *input_arr, const uint64_t num_elem
 #define BITMAP_LENGTH_MAX   65536
 #define IDX_ADJ_BRCH_SIZE   65536
 #define BITMAP_BRCH_TREE    65536
+#define BITMAP_RUN_MIN      32      /* Runs of consecutive integers filled at once */
 
 struct dup_idx_struct {
     uint64_t index_a;
@@ -162,12 +263,74 @@ void free_idx_ht_8(idx_ht_8 *idx_ht_head, uint32_t num_elems);
 void free_idx_ht_16(idx_ht_16 *idx_ht_head, uint32_t num_elems);
 void free_idx_ht_32(idx_ht_32 *idx_ht_head, uint32_t num_elems);
 
-uint32_t* fui_bitmap_stc(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag);
-uint64_t fui_bitmap_stc_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag);
-uint32_t* fui_bitmap_dyn(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag);
-uint64_t fui_bitmap_dyn_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag);
-out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, dup_idx_list **dup_idx_head);
+uint32_t* fui_bitmap_stc(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_bitmap_stc_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
+uint32_t* fui_bitmap_dyn(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_bitmap_dyn_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
+out_idx* fui_bitmap_idx(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, dup_idx_list **dup_idx_head, btas_stats *stats);
+
+uint64_t* fui_bitmap_dyn64(const uint64_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+
+/**
+ * Section E. Streaming BitTree.
+ * 
+ * A dynamic BitTree that outlives a single call, so the input can be fed
+ * block by block (e.g. while decoding or reading a file). 
+ * 
+ */
+typedef struct {
+    bitmap_base *bitmap_head;
+    uint32_t bitmap_base_size;
+    uint32_t num_branches;
+    uint64_t num_elems; /* Unique integers recorded */
+} bitmap_tree;
+
+int bitmap_tree_init(bitmap_tree *tree);
+void bitmap_tree_free(bitmap_tree *tree);
+int bitmap_tree_contains(const bitmap_tree *tree, uint32_t elem);
+uint64_t bitmap_tree_insert_arr(bitmap_tree *tree, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag);
+
+/**
+ * Section F. Reusable BitTree context.
+ * 
+ * For many calls on medium-sized batches, where calloc'ing the branches
+ * and walking the stem to free them dominate. The context keeps its stem
+ * across calls and lists the branches a call took. A reset zeroes only
+ * those and keeps them as spares, which the next calls take instead of
+ * calloc'ing. Memory is held until bitmap_ctx_free().
+ * 
+ */
+typedef struct {
+    bitmap_tree tree;
+    uint16_t *used_list;        /* The stem entries holding a branch */
+    uint8_t **spare_branches;   /* Zeroed branches for the next calls */
+    uint32_t num_spare;
+} bitmap_ctx;
+
+int bitmap_ctx_init(bitmap_ctx *ctx);
+void bitmap_ctx_free(bitmap_ctx *ctx);
+void bitmap_ctx_reset(bitmap_ctx *ctx);
+uint64_t bitmap_ctx_insert_arr(bitmap_ctx *ctx, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag);
+uint32_t* fui_bitmap_ctx(bitmap_ctx *ctx, const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_bitmap_ctx_count(bitmap_ctx *ctx, const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
+
+/**
+ * Section G. Sort-based engines.
+ * 
+ * A parallel LSD radix sort (8-bit digits) followed by an adjacent-unique
+ * pass. The output is in ascending order rather than in the order of the
+ * first occurrences. With mostly unique inputs it beats the bitmaps, which
+ * would have to be scanned or sorted for a sorted output anyway. Digits
+ * that are the same for all the elements are skipped. Memory is 2 buffers
+ * as large as the input.
+ * 
+ */
+#define RADIX_BITS              8
+#define RADIX_BUCKETS           (1 << RADIX_BITS)
+#define RADIX_TASK_MIN_ELEMS    262144  /* Below this, a chunk isn't worth a thread */
 
-uint64_t* fui_bitmap_dyn64(const uint64_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag);
+uint32_t* fui_radix(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_radix_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
+uint64_t* fui_radix_u64(const uint64_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
 
 #endif
\ No newline at end of file
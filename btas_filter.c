@@ -0,0 +1,516 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "btas.h"
+#include "btas_filter.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define FILTER_PREFETCH(addr) __builtin_prefetch((addr), 1, 3)
+#else
+#define FILTER_PREFETCH(addr) ((void)(addr))
+#endif
+
+#define SWAR_LANES_LOW  0x0001000100010001ULL
+#define SWAR_LANES_HIGH 0x8000800080008000ULL
+
+static const uint32_t bloom_salts[8] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+/* The 64-bit finalizer of MurmurHash3. */
+static inline uint64_t filter_hash(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+/**
+ * @brief Initialize an empty blocked Bloom filter of mem_budget bytes
+ *   (rounded down to 32-byte blocks, at most 128 GiB).
+ *
+ * @returns
+ *  -5 if the filter pointer is null
+ *  -3 if the budget is less than a block
+ *   5 if failed to allocate memory
+ *   0 if succeeded
+ */
+int bloom_filter_init(bloom_filter *bf, uint64_t mem_budget) {
+    if(bf == NULL) {
+        return -5;
+    }
+    memset(bf, 0, sizeof(bloom_filter));
+    bf->num_blocks = mem_budget / BLOOM_BLOCK_BYTES;
+    bf->num_blocks = (bf->num_blocks > BLOOM_MAX_BLOCKS) ? BLOOM_MAX_BLOCKS : bf->num_blocks;
+    if(bf->num_blocks == 0) {
+        return -3;
+    }
+    /* Align the blocks, so a block never straddles 2 cache lines. */
+    if((bf->raw = calloc(bf->num_blocks * BLOOM_BLOCK_BYTES + 64, 1)) == NULL) {
+        bf->num_blocks = 0;
+        return 5;
+    }
+    bf->blocks = (uint32_t *)(((uintptr_t)bf->raw + 63) & ~(uintptr_t)63);
+    return 0;
+}
+
+void bloom_filter_free(bloom_filter *bf) {
+    if(bf == NULL) {
+        return;
+    }
+    free(bf->raw);
+    memset(bf, 0, sizeof(bloom_filter));
+}
+
+static inline uint32_t* bloom_block(const bloom_filter *bf, uint64_t hash) {
+    return bf->blocks + (((hash >> 32) * bf->num_blocks) >> 32) * 8;
+}
+
+/* Check the 8 bits of a key in its block, and set them if set_bits. */
+static inline int bloom_check_set(uint32_t *block, uint32_t key32, int set_bits) {
+#if defined(__AVX2__)
+    const __m256i salts = _mm256_loadu_si256((const __m256i *)bloom_salts);
+    __m256i bit_index = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32((int)key32), salts), 27);
+    __m256i mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), bit_index);
+    __m256i words = _mm256_load_si256((const __m256i *)block);
+    if(_mm256_testc_si256(words, mask)) {
+        return 1;
+    }
+    if(set_bits) {
+        _mm256_store_si256((__m256i *)block, _mm256_or_si256(words, mask));
+    }
+    return 0;
+#else
+    uint32_t mask[8], is_present = 1;
+    for(int i = 0; i < 8; i++) {
+        mask[i] = 1U << ((key32 * bloom_salts[i]) >> 27);
+        is_present &= ((block[i] & mask[i]) != 0);
+    }
+    if(is_present) {
+        return 1;
+    }
+    if(set_bits) {
+        for(int i = 0; i < 8; i++) {
+            block[i] |= mask[i];
+        }
+    }
+    return 0;
+#endif
+}
+
+/**
+ *
+ * @brief Insert a block of keys to a Bloom filter
+ *
+ * @param [out]
+ *  *output_arr receives the keys not (probably) inserted before, in the
+ *   order of the input. It must be able to hold num_elems keys. NULL to
+ *   skip.
+ *  *err_flag is -5 for null input
+ *
+ * @returns
+ *  The number of keys not (probably) inserted before
+ *
+ */
+uint64_t bloom_filter_insert_arr(bloom_filter *bf, const uint64_t *input_arr, const uint64_t num_elems, uint64_t *output_arr, int *err_flag) {
+    uint64_t i, j = 0, hashes[FILTER_BATCH];
+    uint32_t *blocks[FILTER_BATCH];
+    *err_flag = 0;
+    if(bf == NULL || bf->blocks == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    for(i = 0; i < num_elems; i += FILTER_BATCH) {
+        uint64_t batch_size = ((num_elems - i) < FILTER_BATCH) ? (num_elems - i) : FILTER_BATCH;
+        for(uint64_t k = 0; k < batch_size; k++) {
+            hashes[k] = filter_hash(input_arr[i + k]);
+            blocks[k] = bloom_block(bf, hashes[k]);
+            FILTER_PREFETCH(blocks[k]);
+        }
+        for(uint64_t k = 0; k < batch_size; k++) {
+            if(bloom_check_set(blocks[k], (uint32_t)hashes[k], 1)) {
+                continue;
+            }
+            if(output_arr != NULL) {
+                output_arr[j] = input_arr[i + k];
+            }
+            j++;
+        }
+    }
+    bf->num_inserted += j;
+    return j;
+}
+
+/**
+ * @param [out]
+ *  *result_arr receives 1 for the keys (probably) present, 0 for the others.
+ *   NULL to only count them.
+ *
+ * @returns
+ *  The number of keys (probably) present
+ */
+uint64_t bloom_filter_probe_arr(const bloom_filter *bf, const uint64_t *input_arr, const uint64_t num_elems, uint8_t *result_arr) {
+    uint64_t i, num_present = 0, hashes[FILTER_BATCH];
+    uint32_t *blocks[FILTER_BATCH];
+    if(bf == NULL || bf->blocks == NULL || input_arr == NULL) {
+        return 0;
+    }
+    for(i = 0; i < num_elems; i += FILTER_BATCH) {
+        uint64_t batch_size = ((num_elems - i) < FILTER_BATCH) ? (num_elems - i) : FILTER_BATCH;
+        for(uint64_t k = 0; k < batch_size; k++) {
+            hashes[k] = filter_hash(input_arr[i + k]);
+            blocks[k] = bloom_block(bf, hashes[k]);
+            FILTER_PREFETCH(blocks[k]);
+        }
+        for(uint64_t k = 0; k < batch_size; k++) {
+            int is_present = bloom_check_set(blocks[k], (uint32_t)hashes[k], 0);
+            if(result_arr != NULL) {
+                result_arr[i + k] = (uint8_t)is_present;
+            }
+            num_present += (uint64_t)is_present;
+        }
+    }
+    return num_present;
+}
+
+/**
+ * @brief Initialize an empty cuckoo filter of at most mem_budget bytes
+ *   (rounded down to a power of 2 of 8-byte buckets).
+ *
+ * @returns
+ *  -5 if the filter pointer is null
+ *  -3 if the budget is less than 2 buckets
+ *   5 if failed to allocate memory
+ *   0 if succeeded
+ */
+int cuckoo_filter_init(cuckoo_filter *cf, uint64_t mem_budget) {
+    uint64_t num_buckets = 1;
+    if(cf == NULL) {
+        return -5;
+    }
+    memset(cf, 0, sizeof(cuckoo_filter));
+    while(num_buckets * 2 * sizeof(uint64_t) <= mem_budget && num_buckets < (1ULL << 32)) {
+        num_buckets *= 2;
+    }
+    if(num_buckets < 2) {
+        return -3;
+    }
+    if((cf->buckets = (uint64_t *)calloc(num_buckets, sizeof(uint64_t))) == NULL) {
+        return 5;
+    }
+    cf->num_buckets = num_buckets;
+    cf->rng = 0x9E3779B97F4A7C15ULL;
+    return 0;
+}
+
+void cuckoo_filter_free(cuckoo_filter *cf) {
+    if(cf == NULL) {
+        return;
+    }
+    free(cf->buckets);
+    memset(cf, 0, sizeof(cuckoo_filter));
+}
+
+static inline uint16_t cuckoo_fp(uint64_t hash) {
+    uint16_t fp = (uint16_t)(hash & 0xFFFF);
+    return (fp == 0) ? 1 : fp;
+}
+
+static inline uint64_t cuckoo_alt_index(const cuckoo_filter *cf, uint64_t index, uint16_t fp) {
+    return (index ^ filter_hash(fp)) & (cf->num_buckets - 1);
+}
+
+/* Whether a bucket holds fp, testing the 4 lanes at once. */
+static inline int bucket_has(uint64_t bucket, uint16_t fp) {
+    uint64_t diff = bucket ^ (SWAR_LANES_LOW * fp);
+    return ((diff - SWAR_LANES_LOW) & ~diff & SWAR_LANES_HIGH) != 0;
+}
+
+static inline int bucket_put(uint64_t *bucket, uint16_t fp) {
+    for(int lane = 0; lane < CUCKOO_SLOTS; lane++) {
+        if(((*bucket >> (lane * 16)) & 0xFFFF) == 0) {
+            *bucket |= (uint64_t)fp << (lane * 16);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline int bucket_remove(uint64_t *bucket, uint16_t fp) {
+    for(int lane = 0; lane < CUCKOO_SLOTS; lane++) {
+        if(((*bucket >> (lane * 16)) & 0xFFFF) == fp) {
+            *bucket &= ~((uint64_t)0xFFFF << (lane * 16));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int cuckoo_contains(const cuckoo_filter *cf, uint64_t index, uint16_t fp) {
+    uint64_t alt_index = cuckoo_alt_index(cf, index, fp);
+    if(bucket_has(cf->buckets[index], fp) || bucket_has(cf->buckets[alt_index], fp)) {
+        return 1;
+    }
+    return cf->has_victim && cf->victim_fp == fp && (cf->victim_index == index || cf->victim_index == alt_index);
+}
+
+/**
+ * @brief Place a fingerprint, relocating others if both buckets are full.
+ *   If the relocations give up, the last evicted fingerprint is kept as
+ *   the victim and the filter is full.
+ *
+ * @returns
+ *   0 if placed
+ *   9 if the filter is full
+ */
+static int cuckoo_place(cuckoo_filter *cf, uint64_t index, uint16_t fp) {
+    uint64_t alt_index = cuckoo_alt_index(cf, index, fp);
+    if(bucket_put(cf->buckets + index, fp) || bucket_put(cf->buckets + alt_index, fp)) {
+        return 0;
+    }
+    if(cf->has_victim) {
+        return 9;
+    }
+    cf->rng ^= cf->rng << 13;
+    cf->rng ^= cf->rng >> 7;
+    cf->rng ^= cf->rng << 17;
+    index = (cf->rng & 1) ? alt_index : index;
+    for(int kick = 0; kick < CUCKOO_MAX_KICKS; kick++) {
+        int lane = (int)((cf->rng >> (kick & 31)) & 0x03);
+        uint16_t evicted = (uint16_t)((cf->buckets[index] >> (lane * 16)) & 0xFFFF);
+        cf->buckets[index] = (cf->buckets[index] & ~((uint64_t)0xFFFF << (lane * 16))) | ((uint64_t)fp << (lane * 16));
+        fp = evicted;
+        index = cuckoo_alt_index(cf, index, fp);
+        if(bucket_put(cf->buckets + index, fp)) {
+            return 0;
+        }
+    }
+    cf->victim_index = index;
+    cf->victim_fp = fp;
+    cf->has_victim = 1;
+    return 0;
+}
+
+/**
+ *
+ * @brief Insert a block of keys to a cuckoo filter
+ *
+ * @param [out]
+ *  *output_arr receives the keys not (probably) inserted before, in the
+ *   order of the input. It must be able to hold num_elems keys. NULL to
+ *   skip.
+ *  *err_flag is -5 for null input, 9 if the filter is full (the keys before
+ *   are kept)
+ *
+ * @returns
+ *  The number of keys not (probably) inserted before
+ *
+ */
+uint64_t cuckoo_filter_insert_arr(cuckoo_filter *cf, const uint64_t *input_arr, const uint64_t num_elems, uint64_t *output_arr, int *err_flag) {
+    uint64_t i, j = 0, hashes[FILTER_BATCH], indexes[FILTER_BATCH];
+    *err_flag = 0;
+    if(cf == NULL || cf->buckets == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    for(i = 0; i < num_elems && *err_flag == 0; i += FILTER_BATCH) {
+        uint64_t batch_size = ((num_elems - i) < FILTER_BATCH) ? (num_elems - i) : FILTER_BATCH;
+        for(uint64_t k = 0; k < batch_size; k++) {
+            hashes[k] = filter_hash(input_arr[i + k]);
+            indexes[k] = (hashes[k] >> 32) & (cf->num_buckets - 1);
+            FILTER_PREFETCH(cf->buckets + indexes[k]);
+            FILTER_PREFETCH(cf->buckets + cuckoo_alt_index(cf, indexes[k], cuckoo_fp(hashes[k])));
+        }
+        for(uint64_t k = 0; k < batch_size; k++) {
+            uint16_t fp = cuckoo_fp(hashes[k]);
+            if(cuckoo_contains(cf, indexes[k], fp)) {
+                continue;
+            }
+            if((*err_flag = cuckoo_place(cf, indexes[k], fp)) != 0) {
+                break;
+            }
+            cf->num_items++;
+            if(output_arr != NULL) {
+                output_arr[j] = input_arr[i + k];
+            }
+            j++;
+        }
+    }
+    return j;
+}
+
+/**
+ * @param [out]
+ *  *result_arr receives 1 for the keys (probably) present, 0 for the others.
+ *   NULL to only count them.
+ *
+ * @returns
+ *  The number of keys (probably) present
+ */
+uint64_t cuckoo_filter_probe_arr(const cuckoo_filter *cf, const uint64_t *input_arr, const uint64_t num_elems, uint8_t *result_arr) {
+    uint64_t i, num_present = 0, hashes[FILTER_BATCH], indexes[FILTER_BATCH];
+    if(cf == NULL || cf->buckets == NULL || input_arr == NULL) {
+        return 0;
+    }
+    for(i = 0; i < num_elems; i += FILTER_BATCH) {
+        uint64_t batch_size = ((num_elems - i) < FILTER_BATCH) ? (num_elems - i) : FILTER_BATCH;
+        for(uint64_t k = 0; k < batch_size; k++) {
+            hashes[k] = filter_hash(input_arr[i + k]);
+            indexes[k] = (hashes[k] >> 32) & (cf->num_buckets - 1);
+            FILTER_PREFETCH(cf->buckets + indexes[k]);
+            FILTER_PREFETCH(cf->buckets + cuckoo_alt_index(cf, indexes[k], cuckoo_fp(hashes[k])));
+        }
+        for(uint64_t k = 0; k < batch_size; k++) {
+            int is_present = cuckoo_contains(cf, indexes[k], cuckoo_fp(hashes[k]));
+            if(result_arr != NULL) {
+                result_arr[i + k] = (uint8_t)is_present;
+            }
+            num_present += (uint64_t)is_present;
+        }
+    }
+    return num_present;
+}
+
+/**
+ * @brief Delete keys from a cuckoo filter. Only delete the keys inserted
+ *   before: deleting another key may remove the fingerprint of a key that
+ *   shares it.
+ *
+ * @returns
+ *  The number of keys deleted
+ */
+uint64_t cuckoo_filter_delete_arr(cuckoo_filter *cf, const uint64_t *input_arr, const uint64_t num_elems) {
+    uint64_t i, num_deleted = 0;
+    if(cf == NULL || cf->buckets == NULL || input_arr == NULL) {
+        return 0;
+    }
+    for(i = 0; i < num_elems; i++) {
+        uint64_t hash = filter_hash(input_arr[i]);
+        uint64_t index = (hash >> 32) & (cf->num_buckets - 1);
+        uint16_t fp = cuckoo_fp(hash);
+        uint64_t alt_index = cuckoo_alt_index(cf, index, fp);
+        if(bucket_remove(cf->buckets + index, fp) || bucket_remove(cf->buckets + alt_index, fp)) {
+            num_deleted++;
+            cf->num_items--;
+            /* A slot is free now: try to place the victim again. */
+            if(cf->has_victim) {
+                cf->has_victim = 0;
+                if(cuckoo_place(cf, cf->victim_index, cf->victim_fp) != 0) {
+                    cf->has_victim = 1;
+                }
+            }
+        }
+        else if(cf->has_victim && cf->victim_fp == fp && (cf->victim_index == index || cf->victim_index == alt_index)) {
+            cf->has_victim = 0;
+            num_deleted++;
+            cf->num_items--;
+        }
+    }
+    return num_deleted;
+}
+
+/* The shared body of fui_bloom_u64 and fui_cuckoo_u64. */
+static uint64_t* fui_filter_u64(int use_cuckoo, const uint64_t *input_arr, const uint64_t num_elems, uint64_t mem_budget, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    bloom_filter bf;
+    cuckoo_filter cf;
+    uint64_t j = 0, *final_output_arr = NULL, filter_bytes = 0;
+    *err_flag = 0;
+    *num_elems_out = 0;
+    if(stats != NULL) {
+        memset(stats, 0, sizeof(btas_stats));
+    }
+    if(input_arr == NULL) {
+        *err_flag = -5;
+        return NULL;
+    }
+    if(num_elems < 1) {
+        *err_flag = -3;
+        return NULL;
+    }
+    int init_flag = use_cuckoo ? cuckoo_filter_init(&cf, mem_budget) : bloom_filter_init(&bf, mem_budget);
+    if(init_flag != 0) {
+        *err_flag = (init_flag == -3) ? -3 : 5;
+        return NULL;
+    }
+    uint64_t *output_arr = (uint64_t *)calloc(num_elems, sizeof(uint64_t));
+    if(output_arr == NULL) {
+        use_cuckoo ? cuckoo_filter_free(&cf) : bloom_filter_free(&bf);
+        *err_flag = -1;
+        return NULL;
+    }
+    if(use_cuckoo) {
+        j = cuckoo_filter_insert_arr(&cf, input_arr, num_elems, output_arr, err_flag);
+        filter_bytes = cf.num_buckets * sizeof(uint64_t);
+        cuckoo_filter_free(&cf);
+    }
+    else {
+        j = bloom_filter_insert_arr(&bf, input_arr, num_elems, output_arr, err_flag);
+        filter_bytes = bf.num_blocks * BLOOM_BLOCK_BYTES;
+        bloom_filter_free(&bf);
+    }
+    if(stats != NULL) {
+        stats->index_bytes = filter_bytes;
+        stats->output_bytes = num_elems * sizeof(uint64_t);
+        stats->peak_bytes = filter_bytes + stats->output_bytes;
+    }
+    if(*err_flag != 0) {
+        free(output_arr);
+        return NULL;
+    }
+    final_output_arr = (uint64_t *)realloc(output_arr, j * sizeof(uint64_t));
+    if(final_output_arr == NULL) {
+        free(output_arr);
+        *err_flag = 3;
+        return NULL;
+    }
+    *num_elems_out = j;
+    return final_output_arr;
+}
+
+/**
+ *
+ * @brief Filter out the unique keys of an array with a blocked Bloom
+ *   filter of mem_budget bytes. No duplicate is kept, but a false positive
+ *   drops a unique key.
+ *
+ * @param [in]
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the keys in the given array
+ *  mem_budget is the size of the filter in bytes
+ *
+ * @param [out]
+ *  *num_elems_out is the number of the keys kept
+ *  *err_flag is for debugging errors
+ *  *stats receives the memory accounting if not NULL
+ *
+ * @returns
+ *  The keys kept, in the order of the input. NULL if an error occurred.
+ *
+ */
+uint64_t* fui_bloom_u64(const uint64_t *input_arr, const uint64_t num_elems, uint64_t mem_budget, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    return fui_filter_u64(0, input_arr, num_elems, mem_budget, num_elems_out, err_flag, stats);
+}
+
+/**
+ *
+ * @brief The same as fui_bloom_u64, with a cuckoo filter. Fails with
+ *   err_flag 9 if the unique keys overfill the budget.
+ *
+ */
+uint64_t* fui_cuckoo_u64(const uint64_t *input_arr, const uint64_t num_elems, uint64_t mem_budget, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    return fui_filter_u64(1, input_arr, num_elems, mem_budget, num_elems_out, err_flag, stats);
+}
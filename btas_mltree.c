@@ -0,0 +1,262 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "btas.h"
+#include "btas_mltree.h"
+
+/**
+ * @brief Initialize an empty multi-level tree.
+ *
+ * @param [in]
+ *  top_bits, mid_bits and leaf_bits are the split of the 32 bits, summing
+ *   up to 32, with top_bits 1 ~ MLTREE_TOP_BITS_MAX, mid_bits >= 1 and
+ *   leaf_bits >= MLTREE_LEAF_BITS_MIN
+ *
+ * @returns
+ *  -5 if the tree pointer is null
+ *  -3 if the split is invalid
+ *   5 if failed to allocate memory
+ *   0 if succeeded
+ */
+int bitmap_mltree_init(bitmap_mltree *tree, uint32_t top_bits, uint32_t mid_bits, uint32_t leaf_bits) {
+    if(tree == NULL) {
+        return -5;
+    }
+    memset(tree, 0, sizeof(bitmap_mltree));
+    if(top_bits < 1 || top_bits > MLTREE_TOP_BITS_MAX || mid_bits < 1 || leaf_bits < MLTREE_LEAF_BITS_MIN || top_bits + mid_bits + leaf_bits != 32) {
+        return -3;
+    }
+    if((tree->top = (uint8_t ***)calloc((size_t)1 << top_bits, sizeof(uint8_t **))) == NULL) {
+        return 5;
+    }
+    tree->top_bits = top_bits;
+    tree->mid_bits = mid_bits;
+    tree->leaf_bits = leaf_bits;
+    return 0;
+}
+
+void bitmap_mltree_free(bitmap_mltree *tree) {
+    mltree_slab *slab, *next;
+    if(tree == NULL) {
+        return;
+    }
+    for(slab = tree->slabs; slab != NULL; slab = next) {
+        next = slab->next;
+        free(slab);
+    }
+    free(tree->top);
+    memset(tree, 0, sizeof(bitmap_mltree));
+}
+
+/* Carve zeroed bytes (a multiple of 8) out of the current slab, opening a new one if needed. */
+static void* mltree_carve(bitmap_mltree *tree, uint64_t num_bytes) {
+    mltree_slab *slab = tree->slabs;
+    if(slab == NULL || slab->size - slab->used < num_bytes) {
+        uint64_t size = (num_bytes > MLTREE_SLAB_BYTES) ? num_bytes : MLTREE_SLAB_BYTES;
+        if((slab = (mltree_slab *)calloc(1, offsetof(mltree_slab, data) + size)) == NULL) {
+            return NULL;
+        }
+        slab->size = size;
+        slab->next = tree->slabs;
+        tree->slabs = slab;
+        tree->slab_bytes += offsetof(mltree_slab, data) + size;
+    }
+    slab->used += num_bytes;
+    return slab->data + slab->used - num_bytes;
+}
+
+/**
+ * @brief Insert an array to the tree and export the elems new to it.
+ *
+ * @param [in]
+ *  *tree is an initialized tree
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the elements in the given array
+ *
+ * @param [out]
+ *  *output_arr receives the new elems if not NULL. It may be input_arr.
+ *  *err_flag is for debugging errors
+ *
+ * @returns
+ *  The number of the new elems. The elems before an error are kept.
+ */
+uint64_t bitmap_mltree_insert_arr(bitmap_mltree *tree, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag) {
+    uint64_t i, j = 0;
+    uint32_t tmp, top_index, mid_index, leaf_index;
+    uint8_t **mid = NULL, *leaf = NULL;
+    *err_flag = 0;
+    if(tree == NULL || tree->top == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    /* Keep the split in locals: the byte stores to the leaves may alias the tree. */
+    uint8_t ***top = tree->top;
+    uint32_t top_shift = tree->mid_bits + tree->leaf_bits, leaf_bits = tree->leaf_bits;
+    uint32_t mid_mask = (1U << tree->mid_bits) - 1, leaf_mask = (1U << leaf_bits) - 1;
+    uint64_t mid_bytes = ((uint64_t)1 << tree->mid_bits) * sizeof(uint8_t *), leaf_bytes = ((uint64_t)1 << leaf_bits) >> 3;
+    for(i = 0; i < num_elems; i++) {
+        tmp = input_arr[i];
+        top_index = tmp >> top_shift;
+        mid_index = (tmp >> leaf_bits) & mid_mask;
+        leaf_index = tmp & leaf_mask;
+        if((mid = top[top_index]) == NULL) {
+            if((mid = (uint8_t **)mltree_carve(tree, mid_bytes)) == NULL) {
+                *err_flag = 1;
+                break;
+            }
+            top[top_index] = mid;
+            tree->num_mids++;
+        }
+        if((leaf = mid[mid_index]) == NULL) {
+            if((leaf = (uint8_t *)mltree_carve(tree, leaf_bytes)) == NULL) {
+                *err_flag = 1;
+                break;
+            }
+            mid[mid_index] = leaf;
+            tree->num_leaves++;
+        }
+        if(check_bit(leaf[leaf_index >> 3], leaf_index & 0x07)) {
+            continue;
+        }
+        if(output_arr != NULL) {
+            output_arr[j] = tmp;
+        }
+        j++;
+        flip_bit(leaf[leaf_index >> 3], leaf_index & 0x07);
+    }
+    tree->num_elems += j;
+    return j;
+}
+
+int bitmap_mltree_contains(const bitmap_mltree *tree, uint32_t elem) {
+    uint8_t **mid;
+    uint8_t *leaf;
+    uint32_t leaf_index;
+    if(tree == NULL || tree->top == NULL) {
+        return 0;
+    }
+    if((mid = tree->top[elem >> (tree->mid_bits + tree->leaf_bits)]) == NULL) {
+        return 0;
+    }
+    if((leaf = mid[(elem >> tree->leaf_bits) & ((1U << tree->mid_bits) - 1)]) == NULL) {
+        return 0;
+    }
+    leaf_index = elem & ((1U << tree->leaf_bits) - 1);
+    return check_bit(leaf[leaf_index >> 3], leaf_index & 0x07) ? 1 : 0;
+}
+
+/* The top array plus the slabs. */
+uint64_t bitmap_mltree_mem_bytes(const bitmap_mltree *tree) {
+    if(tree == NULL || tree->top == NULL) {
+        return 0;
+    }
+    return (((uint64_t)1 << tree->top_bits) * sizeof(uint8_t **)) + tree->slab_bytes;
+}
+
+static void mltree_stats(btas_stats *stats, const bitmap_mltree *tree, uint64_t output_bytes) {
+    if(stats == NULL) {
+        return;
+    }
+    stats->num_branches = tree->num_leaves;
+    stats->stem_length = (uint64_t)1 << tree->top_bits;
+    stats->stem_bytes = stats->stem_length * sizeof(uint8_t **) + tree->num_mids * ((uint64_t)1 << tree->mid_bits) * sizeof(uint8_t *);
+    stats->branch_bytes = tree->num_leaves * (((uint64_t)1 << tree->leaf_bits) >> 3);
+    stats->output_bytes = output_bytes;
+    stats->peak_bytes = bitmap_mltree_mem_bytes(tree) + output_bytes;
+}
+
+/**
+ *
+ * @brief Find out the unique integers of an array with a multi-level tree
+ *   of the default split (MLTREE_TOP_BITS / MLTREE_MID_BITS / MLTREE_LEAF_BITS).
+ *
+ * @param [in]
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the elements in the given array
+ *
+ * @param [out]
+ *  *num_elems_out is the number of the unique integers
+ *  *err_flag is for debugging errors
+ *  *stats receives the memory accounting if not NULL
+ *
+ * @returns
+ *  A pointer to the unique integers in input order, NULL if failed
+ */
+uint32_t* fui_bitmap_mltree(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) {
+    bitmap_mltree tree;
+    uint64_t j = 0;
+    uint32_t *final_output_arr = NULL;
+    int init_flag;
+    *err_flag = 0;
+    *num_elems_out = 0;
+    if(stats != NULL) {
+        memset(stats, 0, sizeof(btas_stats));
+    }
+    if(input_arr == NULL) {
+        *err_flag = -5;
+        return NULL;
+    }
+    if(num_elems < 1) {
+        *err_flag = -3;
+        return NULL;
+    }
+    if((init_flag = bitmap_mltree_init(&tree, MLTREE_TOP_BITS, MLTREE_MID_BITS, MLTREE_LEAF_BITS)) != 0) {
+        *err_flag = init_flag;
+        return NULL;
+    }
+    uint32_t *output_arr = (uint32_t *)calloc(num_elems, sizeof(uint32_t));
+    if(output_arr == NULL) {
+        bitmap_mltree_free(&tree);
+        *err_flag = -1;
+        return NULL;
+    }
+    j = bitmap_mltree_insert_arr(&tree, input_arr, num_elems, output_arr, err_flag);
+    mltree_stats(stats, &tree, num_elems * sizeof(uint32_t));
+    bitmap_mltree_free(&tree);
+    if(*err_flag != 0) {
+        free(output_arr);
+        return NULL;
+    }
+    final_output_arr = (uint32_t *)realloc(output_arr, j * sizeof(uint32_t));
+    if(final_output_arr == NULL) {
+        free(output_arr);
+        *err_flag = 3;
+        return NULL;
+    }
+    *num_elems_out = j;
+    return final_output_arr;
+}
+
+uint64_t fui_bitmap_mltree_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) {
+    bitmap_mltree tree;
+    uint64_t j = 0;
+    int init_flag;
+    *err_flag = 0;
+    if(stats != NULL) {
+        memset(stats, 0, sizeof(btas_stats));
+    }
+    if(input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    if(num_elems < 1) {
+        *err_flag = -3;
+        return 0;
+    }
+    if((init_flag = bitmap_mltree_init(&tree, MLTREE_TOP_BITS, MLTREE_MID_BITS, MLTREE_LEAF_BITS)) != 0) {
+        *err_flag = init_flag;
+        return 0;
+    }
+    j = bitmap_mltree_insert_arr(&tree, input_arr, num_elems, NULL, err_flag);
+    mltree_stats(stats, &tree, 0);
+    bitmap_mltree_free(&tree);
+    return (*err_flag != 0) ? 0 : j;
+}
@@ -0,0 +1,71 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+
+#ifndef BTAS_MLTREE_H_
+#define BTAS_MLTREE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "btas.h"
+
+/**
+ * Multi-level BitTree: a 32-bit integer is split into top / mid / leaf
+ * bits, e.g. 16/8/8 or 12/10/10. The top array is allocated at init; a mid
+ * node holds 2^mid_bits leaf pointers, and a leaf holds 2^leaf_bits bits.
+ * The 16/16 BitTree touches an 8 KiB branch per stem; with 16/8/8 a sparse
+ * input touches 32-byte leaves instead, for one more pointer hop per elem.
+ *
+ * Mid nodes and leaves are carved from zeroed slabs of MLTREE_SLAB_BYTES,
+ * so a small leaf costs no malloc header and the tree is freed in bulk.
+ *
+ * The split is per instance; MLTREE_*_BITS are the defaults used by the
+ * fui_* functions and the benchmark, and can be set at compile time.
+ */
+#ifndef MLTREE_TOP_BITS
+#define MLTREE_TOP_BITS     16
+#endif
+#ifndef MLTREE_MID_BITS
+#define MLTREE_MID_BITS     8
+#endif
+#ifndef MLTREE_LEAF_BITS
+#define MLTREE_LEAF_BITS    8
+#endif
+#define MLTREE_TOP_BITS_MAX 24      /* A 128 MiB top array */
+#define MLTREE_LEAF_BITS_MIN 6      /* An 8-byte leaf */
+#define MLTREE_SLAB_BYTES   65536
+
+typedef struct mltree_slab {
+    struct mltree_slab *next;
+    uint64_t used;          /* Bytes carved out of data */
+    uint64_t size;
+    uint8_t data[1];
+} mltree_slab;
+
+typedef struct {
+    uint8_t ***top;         /* 2^top_bits mid nodes, NULL - not touched */
+    uint32_t top_bits;
+    uint32_t mid_bits;
+    uint32_t leaf_bits;
+    uint64_t num_mids;
+    uint64_t num_leaves;
+    uint64_t num_elems;     /* Unique elems inserted */
+    mltree_slab *slabs;     /* The current slab first */
+    uint64_t slab_bytes;
+} bitmap_mltree;
+
+int bitmap_mltree_init(bitmap_mltree *tree, uint32_t top_bits, uint32_t mid_bits, uint32_t leaf_bits);
+void bitmap_mltree_free(bitmap_mltree *tree);
+uint64_t bitmap_mltree_insert_arr(bitmap_mltree *tree, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag);
+int bitmap_mltree_contains(const bitmap_mltree *tree, uint32_t elem);
+uint64_t bitmap_mltree_mem_bytes(const bitmap_mltree *tree);
+
+uint32_t* fui_bitmap_mltree(const uint32_t *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats);
+uint64_t fui_bitmap_mltree_count(const uint32_t *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
+
+#endif
@@ -0,0 +1,705 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define REGISTRY_PID ((unsigned long)getpid())
+#else
+#define REGISTRY_PID 0UL
+#endif
+#include "btas.h"
+#include "btas_registry.h"
+
+#define SPILL_MAGIC "BTSP"
+
+static uint64_t hash_name(const char *name, size_t name_len) {
+    uint64_t hash = 14695981039346656037ULL; /* FNV-1a */
+    for(size_t i = 0; i < name_len; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+#define STEM_TOP_BYTES  ((uint64_t)REGISTRY_STEM_TOP * sizeof(registry_branch *))
+#define STEM_LEAF_BYTES ((uint64_t)REGISTRY_STEM_LEAF * sizeof(registry_branch))
+
+static uint64_t set_mem(const btas_set *set) {
+    uint64_t stem_bytes = (set->num_stem_leaves != 0) ? STEM_TOP_BYTES + set->num_stem_leaves * STEM_LEAF_BYTES : 0;
+    return stem_bytes + (uint64_t)set->num_branches * BITMAP_BRANCH_SIZE;
+}
+
+/* The stem entry of h16, NULL if its leaf isn't allocated. */
+static registry_branch* stem_find(const btas_set *set, uint32_t h16) {
+    registry_branch *leaf = NULL;
+    if(set->stem == NULL || (leaf = set->stem[h16 >> 8]) == NULL) {
+        return NULL;
+    }
+    return leaf + (h16 & 0xFF);
+}
+
+/* Free the leaves and the top array. The counters are kept. */
+static void stem_free(btas_set *set) {
+    if(set->stem == NULL) {
+        return;
+    }
+    for(uint32_t i = 0; i < REGISTRY_STEM_TOP; i++) {
+        free(set->stem[i]);
+    }
+    free(set->stem);
+    set->stem = NULL;
+}
+
+static btas_set* registry_find(const btas_registry *reg, const char *name) {
+    size_t name_len = strlen(name);
+    uint64_t hash = hash_name(name, name_len);
+    btas_set *set = reg->buckets[hash & (reg->num_buckets - 1)];
+    for(; set != NULL; set = set->ptr_next) {
+        if(set->hash == hash && set->name_len == name_len && memcmp(set->name, name, name_len) == 0) {
+            return set;
+        }
+    }
+    return NULL;
+}
+
+static void registry_grow_buckets(btas_registry *reg) {
+    uint32_t new_size = reg->num_buckets * 2;
+    btas_set **new_buckets = (btas_set **)calloc(new_size, sizeof(btas_set *));
+    if(new_buckets == NULL) {
+        return; /* Keep the chains longer */
+    }
+    for(uint32_t i = 0; i < reg->num_buckets; i++) {
+        btas_set *set = reg->buckets[i], *next = NULL;
+        for(; set != NULL; set = next) {
+            next = set->ptr_next;
+            set->ptr_next = new_buckets[set->hash & (new_size - 1)];
+            new_buckets[set->hash & (new_size - 1)] = set;
+        }
+    }
+    free(reg->buckets);
+    reg->buckets = new_buckets;
+    reg->num_buckets = new_size;
+}
+
+/* Add an empty set. Its stem is allocated by the first insert. */
+static btas_set* registry_add(btas_registry *reg, const char *name) {
+    size_t name_len = strlen(name);
+    btas_set *set = (btas_set *)calloc(1, sizeof(btas_set));
+    if(set == NULL) {
+        return NULL;
+    }
+    if((set->name = (char *)malloc(name_len + 1)) == NULL) {
+        free(set);
+        return NULL;
+    }
+    memcpy(set->name, name, name_len + 1);
+    set->name_len = name_len;
+    set->hash = hash_name(name, name_len);
+    set->last_access = ++reg->clock;
+    if(reg->num_sets >= reg->num_buckets && reg->num_buckets < 0x80000000U) {
+        registry_grow_buckets(reg);
+    }
+    set->ptr_next = reg->buckets[set->hash & (reg->num_buckets - 1)];
+    reg->buckets[set->hash & (reg->num_buckets - 1)] = set;
+    reg->num_sets++;
+    return set;
+}
+
+/**
+ * @brief Take a zeroed branch from the pool, allocating a slab if no slab
+ *   has a free branch.
+ *
+ * @returns
+ *   0 if succeeded
+ *   1 if failed to allocate memory
+ */
+static int pool_get(btas_registry *reg, registry_branch *branch) {
+    registry_slab *slab = NULL;
+    uint32_t slab_id = 0, slot = 0;
+    if(reg->num_free_slab_ids == 0) {
+        if(reg->num_slabs == reg->slab_cap) {
+            uint32_t new_cap = (reg->slab_cap == 0) ? 16 : reg->slab_cap * 2;
+            registry_slab *tmp_slabs = (registry_slab *)realloc(reg->slabs, new_cap * sizeof(registry_slab));
+            if(tmp_slabs == NULL) {
+                return 1;
+            }
+            reg->slabs = tmp_slabs;
+            uint32_t *tmp_ids = (uint32_t *)realloc(reg->free_slab_ids, new_cap * sizeof(uint32_t));
+            if(tmp_ids == NULL) {
+                return 1;
+            }
+            reg->free_slab_ids = tmp_ids;
+            reg->slab_cap = new_cap;
+        }
+        reg->slabs[reg->num_slabs].mem = NULL;
+        reg->slabs[reg->num_slabs].used_mask = 0;
+        reg->free_slab_ids[reg->num_free_slab_ids++] = reg->num_slabs++;
+    }
+    slab_id = reg->free_slab_ids[reg->num_free_slab_ids - 1];
+    slab = reg->slabs + slab_id;
+    if(slab->mem == NULL) {
+        if((slab->mem = (uint8_t *)malloc((size_t)REGISTRY_SLAB_BRANCHES * BITMAP_BRANCH_SIZE)) == NULL) {
+            return 1;
+        }
+        reg->slab_bytes += (uint64_t)REGISTRY_SLAB_BRANCHES * BITMAP_BRANCH_SIZE;
+    }
+    else if(slab->used_mask == 0) {
+        reg->num_spare_slabs--;
+    }
+    while(slab->used_mask & (1U << slot)) {
+        slot++;
+    }
+    slab->used_mask |= (1U << slot);
+    if(slab->used_mask == 0xFFFFFFFFU) {
+        reg->num_free_slab_ids--;
+    }
+    branch->ptr_branch = slab->mem + (size_t)slot * BITMAP_BRANCH_SIZE;
+    branch->slab_id = slab_id;
+    memset(branch->ptr_branch, 0, BITMAP_BRANCH_SIZE);
+    return 0;
+}
+
+/* Return a branch to the pool. One empty slab is kept as a spare. */
+static void pool_put(btas_registry *reg, registry_branch *branch) {
+    registry_slab *slab = reg->slabs + branch->slab_id;
+    uint32_t slot = (uint32_t)((branch->ptr_branch - slab->mem) / BITMAP_BRANCH_SIZE);
+    if(slab->used_mask == 0xFFFFFFFFU) {
+        reg->free_slab_ids[reg->num_free_slab_ids++] = branch->slab_id;
+    }
+    slab->used_mask &= ~(1U << slot);
+    if(slab->used_mask == 0) {
+        if(reg->num_spare_slabs > 0) {
+            free(slab->mem);
+            slab->mem = NULL;
+            reg->slab_bytes -= (uint64_t)REGISTRY_SLAB_BRANCHES * BITMAP_BRANCH_SIZE;
+        }
+        else {
+            reg->num_spare_slabs++;
+        }
+    }
+    branch->ptr_branch = NULL;
+}
+
+/* Return the branches and the stem of an in-memory set. */
+static void set_release(btas_registry *reg, btas_set *set) {
+    if(set->stem == NULL) {
+        return;
+    }
+    for(uint32_t i = 0; i < REGISTRY_STEM_TOP; i++) {
+        for(uint32_t k = 0; set->stem[i] != NULL && k < REGISTRY_STEM_LEAF; k++) {
+            if(set->stem[i][k].ptr_branch != NULL) {
+                pool_put(reg, set->stem[i] + k);
+            }
+        }
+    }
+    reg->mem_used -= set_mem(set);
+    stem_free(set);
+}
+
+static void spill_path(const btas_registry *reg, uint64_t spill_id, char *path, size_t path_size) {
+    snprintf(path, path_size, "%s/btas_spill_%lu_%llu.bin", reg->spill_dir, REGISTRY_PID, (unsigned long long)spill_id);
+}
+
+/**
+ * @brief Write an in-memory set to the spill directory and release its
+ *   memory. The file holds the magic, the number of branches and elems,
+ *   then (h16, branch) for every branch.
+ *
+ * @returns
+ *   0 if succeeded
+ *   11 if failed to write the file
+ */
+static int set_spill(btas_registry *reg, btas_set *set) {
+    char path[4096];
+    uint64_t spill_id = ++reg->next_spill_id;
+    spill_path(reg, spill_id, path, sizeof(path));
+    FILE *file_p = fopen(path, "wb");
+    if(file_p == NULL) {
+        return 11;
+    }
+    int write_flag = (fwrite(SPILL_MAGIC, 1, 4, file_p) == 4 &&
+                      fwrite(&set->num_branches, sizeof(uint32_t), 1, file_p) == 1 &&
+                      fwrite(&set->num_elems, sizeof(uint64_t), 1, file_p) == 1);
+    for(uint32_t i = 0; i < BITMAP_LENGTH_MAX && write_flag; i++) {
+        registry_branch *branch = stem_find(set, i);
+        if(branch == NULL) {
+            i |= 0xFF;  /* Skip the missing leaf */
+            continue;
+        }
+        if(branch->ptr_branch == NULL) {
+            continue;
+        }
+        write_flag = (fwrite(&i, sizeof(uint32_t), 1, file_p) == 1 && fwrite(branch->ptr_branch, 1, BITMAP_BRANCH_SIZE, file_p) == BITMAP_BRANCH_SIZE);
+    }
+    if(fclose(file_p) != 0 || !write_flag) {
+        remove(path);
+        return 11;
+    }
+    reg->spill_bytes += 16 + (uint64_t)set->num_branches * (sizeof(uint32_t) + BITMAP_BRANCH_SIZE);
+    reg->num_spilled++;
+    set_release(reg, set);
+    set->spill_id = spill_id;
+    return 0;
+}
+
+/**
+ * @brief Make room for new_bytes under the global limit by spilling the
+ *   least recently used sets other than keep.
+ *
+ * @returns
+ *   0 if there is room
+ *   9 if the limit can't be met
+ *   11 if failed to spill a set
+ */
+static int registry_reserve(btas_registry *reg, uint64_t new_bytes, const btas_set *keep) {
+    while(reg->mem_limit != 0 && reg->mem_used + new_bytes > reg->mem_limit) {
+        btas_set *victim = NULL;
+        if(reg->spill_dir == NULL) {
+            return 9;
+        }
+        for(uint32_t i = 0; i < reg->num_buckets; i++) {
+            for(btas_set *set = reg->buckets[i]; set != NULL; set = set->ptr_next) {
+                if(set != keep && set->stem != NULL && (victim == NULL || set->last_access < victim->last_access)) {
+                    victim = set;
+                }
+            }
+        }
+        if(victim == NULL) {
+            return 9;
+        }
+        int spill_flag = set_spill(reg, victim);
+        if(spill_flag != 0) {
+            return spill_flag;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Allocate the stem leaf of h16 (and the top array) if missing.
+ *   With check_limits, the new bytes are checked against the per-set limit
+ *   and reserved under the global one first.
+ *
+ * @returns
+ *   0 if succeeded
+ *   7 if failed to allocate memory
+ *   9 if the memory limit can't be met
+ *   11 if failed to spill a set
+ */
+static int stem_grow(btas_registry *reg, btas_set *set, uint32_t h16, int check_limits) {
+    uint64_t new_bytes = STEM_LEAF_BYTES + ((set->num_stem_leaves == 0) ? STEM_TOP_BYTES : 0);
+    int grow_flag = 0;
+    if(set->stem != NULL && set->stem[h16 >> 8] != NULL) {
+        return 0;
+    }
+    if(check_limits) {
+        if(reg->set_mem_limit != 0 && set_mem(set) + new_bytes > reg->set_mem_limit) {
+            return 9;
+        }
+        if((grow_flag = registry_reserve(reg, new_bytes, set)) != 0) {
+            return grow_flag;
+        }
+    }
+    if(set->stem == NULL && (set->stem = (registry_branch **)calloc(REGISTRY_STEM_TOP, sizeof(registry_branch *))) == NULL) {
+        return 7;
+    }
+    if((set->stem[h16 >> 8] = (registry_branch *)calloc(REGISTRY_STEM_LEAF, sizeof(registry_branch))) == NULL) {
+        if(set->num_stem_leaves == 0) {
+            stem_free(set);
+        }
+        return 7;
+    }
+    set->num_stem_leaves++;
+    reg->mem_used += new_bytes;
+    return 0;
+}
+
+/**
+ * @brief Reload a spilled set.
+ *
+ * @returns
+ *   0 if succeeded
+ *   1 if failed to allocate memory
+ *   9 if the memory limit can't be met
+ *   11 if failed to read the file
+ */
+static int set_load(btas_registry *reg, btas_set *set) {
+    char path[4096], magic[4];
+    uint32_t num_branches = 0, num_stem_leaves = set->num_stem_leaves, h16 = 0;
+    uint64_t num_elems = 0;
+    registry_branch *branch = NULL;
+    int load_flag = registry_reserve(reg, set_mem(set), set);
+    if(load_flag != 0) {
+        return load_flag;
+    }
+    spill_path(reg, set->spill_id, path, sizeof(path));
+    FILE *file_p = fopen(path, "rb");
+    if(file_p == NULL) {
+        return 11;
+    }
+    if(fread(magic, 1, 4, file_p) != 4 || memcmp(magic, SPILL_MAGIC, 4) != 0 ||
+       fread(&num_branches, sizeof(uint32_t), 1, file_p) != 1 || fread(&num_elems, sizeof(uint64_t), 1, file_p) != 1 ||
+       num_branches != set->num_branches || num_elems != set->num_elems) {
+        fclose(file_p);
+        return 11;
+    }
+    set->num_branches = 0;
+    set->num_stem_leaves = 0;
+    for(uint32_t i = 0; i < num_branches && load_flag == 0; i++) {
+        if(fread(&h16, sizeof(uint32_t), 1, file_p) != 1 || h16 >= BITMAP_LENGTH_MAX) {
+            load_flag = 11;
+        }
+        else if(stem_grow(reg, set, h16, 0) != 0) {
+            load_flag = 1;
+        }
+        else if((branch = stem_find(set, h16))->ptr_branch != NULL) {
+            load_flag = 11;
+        }
+        else if(pool_get(reg, branch) != 0) {
+            load_flag = 1;
+        }
+        else {
+            set->num_branches++;
+            reg->mem_used += BITMAP_BRANCH_SIZE;
+            if(fread(branch->ptr_branch, 1, BITMAP_BRANCH_SIZE, file_p) != BITMAP_BRANCH_SIZE) {
+                load_flag = 11;
+            }
+        }
+    }
+    fclose(file_p);
+    if(load_flag != 0) {
+        /* Keep the file and the set spilled, so a later access can retry. */
+        set_release(reg, set);
+        set->num_branches = num_branches;
+        set->num_stem_leaves = num_stem_leaves;
+        return load_flag;
+    }
+    remove(path);
+    reg->spill_bytes -= 16 + (uint64_t)num_branches * (sizeof(uint32_t) + BITMAP_BRANCH_SIZE);
+    reg->num_spilled--;
+    set->spill_id = 0;
+    return 0;
+}
+
+/* Record an access, reloading the set if spilled. */
+static int set_touch(btas_registry *reg, btas_set *set) {
+    set->last_access = ++reg->clock;
+    return (set->spill_id != 0) ? set_load(reg, set) : 0;
+}
+
+/**
+ * @brief Initialize an empty registry.
+ *
+ * @param [in]
+ *  mem_limit bounds the stem and branch bytes of all the sets, 0 for no
+ *   limit
+ *  set_mem_limit bounds the stem and branch bytes of every set, 0 for no
+ *   limit
+ *  *spill_dir is an existing directory to spill the cold sets to, NULL to
+ *   fail the inserts exceeding mem_limit instead
+ *
+ * @returns
+ *  -5 if the registry pointer is null
+ *   5 if failed to allocate memory
+ *   0 if succeeded
+ */
+int btas_registry_init(btas_registry *reg, uint64_t mem_limit, uint64_t set_mem_limit, const char *spill_dir) {
+    if(reg == NULL) {
+        return -5;
+    }
+    memset(reg, 0, sizeof(btas_registry));
+    if((reg->buckets = (btas_set **)calloc(REGISTRY_INIT_BUCKETS, sizeof(btas_set *))) == NULL) {
+        return 5;
+    }
+    if(spill_dir != NULL) {
+        if((reg->spill_dir = (char *)malloc(strlen(spill_dir) + 1)) == NULL) {
+            free(reg->buckets);
+            reg->buckets = NULL;
+            return 5;
+        }
+        strcpy(reg->spill_dir, spill_dir);
+    }
+    reg->num_buckets = REGISTRY_INIT_BUCKETS;
+    reg->mem_limit = mem_limit;
+    reg->set_mem_limit = set_mem_limit;
+    pthread_mutex_init(&reg->lock, NULL);
+    return 0;
+}
+
+/* Free all the sets and remove their spill files. */
+void btas_registry_free(btas_registry *reg) {
+    char path[4096];
+    if(reg == NULL || reg->buckets == NULL) {
+        return;
+    }
+    for(uint32_t i = 0; i < reg->num_buckets; i++) {
+        btas_set *set = reg->buckets[i], *next = NULL;
+        for(; set != NULL; set = next) {
+            next = set->ptr_next;
+            if(set->spill_id != 0) {
+                spill_path(reg, set->spill_id, path, sizeof(path));
+                remove(path);
+            }
+            stem_free(set);
+            free(set->name);
+            free(set);
+        }
+    }
+    for(uint32_t i = 0; i < reg->num_slabs; i++) {
+        free(reg->slabs[i].mem);
+    }
+    free(reg->slabs);
+    free(reg->free_slab_ids);
+    free(reg->buckets);
+    free(reg->spill_dir);
+    pthread_mutex_destroy(&reg->lock);
+    memset(reg, 0, sizeof(btas_registry));
+}
+
+/**
+ *
+ * @brief Insert a block of integers to a named set, creating it if needed
+ *
+ * @param [in]
+ *  *reg is an initialized registry
+ *  *name is the name of the set
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the integer elems in the given array
+ *
+ * @param [out]
+ *  *output_arr receives the integers not recorded before, in the order of
+ *   the input. It must be able to hold num_elems integers. NULL to skip.
+ *  *err_flag is for debugging errors:
+ *   -5 null input, 1 branch allocation failed, 5 set creation failed,
+ *   7 stem allocation failed, 9 memory limit reached, 11 spill I/O failed
+ *
+ * @returns
+ *  The number of integers not recorded before. If an error occurred, the
+ *  integers inserted before the error are kept in the set.
+ *
+ */
+uint64_t btas_registry_insert(btas_registry *reg, const char *name, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag) {
+    uint64_t i, j = 0;
+    uint16_t h16 = 0, l16 = 0;
+    uint32_t tmp = 0;
+    registry_branch *branch = NULL;
+    btas_set *set = NULL;
+    *err_flag = 0;
+    if(reg == NULL || name == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    pthread_mutex_lock(&reg->lock);
+    if((set = registry_find(reg, name)) == NULL && (set = registry_add(reg, name)) == NULL) {
+        *err_flag = 5;
+        pthread_mutex_unlock(&reg->lock);
+        return 0;
+    }
+    if((*err_flag = set_touch(reg, set)) != 0) {
+        pthread_mutex_unlock(&reg->lock);
+        return 0;
+    }
+    for(i = 0; i < num_elems; i++) {
+        tmp = input_arr[i];
+        h16 = (uint16_t)(tmp >> 16);
+        l16 = (uint16_t)(tmp & 0xFFFF);
+        if((branch = stem_find(set, h16)) == NULL) {
+            if((*err_flag = stem_grow(reg, set, h16, 1)) != 0) {
+                break;
+            }
+            branch = stem_find(set, h16);
+        }
+        if(branch->ptr_branch == NULL) {
+            if(reg->set_mem_limit != 0 && set_mem(set) + BITMAP_BRANCH_SIZE > reg->set_mem_limit) {
+                *err_flag = 9;
+                break;
+            }
+            if((*err_flag = registry_reserve(reg, BITMAP_BRANCH_SIZE, set)) != 0) {
+                break;
+            }
+            if(pool_get(reg, branch) != 0) {
+                *err_flag = 1;
+                break;
+            }
+            set->num_branches++;
+            reg->mem_used += BITMAP_BRANCH_SIZE;
+        }
+        if(check_bit((branch->ptr_branch)[l16 >> 3], l16 & 0x07)) {
+            continue;
+        }
+        if(output_arr != NULL) {
+            output_arr[j] = tmp;
+        }
+        j++;
+        flip_bit((branch->ptr_branch)[l16 >> 3], l16 & 0x07);
+    }
+    set->num_elems += j;
+    pthread_mutex_unlock(&reg->lock);
+    return j;
+}
+
+/**
+ * @returns
+ *   1 if the set holds elem
+ *   0 if not, or if the set doesn't exist
+ *  -1 if failed to reload the spilled set (see *err_flag)
+ */
+int btas_registry_contains(btas_registry *reg, const char *name, uint32_t elem, int *err_flag) {
+    uint16_t h16 = (uint16_t)(elem >> 16), l16 = (uint16_t)(elem & 0xFFFF);
+    registry_branch *branch = NULL;
+    int found = 0;
+    *err_flag = 0;
+    if(reg == NULL || name == NULL) {
+        *err_flag = -5;
+        return -1;
+    }
+    pthread_mutex_lock(&reg->lock);
+    btas_set *set = registry_find(reg, name);
+    if(set != NULL && set->num_elems != 0) {
+        if((*err_flag = set_touch(reg, set)) != 0) {
+            found = -1;
+        }
+        else if((branch = stem_find(set, h16)) != NULL && branch->ptr_branch != NULL) {
+            found = check_bit((branch->ptr_branch)[l16 >> 3], l16 & 0x07) ? 1 : 0;
+        }
+    }
+    pthread_mutex_unlock(&reg->lock);
+    return found;
+}
+
+/**
+ * @returns
+ *  The number of integers in the set (spilled sets aren't reloaded), or -1
+ *  if the set doesn't exist
+ */
+int64_t btas_registry_count(btas_registry *reg, const char *name) {
+    int64_t count = -1;
+    if(reg == NULL || name == NULL) {
+        return -1;
+    }
+    pthread_mutex_lock(&reg->lock);
+    btas_set *set = registry_find(reg, name);
+    if(set != NULL) {
+        count = (int64_t)set->num_elems;
+    }
+    pthread_mutex_unlock(&reg->lock);
+    return count;
+}
+
+/**
+ * @returns
+ *  -5 if the input is null
+ *   0 if created
+ *   1 if the set exists already
+ *   5 if failed to allocate memory
+ */
+int btas_registry_create(btas_registry *reg, const char *name) {
+    int create_flag = 0;
+    if(reg == NULL || name == NULL) {
+        return -5;
+    }
+    pthread_mutex_lock(&reg->lock);
+    if(registry_find(reg, name) != NULL) {
+        create_flag = 1;
+    }
+    else if(registry_add(reg, name) == NULL) {
+        create_flag = 5;
+    }
+    pthread_mutex_unlock(&reg->lock);
+    return create_flag;
+}
+
+/**
+ * @returns
+ *  -5 if the input is null
+ *   0 if deleted
+ *   1 if the set doesn't exist
+ */
+int btas_registry_delete(btas_registry *reg, const char *name) {
+    char path[4096];
+    if(reg == NULL || name == NULL) {
+        return -5;
+    }
+    pthread_mutex_lock(&reg->lock);
+    size_t name_len = strlen(name);
+    uint64_t hash = hash_name(name, name_len);
+    btas_set **link = &reg->buckets[hash & (reg->num_buckets - 1)];
+    for(; *link != NULL; link = &(*link)->ptr_next) {
+        btas_set *set = *link;
+        if(set->hash != hash || set->name_len != name_len || memcmp(set->name, name, name_len) != 0) {
+            continue;
+        }
+        *link = set->ptr_next;
+        if(set->spill_id != 0) {
+            spill_path(reg, set->spill_id, path, sizeof(path));
+            remove(path);
+            reg->spill_bytes -= 16 + (uint64_t)set->num_branches * (sizeof(uint32_t) + BITMAP_BRANCH_SIZE);
+            reg->num_spilled--;
+        }
+        set_release(reg, set);
+        free(set->name);
+        free(set);
+        reg->num_sets--;
+        pthread_mutex_unlock(&reg->lock);
+        return 0;
+    }
+    pthread_mutex_unlock(&reg->lock);
+    return 1;
+}
+
+/**
+ * @brief Spill a set now, e.g. when it's known to be cold.
+ *
+ * @returns
+ *  -5 if the input is null
+ *   0 if spilled (or already spilled or empty)
+ *   1 if the set doesn't exist
+ *   3 if the registry has no spill directory
+ *   11 if failed to write the file
+ */
+int btas_registry_spill(btas_registry *reg, const char *name) {
+    int spill_flag = 0;
+    if(reg == NULL || name == NULL) {
+        return -5;
+    }
+    pthread_mutex_lock(&reg->lock);
+    btas_set *set = registry_find(reg, name);
+    if(set == NULL) {
+        spill_flag = 1;
+    }
+    else if(reg->spill_dir == NULL) {
+        spill_flag = 3;
+    }
+    else if(set->stem != NULL) {
+        spill_flag = set_spill(reg, set);
+    }
+    pthread_mutex_unlock(&reg->lock);
+    return spill_flag;
+}
+
+void btas_registry_get_stats(btas_registry *reg, btas_registry_stats *stats) {
+    if(reg == NULL || stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(btas_registry_stats));
+    pthread_mutex_lock(&reg->lock);
+    for(uint32_t i = 0; i < reg->num_buckets; i++) {
+        for(btas_set *set = reg->buckets[i]; set != NULL; set = set->ptr_next) {
+            stats->num_elems += set->num_elems;
+            stats->num_branches += (set->stem != NULL) ? set->num_branches : 0;
+        }
+    }
+    stats->num_sets = reg->num_sets;
+    stats->num_spilled = reg->num_spilled;
+    stats->mem_used = reg->mem_used;
+    stats->slab_bytes = reg->slab_bytes;
+    stats->spill_bytes = reg->spill_bytes;
+    pthread_mutex_unlock(&reg->lock);
+}
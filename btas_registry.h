@@ -0,0 +1,105 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+
+#ifndef BTAS_REGISTRY_H_
+#define BTAS_REGISTRY_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * A registry of named BitTree sets for services holding many sets (per
+ * customer, per day, ...).
+ *
+ * - All the sets draw their 8 KiB branches from one pool of slabs, and an
+ *   empty slab is released unless it's the last spare one, so the memory
+ *   follows the data, not the number of sets.
+ * - A set costs a few dozen bytes until its first insert allocates a
+ *   stem. The stem has two levels indexed by the high and the low byte of
+ *   h16: a top array of 256 pointers (2 KiB), and a 4 KiB leaf for every
+ *   256 branches in use, so a sparse set costs a few KiB wherever its
+ *   values are.
+ * - A global and a per-set limit bound the branch and stem bytes. When
+ *   the global limit is reached, the least recently used sets are spilled
+ *   to spill_dir (if set) and reloaded transparently on their next access.
+ *
+ * All the functions lock the registry, so it can be shared by threads.
+ */
+#define REGISTRY_SLAB_BRANCHES  32      /* Branches per slab (256 KiB) */
+#define REGISTRY_INIT_BUCKETS   256
+#define REGISTRY_STEM_TOP       256     /* Leaves per stem */
+#define REGISTRY_STEM_LEAF      256     /* Branches per stem leaf */
+
+typedef struct {
+    uint8_t *ptr_branch;
+    uint32_t slab_id;
+} registry_branch;
+
+typedef struct btas_set_struct {
+    char *name;
+    size_t name_len;
+    uint64_t hash;
+    registry_branch **stem;     /* NULL until the first insert or spilled */
+    uint32_t num_stem_leaves;
+    uint32_t num_branches;
+    uint64_t num_elems;
+    uint64_t last_access;       /* Registry clock of the last access */
+    uint64_t spill_id;          /* 0 - in memory */
+    struct btas_set_struct *ptr_next;
+} btas_set;
+
+typedef struct {
+    uint8_t *mem;               /* NULL - a released slab */
+    uint32_t used_mask;         /* Bit i - branch i is in use */
+} registry_slab;
+
+typedef struct {
+    btas_set **buckets;
+    uint32_t num_buckets;
+    uint64_t num_sets;
+    registry_slab *slabs;
+    uint32_t num_slabs;
+    uint32_t slab_cap;
+    uint32_t *free_slab_ids;    /* Slabs with a free branch (or released) */
+    uint32_t num_free_slab_ids;
+    uint32_t num_spare_slabs;   /* Empty slabs still allocated */
+    uint64_t mem_limit;         /* Global, 0 - unlimited */
+    uint64_t set_mem_limit;     /* Per set, 0 - unlimited */
+    uint64_t mem_used;          /* Stems and branches in use */
+    uint64_t slab_bytes;        /* Allocated slabs */
+    uint64_t clock;
+    uint64_t next_spill_id;
+    uint64_t num_spilled;
+    uint64_t spill_bytes;
+    char *spill_dir;
+    pthread_mutex_t lock;
+} btas_registry;
+
+typedef struct {
+    uint64_t num_sets;
+    uint64_t num_spilled;
+    uint64_t num_elems;         /* Total of all the sets */
+    uint64_t num_branches;      /* In memory */
+    uint64_t mem_used;          /* Stems and branches in use */
+    uint64_t slab_bytes;        /* Allocated for branches, in use or spare */
+    uint64_t spill_bytes;       /* On disk */
+} btas_registry_stats;
+
+int btas_registry_init(btas_registry *reg, uint64_t mem_limit, uint64_t set_mem_limit, const char *spill_dir);
+void btas_registry_free(btas_registry *reg);
+uint64_t btas_registry_insert(btas_registry *reg, const char *name, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag);
+int btas_registry_contains(btas_registry *reg, const char *name, uint32_t elem, int *err_flag);
+int64_t btas_registry_count(btas_registry *reg, const char *name);
+int btas_registry_create(btas_registry *reg, const char *name);
+int btas_registry_delete(btas_registry *reg, const char *name);
+int btas_registry_spill(btas_registry *reg, const char *name);
+void btas_registry_get_stats(btas_registry *reg, btas_registry_stats *stats);
+
+#endif
@@ -0,0 +1,358 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define BTAS_SHM_SUPPORTED
+#endif
+#include "btas.h"
+#include "btas_shm.h"
+
+#define SHM_MAGIC       "BTSM"
+#define SHM_MAP_SIZE    ((uint64_t)SHM_BRANCH_OFFSET + (uint64_t)BITMAP_LENGTH_MAX * BITMAP_BRANCH_SIZE)
+
+typedef struct {
+    uint32_t magic;         /* SHM_MAGIC, published last with a release store */
+    uint32_t version;
+    uint64_t map_size;
+    uint64_t num_elems;
+    uint32_t num_branches;
+    uint32_t reserved;
+} shm_header;
+
+#ifdef BTAS_SHM_SUPPORTED
+
+/**
+ * Open a named object. On Linux the POSIX shared memory objects are the
+ * files of /dev/shm, which avoids linking librt for shm_open.
+ */
+static int shm_open_name(const char *name, int flags, mode_t mode) {
+#if defined(__linux__)
+    char path[256];
+    while(*name == '/') {
+        name++;
+    }
+    if(*name == '\0' || strchr(name, '/') != NULL || snprintf(path, sizeof(path), "/dev/shm/%s", name) >= (int)sizeof(path)) {
+        return -1;
+    }
+    return open(path, flags | O_CLOEXEC, mode);
+#else
+    return shm_open(name, flags, mode);
+#endif
+}
+
+static shm_header* shm_get_header(const bitmap_shm *shm) {
+    return (shm_header *)shm->base;
+}
+
+static uint32_t shm_magic_word(void) {
+    uint32_t magic;
+    memcpy(&magic, SHM_MAGIC, 4);
+    return magic;
+}
+
+/**
+ * ftruncate reserves no space on tmpfs: a store to a page that can't be
+ * backed (e.g. /dev/shm full) raises SIGBUS. Allocating a range before
+ * the first store to it turns that into an error.
+ */
+static int shm_reserve(int fd, uint64_t offset, uint64_t length) {
+#if defined(__linux__)
+    return (posix_fallocate(fd, (off_t)offset, (off_t)length) == 0) ? 0 : -1;
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+    return 0;
+#endif
+}
+
+/**
+ * @brief Create an empty shared BitTree and map it for writing.
+ *
+ * @param [in]
+ *  *name is the name of a new POSIX shared memory object (e.g. "/seen"),
+ *   or NULL for an anonymous memfd, shared through shm->fd (fork, or
+ *   SCM_RIGHTS, or /proc/<pid>/fd/<fd>)
+ *
+ * @returns
+ *  -5 if the shm pointer is null
+ *   3 if shared memory isn't supported on this platform
+ *   9 if failed to create the object (e.g. the name exists)
+ *   5 if failed to size or map it
+ *   0 if succeeded
+ */
+int bitmap_shm_create(bitmap_shm *shm, const char *name) {
+    if(shm == NULL) {
+        return -5;
+    }
+    memset(shm, 0, sizeof(bitmap_shm));
+    shm->fd = -1;
+    if(name != NULL) {
+        shm->fd = shm_open_name(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    }
+    else {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+        shm->fd = memfd_create("btas_shm", MFD_CLOEXEC);
+#endif
+    }
+    if(shm->fd < 0) {
+        return 9;
+    }
+    if(ftruncate(shm->fd, (off_t)SHM_MAP_SIZE) != 0 || shm_reserve(shm->fd, 0, SHM_BRANCH_OFFSET) != 0) {
+        close(shm->fd);
+        if(name != NULL) {
+            bitmap_shm_unlink(name);
+        }
+        return 5;
+    }
+    void *base = mmap(NULL, (size_t)SHM_MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+    if(base == MAP_FAILED) {
+        close(shm->fd);
+        if(name != NULL) {
+            bitmap_shm_unlink(name);
+        }
+        return 5;
+    }
+    shm->base = (uint8_t *)base;
+    shm->map_size = SHM_MAP_SIZE;
+    shm->writable = 1;
+    shm_header *header = shm_get_header(shm);
+    header->version = SHM_VERSION;
+    header->map_size = SHM_MAP_SIZE;
+    /* The magic goes last, so a reader never accepts a half-made header. */
+    __atomic_store_n(&header->magic, shm_magic_word(), __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * @brief Map an existing shared BitTree read-only.
+ *
+ * @param [in]
+ *  *name is the name of the object, or NULL to map fd instead
+ *  fd is a file descriptor of the object (used if name is NULL). It's
+ *   duplicated, so the caller may close it.
+ *
+ * @returns
+ *  -5 if the shm pointer is null
+ *   3 if shared memory isn't supported on this platform
+ *   9 if failed to open the object
+ *   5 if failed to map it
+ *   11 if it isn't a shared BitTree
+ *   0 if succeeded
+ */
+int bitmap_shm_open(bitmap_shm *shm, const char *name, int fd) {
+    struct stat shm_stat;
+    if(shm == NULL) {
+        return -5;
+    }
+    memset(shm, 0, sizeof(bitmap_shm));
+    shm->fd = (name != NULL) ? shm_open_name(name, O_RDONLY, 0) : ((fd >= 0) ? fcntl(fd, F_DUPFD_CLOEXEC, 0) : -1);
+    if(shm->fd < 0) {
+        return 9;
+    }
+    if(fstat(shm->fd, &shm_stat) != 0 || (uint64_t)shm_stat.st_size < SHM_BRANCH_OFFSET) {
+        close(shm->fd);
+        return 11;
+    }
+    void *base = mmap(NULL, (size_t)shm_stat.st_size, PROT_READ, MAP_SHARED, shm->fd, 0);
+    if(base == MAP_FAILED) {
+        close(shm->fd);
+        return 5;
+    }
+    shm->base = (uint8_t *)base;
+    shm->map_size = (uint64_t)shm_stat.st_size;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    const shm_header *header = shm_get_header(shm);
+    if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != shm_magic_word() || header->version != SHM_VERSION || header->map_size != shm->map_size || shm->map_size != SHM_MAP_SIZE) {
+        bitmap_shm_close(shm);
+        return 11;
+    }
+    return 0;
+}
+
+void bitmap_shm_close(bitmap_shm *shm) {
+    if(shm == NULL || shm->base == NULL) {
+        return;
+    }
+    munmap(shm->base, (size_t)shm->map_size);
+    close(shm->fd);
+    shm->base = NULL;
+    shm->fd = -1;
+    shm->map_size = 0;
+    shm->writable = 0;
+}
+
+/* Remove a named object. The mappings stay valid until closed. */
+int bitmap_shm_unlink(const char *name) {
+    if(name == NULL) {
+        return -5;
+    }
+#if defined(__linux__)
+    char path[256];
+    while(*name == '/') {
+        name++;
+    }
+    if(snprintf(path, sizeof(path), "/dev/shm/%s", name) >= (int)sizeof(path)) {
+        return 9;
+    }
+    return (unlink(path) == 0) ? 0 : 9;
+#else
+    return (shm_unlink(name) == 0) ? 0 : 9;
+#endif
+}
+
+/**
+ *
+ * @brief Insert a block of integers to a shared BitTree (writer only)
+ *
+ * @param [in]
+ *  *shm is a shared BitTree created by bitmap_shm_create()
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the integer elems in the given array
+ *
+ * @param [out]
+ *  *output_arr receives the integers not recorded before, in the order of
+ *   the input. It must be able to hold num_elems integers. NULL to skip.
+ *  *err_flag is -5 for null input, 3 if the tree is mapped read-only, 9 if
+ *   the shared memory is full (the integers before are kept)
+ *
+ * @returns
+ *  The number of integers not recorded before.
+ *
+ */
+uint64_t bitmap_shm_insert_arr(bitmap_shm *shm, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag) {
+    uint64_t i, j = 0;
+    uint32_t tmp = 0, new_branches = 0;
+    uint16_t h16 = 0, l16 = 0;
+    uint8_t tmp_byte = 0;
+    *err_flag = 0;
+    if(shm == NULL || shm->base == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    if(!shm->writable) {
+        *err_flag = 3;
+        return 0;
+    }
+    shm_header *header = shm_get_header(shm);
+    uint8_t *present = shm->base + SHM_PRESENT_OFFSET;
+    for(i = 0; i < num_elems; i++) {
+        tmp = input_arr[i];
+        h16 = (uint16_t)(tmp >> 16);
+        l16 = (uint16_t)(tmp & 0xFFFF);
+        uint8_t *byte_p = shm->base + SHM_BRANCH_OFFSET + (size_t)h16 * BITMAP_BRANCH_SIZE + (l16 >> 3);
+        /* Only this process writes, so plain load-then-store is enough. */
+        uint8_t present_byte = __atomic_load_n(present + (h16 >> 3), __ATOMIC_RELAXED);
+        int is_new_branch = !check_bit(present_byte, h16 & 0x07);
+        if(is_new_branch && shm_reserve(shm->fd, SHM_BRANCH_OFFSET + (uint64_t)h16 * BITMAP_BRANCH_SIZE, BITMAP_BRANCH_SIZE) != 0) {
+            *err_flag = 9;
+            break;
+        }
+        tmp_byte = __atomic_load_n(byte_p, __ATOMIC_RELAXED);
+        if(check_bit(tmp_byte, l16 & 0x07)) {
+            continue;
+        }
+        __atomic_store_n(byte_p, (uint8_t)flip_bit(tmp_byte, l16 & 0x07), __ATOMIC_RELAXED);
+        if(is_new_branch) {
+            __atomic_store_n(present + (h16 >> 3), (uint8_t)flip_bit(present_byte, h16 & 0x07), __ATOMIC_RELEASE);
+            new_branches++;
+        }
+        if(output_arr != NULL) {
+            output_arr[j] = tmp;
+        }
+        j++;
+    }
+    __atomic_store_n(&header->num_branches, header->num_branches + new_branches, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->num_elems, header->num_elems + j, __ATOMIC_RELEASE);
+    return j;
+}
+
+int bitmap_shm_contains(const bitmap_shm *shm, uint32_t elem) {
+    uint16_t h16 = (uint16_t)(elem >> 16), l16 = (uint16_t)(elem & 0xFFFF);
+    if(shm == NULL || shm->base == NULL) {
+        return 0;
+    }
+    /* Skip the absent branches, so a lookup never faults in a hole. */
+    if(!check_bit(__atomic_load_n(shm->base + SHM_PRESENT_OFFSET + (h16 >> 3), __ATOMIC_ACQUIRE), h16 & 0x07)) {
+        return 0;
+    }
+    const uint8_t *byte_p = shm->base + SHM_BRANCH_OFFSET + (size_t)h16 * BITMAP_BRANCH_SIZE + (l16 >> 3);
+    return check_bit(__atomic_load_n(byte_p, __ATOMIC_RELAXED), l16 & 0x07) ? 1 : 0;
+}
+
+uint64_t bitmap_shm_count(const bitmap_shm *shm) {
+    if(shm == NULL || shm->base == NULL) {
+        return 0;
+    }
+    return __atomic_load_n(&shm_get_header(shm)->num_elems, __ATOMIC_ACQUIRE);
+}
+
+uint32_t bitmap_shm_num_branches(const bitmap_shm *shm) {
+    if(shm == NULL || shm->base == NULL) {
+        return 0;
+    }
+    return __atomic_load_n(&shm_get_header(shm)->num_branches, __ATOMIC_ACQUIRE);
+}
+
+#else
+
+int bitmap_shm_create(bitmap_shm *shm, const char *name) {
+    (void)name;
+    return (shm == NULL) ? -5 : 3;
+}
+
+int bitmap_shm_open(bitmap_shm *shm, const char *name, int fd) {
+    (void)name;
+    (void)fd;
+    return (shm == NULL) ? -5 : 3;
+}
+
+void bitmap_shm_close(bitmap_shm *shm) {
+    (void)shm;
+}
+
+int bitmap_shm_unlink(const char *name) {
+    return (name == NULL) ? -5 : 3;
+}
+
+uint64_t bitmap_shm_insert_arr(bitmap_shm *shm, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag) {
+    (void)shm;
+    (void)input_arr;
+    (void)num_elems;
+    (void)output_arr;
+    *err_flag = 3;
+    return 0;
+}
+
+int bitmap_shm_contains(const bitmap_shm *shm, uint32_t elem) {
+    (void)shm;
+    (void)elem;
+    return 0;
+}
+
+uint64_t bitmap_shm_count(const bitmap_shm *shm) {
+    (void)shm;
+    return 0;
+}
+
+uint32_t bitmap_shm_num_branches(const bitmap_shm *shm) {
+    (void)shm;
+    return 0;
+}
+
+#endif
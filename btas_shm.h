@@ -0,0 +1,60 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+
+#ifndef BTAS_SHM_H_
+#define BTAS_SHM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * A BitTree in a shared memory region (a memfd, or a named POSIX shared
+ * memory object), so one writer process inserts and many reader processes
+ * map it read-only and query it without copies.
+ *
+ * The region holds no pointers. The branch of h16 always lives at
+ * SHM_BRANCH_OFFSET + h16 * BITMAP_BRANCH_SIZE, and the region is sized
+ * for all the 65536 branches; the memory (tmpfs) pages of a branch are
+ * only allocated (fallocate) when the writer first touches it, so a full
+ * /dev/shm fails the insert instead of killing the writer with SIGBUS.
+ * A presence bitmap tells which branches
+ * exist, so the readers never fault in the holes.
+ *
+ * Publication: a branch starts zeroed, the writer sets the bits of the
+ * elems with atomic stores, then publishes the presence bit and the
+ * counters with release stores, which the readers load with acquire. A
+ * reader racing with an insert sees every elem either in or not yet in.
+ *
+ * Layout (offsets in bytes):
+ *   0      header: "BTSM" | version (u32) | map_size (u64) |
+ *                  num_elems (u64) | num_branches (u32) | reserved (u32)
+ *   4096   presence bitmap, 1 bit per branch (8 KiB)
+ *   16384  branches
+ */
+#define SHM_VERSION         1
+#define SHM_PRESENT_OFFSET  4096
+#define SHM_BRANCH_OFFSET   16384
+
+typedef struct {
+    int fd;
+    uint8_t *base;
+    uint64_t map_size;
+    int writable;
+} bitmap_shm;
+
+int bitmap_shm_create(bitmap_shm *shm, const char *name);
+int bitmap_shm_open(bitmap_shm *shm, const char *name, int fd);
+void bitmap_shm_close(bitmap_shm *shm);
+int bitmap_shm_unlink(const char *name);
+uint64_t bitmap_shm_insert_arr(bitmap_shm *shm, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag);
+int bitmap_shm_contains(const bitmap_shm *shm, uint32_t elem);
+uint64_t bitmap_shm_count(const bitmap_shm *shm);
+uint32_t bitmap_shm_num_branches(const bitmap_shm *shm);
+
+#endif
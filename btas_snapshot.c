@@ -0,0 +1,313 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "btas.h"
+#include "btas_snapshot.h"
+
+/* The latest epoch a live snapshot sees, 0 if there's no live snapshot. */
+static uint64_t max_live_epoch(const bitmap_vtree *tree) {
+    uint64_t max_epoch = 0;
+    for(uint32_t i = 0; i < tree->num_live; i++) {
+        max_epoch = (tree->live_epochs[i] > max_epoch) ? tree->live_epochs[i] : max_epoch;
+    }
+    return max_epoch;
+}
+
+/* Free the retired branches no live snapshot can see. The caller locks. */
+static void vtree_reclaim(bitmap_vtree *tree) {
+    uint64_t i, j = 0;
+    for(i = 0; i < tree->num_retired; i++) {
+        vtree_retired *old = tree->retired + i;
+        int is_visible = 0;
+        for(uint32_t k = 0; k < tree->num_live && !is_visible; k++) {
+            is_visible = (tree->live_epochs[k] >= old->created && tree->live_epochs[k] < old->retired);
+        }
+        if(is_visible) {
+            tree->retired[j++] = *old;
+        }
+        else {
+            free(old->ptr_branch);
+        }
+    }
+    tree->num_retired = j;
+}
+
+/**
+ * @brief Initialize an empty versioned BitTree
+ *
+ * @returns
+ *  -5 if the tree pointer is null
+ *   5 if failed to allocate the stem
+ *   0 if succeeded
+ */
+int bitmap_vtree_init(bitmap_vtree *tree) {
+    if(tree == NULL) {
+        return -5;
+    }
+    memset(tree, 0, sizeof(bitmap_vtree));
+    if((tree->stem = (vtree_branch *)calloc(BITMAP_INIT_LENGTH, sizeof(vtree_branch))) == NULL) {
+        return 5;
+    }
+    tree->stem_size = BITMAP_INIT_LENGTH;
+    tree->epoch = 1;
+    pthread_mutex_init(&tree->lock, NULL);
+    return 0;
+}
+
+/* Free the tree. All its snapshots must have been released. */
+void bitmap_vtree_free(bitmap_vtree *tree) {
+    if(tree == NULL || tree->stem == NULL) {
+        return;
+    }
+    for(uint32_t i = 0; i < tree->stem_size; i++) {
+        free(tree->stem[i].ptr_branch);
+    }
+    for(uint64_t i = 0; i < tree->num_retired; i++) {
+        free(tree->retired[i].ptr_branch);
+    }
+    free(tree->stem);
+    free(tree->retired);
+    free(tree->live_epochs);
+    pthread_mutex_destroy(&tree->lock);
+    memset(tree, 0, sizeof(bitmap_vtree));
+}
+
+/**
+ *
+ * @brief Insert a block of integers to a versioned BitTree
+ *
+ * @param [in]
+ *  *tree is an initialized versioned BitTree
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the integer elems in the given array
+ *
+ * @param [out]
+ *  *output_arr receives the integers not recorded before, in the order of
+ *   the input. It must be able to hold num_elems integers. NULL to skip.
+ *  *err_flag is for debugging errors: -5 null input, 1 branch allocation
+ *   (or copy) failed, 7 stem realloc failed
+ *
+ * @returns
+ *  The number of integers not recorded before. If an error occurred, the
+ *  integers inserted before the error are kept in the tree.
+ *
+ */
+uint64_t bitmap_vtree_insert_arr(bitmap_vtree *tree, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag) {
+    uint64_t i, j = 0;
+    uint16_t h16 = 0, l16 = 0;
+    uint32_t tmp = 0, stem_size_target = 0;
+    vtree_branch *tmp_stem_realloc = NULL;
+    *err_flag = 0;
+    if(tree == NULL || tree->stem == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    pthread_mutex_lock(&tree->lock);
+    uint64_t frozen_epoch = max_live_epoch(tree);
+    for(i = 0; i < num_elems; i++) {
+        tmp = input_arr[i];
+        h16 = (uint16_t)(tmp >> 16);
+        l16 = (uint16_t)(tmp & 0xFFFF);
+        if((uint32_t)(h16 + 1) > tree->stem_size) {
+            stem_size_target = (((h16 + 1) << 1) > BITMAP_LENGTH_MAX) ? BITMAP_LENGTH_MAX : ((h16 + 1) << 1);
+            if((tmp_stem_realloc = (vtree_branch *)realloc(tree->stem, stem_size_target * sizeof(vtree_branch))) == NULL) {
+                *err_flag = 7;
+                break;
+            }
+            memset(tmp_stem_realloc + tree->stem_size, 0, (stem_size_target - tree->stem_size) * sizeof(vtree_branch));
+            tree->stem = tmp_stem_realloc;
+            tree->stem_size = stem_size_target;
+        }
+        vtree_branch *branch = tree->stem + h16;
+        if(branch->ptr_branch == NULL) {
+            if((branch->ptr_branch = (uint8_t *)calloc(BITMAP_BRANCH_SIZE, sizeof(uint8_t))) == NULL) {
+                *err_flag = 1;
+                break;
+            }
+            branch->epoch = tree->epoch;
+            tree->num_branches++;
+        }
+        if(check_bit((branch->ptr_branch)[l16 >> 3], l16 & 0x07)) {
+            continue;
+        }
+        if(branch->epoch <= frozen_epoch) {
+            /* A live snapshot sees this branch: change a copy of it. */
+            uint8_t *branch_copy = (uint8_t *)malloc(BITMAP_BRANCH_SIZE);
+            if(branch_copy == NULL) {
+                *err_flag = 1;
+                break;
+            }
+            if(tree->num_retired == tree->retired_cap) {
+                uint64_t new_cap = (tree->retired_cap == 0) ? 64 : tree->retired_cap * 2;
+                vtree_retired *tmp_retired = (vtree_retired *)realloc(tree->retired, new_cap * sizeof(vtree_retired));
+                if(tmp_retired == NULL) {
+                    free(branch_copy);
+                    *err_flag = 1;
+                    break;
+                }
+                tree->retired = tmp_retired;
+                tree->retired_cap = new_cap;
+            }
+            memcpy(branch_copy, branch->ptr_branch, BITMAP_BRANCH_SIZE);
+            tree->retired[tree->num_retired].ptr_branch = branch->ptr_branch;
+            tree->retired[tree->num_retired].created = branch->epoch;
+            tree->retired[tree->num_retired].retired = tree->epoch;
+            tree->num_retired++;
+            branch->ptr_branch = branch_copy;
+            branch->epoch = tree->epoch;
+        }
+        if(output_arr != NULL) {
+            output_arr[j] = tmp;
+        }
+        j++;
+        flip_bit((branch->ptr_branch)[l16 >> 3], l16 & 0x07);
+    }
+    tree->num_elems += j;
+    pthread_mutex_unlock(&tree->lock);
+    return j;
+}
+
+/**
+ * @brief Take a consistent snapshot of the tree (the inserts completed
+ *   before it). Release it with bitmap_snapshot_release().
+ *
+ * @returns
+ *  -5 if the input is null
+ *   5 if failed to allocate memory
+ *   0 if succeeded
+ */
+int bitmap_vtree_snapshot(bitmap_vtree *tree, bitmap_snapshot *snap) {
+    if(tree == NULL || snap == NULL) {
+        return -5;
+    }
+    memset(snap, 0, sizeof(bitmap_snapshot));
+    pthread_mutex_lock(&tree->lock);
+    if(tree->num_live == tree->live_cap) {
+        uint32_t new_cap = (tree->live_cap == 0) ? 8 : tree->live_cap * 2;
+        uint64_t *tmp_live = (uint64_t *)realloc(tree->live_epochs, new_cap * sizeof(uint64_t));
+        if(tmp_live == NULL) {
+            pthread_mutex_unlock(&tree->lock);
+            return 5;
+        }
+        tree->live_epochs = tmp_live;
+        tree->live_cap = new_cap;
+    }
+    if((snap->branches = (uint8_t **)malloc(tree->stem_size * sizeof(uint8_t *))) == NULL) {
+        pthread_mutex_unlock(&tree->lock);
+        return 5;
+    }
+    for(uint32_t i = 0; i < tree->stem_size; i++) {
+        snap->branches[i] = tree->stem[i].ptr_branch;
+    }
+    snap->tree = tree;
+    snap->epoch = tree->epoch;
+    snap->stem_size = tree->stem_size;
+    snap->num_branches = tree->num_branches;
+    snap->num_elems = tree->num_elems;
+    tree->live_epochs[tree->num_live++] = tree->epoch;
+    tree->epoch++;
+    pthread_mutex_unlock(&tree->lock);
+    return 0;
+}
+
+void bitmap_snapshot_release(bitmap_snapshot *snap) {
+    if(snap == NULL || snap->tree == NULL) {
+        return;
+    }
+    bitmap_vtree *tree = snap->tree;
+    pthread_mutex_lock(&tree->lock);
+    for(uint32_t i = 0; i < tree->num_live; i++) {
+        if(tree->live_epochs[i] == snap->epoch) {
+            tree->live_epochs[i] = tree->live_epochs[--tree->num_live];
+            break;
+        }
+    }
+    vtree_reclaim(tree);
+    pthread_mutex_unlock(&tree->lock);
+    free(snap->branches);
+    memset(snap, 0, sizeof(bitmap_snapshot));
+}
+
+int bitmap_snapshot_contains(const bitmap_snapshot *snap, uint32_t elem) {
+    uint16_t h16 = (uint16_t)(elem >> 16), l16 = (uint16_t)(elem & 0xFFFF);
+    if(snap == NULL || h16 >= snap->stem_size || snap->branches[h16] == NULL) {
+        return 0;
+    }
+    return check_bit((snap->branches[h16])[l16 >> 3], l16 & 0x07) ? 1 : 0;
+}
+
+/**
+ * @brief Iterate a snapshot in the ascending order.
+ *
+ * @param [in]
+ *  *cursor is 0 to start, and is advanced past every elem returned
+ *
+ * @returns
+ *  1 if *elem is the next elem
+ *  0 if the iteration is done
+ */
+int bitmap_snapshot_next(const bitmap_snapshot *snap, uint64_t *cursor, uint32_t *elem) {
+    if(snap == NULL || cursor == NULL) {
+        return 0;
+    }
+    while(*cursor < ((uint64_t)snap->stem_size << 16)) {
+        uint32_t h16 = (uint32_t)(*cursor >> 16), l16 = (uint32_t)(*cursor & 0xFFFF);
+        const uint8_t *branch = snap->branches[h16];
+        if(branch == NULL) {
+            *cursor = (uint64_t)(h16 + 1) << 16;
+            continue;
+        }
+        for(; l16 < 65536; l16++) {
+            if((l16 & 0x07) == 0 && branch[l16 >> 3] == 0) {
+                l16 += 7;
+                continue;
+            }
+            if(check_bit(branch[l16 >> 3], l16 & 0x07)) {
+                *elem = (h16 << 16) | l16;
+                *cursor = (uint64_t)(*elem) + 1;
+                return 1;
+            }
+        }
+        *cursor = (uint64_t)(h16 + 1) << 16;
+    }
+    return 0;
+}
+
+/**
+ * @brief Export a snapshot in the ascending order.
+ *
+ * @param [out]
+ *  *output_arr must be able to hold snap->num_elems integers
+ *
+ * @returns
+ *  The number of integers exported
+ */
+uint64_t bitmap_snapshot_export(const bitmap_snapshot *snap, uint32_t *output_arr) {
+    uint64_t j = 0;
+    if(snap == NULL || output_arr == NULL) {
+        return 0;
+    }
+    for(uint32_t h16 = 0; h16 < snap->stem_size; h16++) {
+        const uint8_t *branch = snap->branches[h16];
+        if(branch == NULL) {
+            continue;
+        }
+        for(uint32_t k = 0; k < BITMAP_BRANCH_SIZE; k++) {
+            uint8_t byte = branch[k];
+            for(uint32_t bit = 0; byte != 0; bit++, byte = (uint8_t)(byte << 1)) {
+                if(byte & 0x80) {
+                    output_arr[j++] = (h16 << 16) | (k << 3) | bit;
+                }
+            }
+        }
+    }
+    return j;
+}
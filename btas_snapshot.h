@@ -0,0 +1,76 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+
+#ifndef BTAS_SNAPSHOT_H_
+#define BTAS_SNAPSHOT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * A streaming BitTree with consistent read-only snapshots, e.g. to count
+ * or export a set for a report while the ingestion keeps inserting.
+ *
+ * - A snapshot copies the stem (the branch pointers, up to 512 KiB), not
+ *   the branches, and starts a new epoch.
+ * - The writer copies a branch before its first change after a snapshot
+ *   that can see it (copy-on-write), and retires the old one.
+ * - A retired branch is freed when no live snapshot taken between its
+ *   creation and its retirement is left (epoch-based reclamation).
+ *
+ * One thread inserts. Any thread may take, read and release snapshots:
+ * reading a snapshot takes no lock, and taking or releasing one only holds
+ * the tree lock for the stem copy or the reclamation.
+ */
+typedef struct {
+    uint8_t *ptr_branch;
+    uint64_t epoch;             /* The epoch that created (or copied) it */
+} vtree_branch;
+
+typedef struct {
+    uint8_t *ptr_branch;
+    uint64_t created;
+    uint64_t retired;
+} vtree_retired;
+
+typedef struct {
+    vtree_branch *stem;
+    uint32_t stem_size;
+    uint32_t num_branches;
+    uint64_t num_elems;
+    uint64_t epoch;             /* The current write epoch */
+    uint64_t *live_epochs;      /* Epochs of the live snapshots */
+    uint32_t num_live;
+    uint32_t live_cap;
+    vtree_retired *retired;
+    uint64_t num_retired;
+    uint64_t retired_cap;
+    pthread_mutex_t lock;
+} bitmap_vtree;
+
+typedef struct {
+    bitmap_vtree *tree;
+    uint64_t epoch;
+    uint8_t **branches;
+    uint32_t stem_size;
+    uint32_t num_branches;
+    uint64_t num_elems;
+} bitmap_snapshot;
+
+int bitmap_vtree_init(bitmap_vtree *tree);
+void bitmap_vtree_free(bitmap_vtree *tree);
+uint64_t bitmap_vtree_insert_arr(bitmap_vtree *tree, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag);
+int bitmap_vtree_snapshot(bitmap_vtree *tree, bitmap_snapshot *snap);
+void bitmap_snapshot_release(bitmap_snapshot *snap);
+int bitmap_snapshot_contains(const bitmap_snapshot *snap, uint32_t elem);
+int bitmap_snapshot_next(const bitmap_snapshot *snap, uint64_t *cursor, uint32_t *elem);
+uint64_t bitmap_snapshot_export(const bitmap_snapshot *snap, uint32_t *output_arr);
+
+#endif
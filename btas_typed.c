@@ -0,0 +1,225 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "btas.h"
+#include "btas_typed.h"
+
+/*
+ * Value <-> key mappings. The float ones test the bits rather than compare
+ * the values, so they hold under -ffast-math (-Ofast), which assumes there
+ * is no NaN.
+ */
+static inline uint64_t typed_key_u8(uint8_t v) { return v; }
+static inline uint8_t typed_val_u8(uint64_t key) { return (uint8_t)key; }
+static inline uint64_t typed_key_i8(int8_t v) { return (uint8_t)v ^ 0x80U; }
+static inline int8_t typed_val_i8(uint64_t key) { return (int8_t)(uint8_t)(key ^ 0x80U); }
+static inline uint64_t typed_key_u16(uint16_t v) { return v; }
+static inline uint16_t typed_val_u16(uint64_t key) { return (uint16_t)key; }
+static inline uint64_t typed_key_i16(int16_t v) { return (uint16_t)v ^ 0x8000U; }
+static inline int16_t typed_val_i16(uint64_t key) { return (int16_t)(uint16_t)(key ^ 0x8000U); }
+static inline uint64_t typed_key_u32(uint32_t v) { return v; }
+static inline uint32_t typed_val_u32(uint64_t key) { return (uint32_t)key; }
+static inline uint64_t typed_key_i32(int32_t v) { return (uint32_t)v ^ 0x80000000U; }
+static inline int32_t typed_val_i32(uint64_t key) { return (int32_t)(uint32_t)(key ^ 0x80000000U); }
+static inline uint64_t typed_key_u64(uint64_t v) { return v; }
+static inline uint64_t typed_val_u64(uint64_t key) { return key; }
+static inline uint64_t typed_key_i64(int64_t v) { return (uint64_t)v ^ 0x8000000000000000ULL; }
+static inline int64_t typed_val_i64(uint64_t key) { return (int64_t)(key ^ 0x8000000000000000ULL); }
+
+static inline uint64_t typed_key_f32(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(uint32_t));
+    if((bits & 0x7F800000U) == 0x7F800000U && (bits & 0x007FFFFFU) != 0) {
+        bits = 0x7FC00000U;     /* The quiet NaN */
+    }
+    else if(bits == 0x80000000U) {
+        bits = 0;               /* -0.0 */
+    }
+    return (bits & 0x80000000U) ? (uint32_t)~bits : (bits | 0x80000000U);
+}
+
+static inline float typed_val_f32(uint64_t key) {
+    uint32_t bits = (key & 0x80000000U) ? ((uint32_t)key ^ 0x80000000U) : (uint32_t)~key;
+    float v;
+    memcpy(&v, &bits, sizeof(float));
+    return v;
+}
+
+static inline uint64_t typed_key_f64(double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(uint64_t));
+    if((bits & 0x7FF0000000000000ULL) == 0x7FF0000000000000ULL && (bits & 0x000FFFFFFFFFFFFFULL) != 0) {
+        bits = 0x7FF8000000000000ULL;
+    }
+    else if(bits == 0x8000000000000000ULL) {
+        bits = 0;
+    }
+    return (bits & 0x8000000000000000ULL) ? ~bits : (bits | 0x8000000000000000ULL);
+}
+
+static inline double typed_val_f64(uint64_t key) {
+    uint64_t bits = (key & 0x8000000000000000ULL) ? (key ^ 0x8000000000000000ULL) : ~key;
+    double v;
+    memcpy(&v, &bits, sizeof(double));
+    return v;
+}
+
+/*
+ * The template. typed_dedup_<name> picks the path by the width of the type;
+ * the width is a constant, so only one path is left in each function.
+ * The output array is optional (NULL to count).
+ */
+#define TYPED_DEFINE(name, type) \
+static uint64_t typed_dedup_##name(const type *input_arr, const uint64_t num_elems, type *output_arr, int *err_flag, btas_stats *stats) { \
+    uint64_t i, k, j = 0, num_new = 0; \
+    uint64_t output_bytes = (output_arr != NULL) ? num_elems * sizeof(type) : 0; \
+    if(sizeof(type) <= sizeof(uint16_t)) { \
+        uint8_t bitmap[BITMAP_BRANCH_SIZE]; \
+        uint32_t bitmap_bytes = (sizeof(type) == sizeof(uint8_t)) ? 32 : BITMAP_BRANCH_SIZE; \
+        memset(bitmap, 0, bitmap_bytes); \
+        for(i = 0; i < num_elems; i++) { \
+            uint32_t key = (uint32_t)typed_key_##name(input_arr[i]); \
+            if(check_bit(bitmap[key >> 3], key & 0x07)) { \
+                continue; \
+            } \
+            flip_bit(bitmap[key >> 3], key & 0x07); \
+            if(output_arr != NULL) { \
+                output_arr[j] = input_arr[i]; \
+            } \
+            j++; \
+        } \
+        if(stats != NULL) { \
+            stats->index_bytes = bitmap_bytes; \
+            stats->output_bytes = output_bytes; \
+            stats->peak_bytes = bitmap_bytes + output_bytes; \
+        } \
+        return j; \
+    } \
+    if(sizeof(type) == sizeof(uint32_t)) { \
+        bitmap_tree tree; \
+        uint32_t keys[TYPED_BLOCK]; \
+        if(bitmap_tree_init(&tree) != 0) { \
+            *err_flag = 5; \
+            return 0; \
+        } \
+        for(i = 0; i < num_elems && *err_flag == 0; i += num_new) { \
+            num_new = (num_elems - i > TYPED_BLOCK) ? TYPED_BLOCK : (num_elems - i); \
+            for(k = 0; k < num_new; k++) { \
+                keys[k] = (uint32_t)typed_key_##name(input_arr[i + k]); \
+            } \
+            /* The new keys are moved to the front of the block. */ \
+            uint64_t num_uniq = bitmap_tree_insert_arr(&tree, keys, num_new, (output_arr != NULL) ? keys : NULL, err_flag); \
+            for(k = 0; output_arr != NULL && k < num_uniq; k++) { \
+                output_arr[j + k] = typed_val_##name(keys[k]); \
+            } \
+            j += num_uniq; \
+        } \
+        if(stats != NULL) { \
+            stats->num_branches = tree.num_branches; \
+            stats->stem_length = tree.bitmap_base_size; \
+            stats->stem_bytes = tree.bitmap_base_size * sizeof(bitmap_base); \
+            stats->branch_bytes = (uint64_t)tree.num_branches * BITMAP_BRANCH_SIZE; \
+            stats->output_bytes = output_bytes; \
+            stats->peak_bytes = stats->stem_bytes + stats->branch_bytes + output_bytes; \
+        } \
+        bitmap_tree_free(&tree); \
+        return j; \
+    } \
+    uint64_t *keys = (uint64_t *)malloc(num_elems * sizeof(uint64_t)); \
+    uint64_t *uniq_keys = NULL; \
+    if(keys == NULL) { \
+        *err_flag = 5; \
+        return 0; \
+    } \
+    for(i = 0; i < num_elems; i++) { \
+        keys[i] = typed_key_##name(input_arr[i]); \
+    } \
+    uniq_keys = fui_radix_u64(keys, num_elems, &j, err_flag, stats); \
+    free(keys); \
+    if(uniq_keys == NULL) { \
+        return 0; \
+    } \
+    for(k = 0; output_arr != NULL && k < j; k++) { \
+        output_arr[k] = typed_val_##name(uniq_keys[k]); \
+    } \
+    free(uniq_keys); \
+    if(stats != NULL) { \
+        stats->index_bytes += num_elems * sizeof(uint64_t); \
+        stats->output_bytes = output_bytes; \
+        stats->peak_bytes += num_elems * sizeof(uint64_t); \
+    } \
+    return j; \
+} \
+\
+type* fui_typed_##name(const type *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats) { \
+    uint64_t j = 0; \
+    type *final_output_arr = NULL; \
+    *err_flag = 0; \
+    *num_elems_out = 0; \
+    if(stats != NULL) { \
+        memset(stats, 0, sizeof(btas_stats)); \
+    } \
+    if(input_arr == NULL) { \
+        *err_flag = -5; \
+        return NULL; \
+    } \
+    if(num_elems < 1) { \
+        *err_flag = -3; \
+        return NULL; \
+    } \
+    type *output_arr = (type *)malloc(num_elems * sizeof(type)); \
+    if(output_arr == NULL) { \
+        *err_flag = -1; \
+        return NULL; \
+    } \
+    j = typed_dedup_##name(input_arr, num_elems, output_arr, err_flag, stats); \
+    if(*err_flag != 0) { \
+        free(output_arr); \
+        return NULL; \
+    } \
+    final_output_arr = (type *)realloc(output_arr, j * sizeof(type)); \
+    if(final_output_arr == NULL) { \
+        free(output_arr); \
+        *err_flag = 3; \
+        return NULL; \
+    } \
+    *num_elems_out = j; \
+    return final_output_arr; \
+} \
+\
+uint64_t fui_typed_##name##_count(const type *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats) { \
+    uint64_t j = 0; \
+    *err_flag = 0; \
+    if(stats != NULL) { \
+        memset(stats, 0, sizeof(btas_stats)); \
+    } \
+    if(input_arr == NULL) { \
+        *err_flag = -5; \
+        return 0; \
+    } \
+    if(num_elems < 1) { \
+        *err_flag = -3; \
+        return 0; \
+    } \
+    j = typed_dedup_##name(input_arr, num_elems, NULL, err_flag, stats); \
+    return (*err_flag != 0) ? 0 : j; \
+}
+
+TYPED_DEFINE(u8, uint8_t)
+TYPED_DEFINE(i8, int8_t)
+TYPED_DEFINE(u16, uint16_t)
+TYPED_DEFINE(i16, int16_t)
+TYPED_DEFINE(u32, uint32_t)
+TYPED_DEFINE(i32, int32_t)
+TYPED_DEFINE(f32, float)
+TYPED_DEFINE(u64, uint64_t)
+TYPED_DEFINE(i64, int64_t)
+TYPED_DEFINE(f64, double)
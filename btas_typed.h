@@ -0,0 +1,52 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+
+#ifndef BTAS_TYPED_H_
+#define BTAS_TYPED_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "btas.h"
+
+/**
+ * Dedup of columns of any primitive type, generated from one template in
+ * btas_typed.c. A value is mapped to an unsigned key of the same width:
+ *
+ * - Signed integers flip the sign bit, so the keys keep the value order.
+ * - Floats and doubles are bit-cast, with -0.0 mapped to 0.0 and every NaN
+ *   to one quiet NaN; negative values get all the bits flipped, positive
+ *   ones the sign bit, so the keys keep the value order as well (NaN last).
+ *
+ * By width:
+ * - 8 and 16 bits: one bitmap of 32 bytes or 8 KiB on the stack, in L1.
+ *   The output keeps the input order.
+ * - 32 bits: a streaming BitTree, fed TYPED_BLOCK keys at a time from a
+ *   buffer on the stack. The output keeps the input order.
+ * - 64 bits: the radix engine on the keys. The output is in ascending order.
+ *
+ * Floats are output as their canonical values (0.0, and the quiet NaN).
+ */
+#define TYPED_BLOCK         4096
+
+#define TYPED_DECLARE(name, type) \
+    type* fui_typed_##name(const type *input_arr, const uint64_t num_elems, uint64_t *num_elems_out, int *err_flag, btas_stats *stats); \
+    uint64_t fui_typed_##name##_count(const type *input_arr, const uint64_t num_elems, int *err_flag, btas_stats *stats);
+
+TYPED_DECLARE(u8, uint8_t)
+TYPED_DECLARE(i8, int8_t)
+TYPED_DECLARE(u16, uint16_t)
+TYPED_DECLARE(i16, int16_t)
+TYPED_DECLARE(u32, uint32_t)
+TYPED_DECLARE(i32, int32_t)
+TYPED_DECLARE(f32, float)
+TYPED_DECLARE(u64, uint64_t)
+TYPED_DECLARE(i64, int64_t)
+TYPED_DECLARE(f64, double)
+
+#endif
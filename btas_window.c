@@ -0,0 +1,250 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "btas.h"
+#include "btas_window.h"
+
+/**
+ * @brief Initialize an empty window.
+ *
+ * @param [in]
+ *  num_gens is the number of generations (2 ~ WINDOW_MAX_GENS is useful,
+ *   1 forgets everything on every advance)
+ *  gen_span is the time span of a generation for bitmap_window_set_time(),
+ *   or 0 to advance manually
+ *
+ * @returns
+ *  -5 if the window pointer is null
+ *  -3 if num_gens is out of range
+ *   5 if failed to allocate memory
+ *   0 if succeeded
+ */
+int bitmap_window_init(bitmap_window *win, uint32_t num_gens, uint64_t gen_span) {
+    if(win == NULL) {
+        return -5;
+    }
+    memset(win, 0, sizeof(bitmap_window));
+    if(num_gens == 0 || num_gens > WINDOW_MAX_GENS) {
+        return -3;
+    }
+    if((win->gens = (bitmap_tree *)calloc(num_gens, sizeof(bitmap_tree))) == NULL) {
+        return 5;
+    }
+    win->num_gens = num_gens;
+    win->gen_span = gen_span;
+    if(bitmap_tree_init(&win->seen) != 0) {
+        bitmap_window_free(win);
+        return 5;
+    }
+    for(uint32_t i = 0; i < num_gens; i++) {
+        if(bitmap_tree_init(win->gens + i) != 0) {
+            bitmap_window_free(win);
+            return 5;
+        }
+    }
+    return 0;
+}
+
+void bitmap_window_free(bitmap_window *win) {
+    if(win == NULL || win->gens == NULL) {
+        return;
+    }
+    for(uint32_t i = 0; i < win->num_gens; i++) {
+        bitmap_tree_free(win->gens + i);
+    }
+    bitmap_tree_free(&win->seen);
+    free(win->gens);
+    free(win->block);
+    memset(win, 0, sizeof(bitmap_window));
+}
+
+static uint64_t popcount_branch(const uint8_t *branch) {
+    uint64_t count = 0, word;
+    for(uint32_t i = 0; i < BITMAP_BRANCH_SIZE; i += 8) {
+        memcpy(&word, branch + i, sizeof(uint64_t));
+#if defined(__GNUC__) || defined(__clang__)
+        count += (uint64_t)__builtin_popcountll(word);
+#else
+        for(; word != 0; word &= word - 1) {
+            count++;
+        }
+#endif
+    }
+    return count;
+}
+
+/* Rebuild the union branches of a generation about to be dropped. */
+static void unseen_gen(bitmap_window *win, uint32_t gen) {
+    const bitmap_tree *expired = win->gens + gen;
+    bitmap_tree *seen = &win->seen;
+    for(uint32_t h16 = 0; h16 < expired->bitmap_base_size; h16++) {
+        if(expired->bitmap_head[h16].ptr_branch == NULL || h16 >= seen->bitmap_base_size || seen->bitmap_head[h16].ptr_branch == NULL) {
+            continue;
+        }
+        uint8_t *union_branch = seen->bitmap_head[h16].ptr_branch;
+        uint64_t old_count = popcount_branch(union_branch);
+        int has_branch = 0;
+        for(uint32_t i = 0; i < win->num_gens; i++) {
+            const bitmap_tree *other = win->gens + i;
+            if(i == gen || h16 >= other->bitmap_base_size || other->bitmap_head[h16].ptr_branch == NULL) {
+                continue;
+            }
+            if(!has_branch) {
+                memcpy(union_branch, other->bitmap_head[h16].ptr_branch, BITMAP_BRANCH_SIZE);
+                has_branch = 1;
+                continue;
+            }
+            const uint8_t *other_branch = other->bitmap_head[h16].ptr_branch;
+            for(uint32_t k = 0; k < BITMAP_BRANCH_SIZE; k++) {
+                union_branch[k] |= other_branch[k];
+            }
+        }
+        if(!has_branch) {
+            free(union_branch);
+            seen->bitmap_head[h16].ptr_branch = NULL;
+            seen->num_branches--;
+            seen->num_elems -= old_count;
+            continue;
+        }
+        seen->num_elems -= old_count - popcount_branch(union_branch);
+    }
+}
+
+/**
+ * @brief Start a new generation, dropping the oldest one.
+ *
+ * @returns
+ *  -5 if the window is null or not initialized
+ *   5 if failed to allocate the new stem (the generation stays empty)
+ *   0 if succeeded
+ */
+int bitmap_window_advance(bitmap_window *win) {
+    if(win == NULL || win->gens == NULL) {
+        return -5;
+    }
+    win->current = (win->current + 1) % win->num_gens;
+    unseen_gen(win, win->current);
+    bitmap_tree_free(win->gens + win->current);
+    win->num_expired++;
+    return bitmap_tree_init(win->gens + win->current);
+}
+
+/**
+ * @brief Advance the window to a time, one generation per gen_span. The
+ *   time never goes back: an earlier time is ignored.
+ *
+ * @returns
+ *  -5 if the window is null or not initialized
+ *   3 if the window has no gen_span
+ *   5 if failed to allocate a new stem
+ *   0 if succeeded
+ */
+int bitmap_window_set_time(bitmap_window *win, uint64_t now) {
+    int advance_flag = 0;
+    if(win == NULL || win->gens == NULL) {
+        return -5;
+    }
+    if(win->gen_span == 0) {
+        return 3;
+    }
+    uint64_t target_id = now / win->gen_span;
+    /* The first time only sets the clock: the elems inserted before it
+       belong to the current generation. */
+    if(!win->is_timed) {
+        win->gen_id = target_id;
+        win->is_timed = 1;
+        return 0;
+    }
+    if(target_id <= win->gen_id) {
+        return 0;
+    }
+    uint64_t steps = target_id - win->gen_id;
+    steps = (steps > win->num_gens) ? win->num_gens : steps;
+    for(uint64_t i = 0; i < steps; i++) {
+        advance_flag = (bitmap_window_advance(win) != 0) ? 5 : advance_flag;
+    }
+    win->gen_id = target_id;
+    return advance_flag;
+}
+
+/**
+ *
+ * @brief Insert a block of integers to the window
+ *
+ * @param [in]
+ *  *win is an initialized window
+ *  *input_arr is the given array pointer
+ *  num_elems is the number of the integer elems in the given array
+ *
+ * @param [out]
+ *  *output_arr receives the integers not seen within the window, in the
+ *   order of the input. It must be able to hold num_elems integers. NULL
+ *   to skip.
+ *  *err_flag is for debugging errors: -5 null input, 5 failed to allocate
+ *   the scratch block, or the error of bitmap_tree_insert_arr()
+ *
+ * @returns
+ *  The number of integers not seen within the window. If an error occurred,
+ *  the integers inserted before the error are kept.
+ *
+ */
+uint64_t bitmap_window_insert_arr(bitmap_window *win, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag) {
+    uint64_t j = 0, start = 0;
+    *err_flag = 0;
+    if(win == NULL || win->gens == NULL || input_arr == NULL) {
+        *err_flag = -5;
+        return 0;
+    }
+    if(output_arr == NULL && win->block == NULL && (win->block = (uint32_t *)malloc(WINDOW_BLOCK * sizeof(uint32_t))) == NULL) {
+        *err_flag = 5;
+        return 0;
+    }
+    bitmap_tree *current = win->gens + win->current;
+    while(start < num_elems) {
+        uint64_t block_size = (output_arr != NULL) ? num_elems : (((num_elems - start) < WINDOW_BLOCK) ? (num_elems - start) : WINDOW_BLOCK);
+        uint32_t *block_out = (output_arr != NULL) ? output_arr : win->block;
+        int gen_err_flag = 0;
+        /* Only the elems new to the current generation can be new to the window. */
+        uint64_t num_new = bitmap_tree_insert_arr(current, input_arr + start, block_size, block_out, &gen_err_flag);
+        /* In place: the j-th output never overtakes the i-th input. The
+           elems recorded before an error go to the union as well, so the
+           generations and the union agree. */
+        j += bitmap_tree_insert_arr(&win->seen, block_out, num_new, block_out, err_flag);
+        if(*err_flag == 0) {
+            *err_flag = gen_err_flag;
+        }
+        if(output_arr != NULL || *err_flag != 0) {
+            break;
+        }
+        start += block_size;
+    }
+    return j;
+}
+
+int bitmap_window_contains(const bitmap_window *win, uint32_t elem) {
+    if(win == NULL || win->gens == NULL) {
+        return 0;
+    }
+    return bitmap_tree_contains(&win->seen, elem);
+}
+
+/* Bytes held by the stems and branches of the generations and the union. */
+uint64_t bitmap_window_mem_bytes(const bitmap_window *win) {
+    uint64_t mem_bytes = 0;
+    if(win == NULL || win->gens == NULL) {
+        return 0;
+    }
+    for(uint32_t i = 0; i < win->num_gens; i++) {
+        mem_bytes += (uint64_t)win->gens[i].bitmap_base_size * sizeof(bitmap_base) + (uint64_t)win->gens[i].num_branches * BITMAP_BRANCH_SIZE;
+    }
+    mem_bytes += (uint64_t)win->seen.bitmap_base_size * sizeof(bitmap_base) + (uint64_t)win->seen.num_branches * BITMAP_BRANCH_SIZE;
+    return mem_bytes;
+}
@@ -0,0 +1,61 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+
+#ifndef BTAS_WINDOW_H_
+#define BTAS_WINDOW_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "btas.h"
+
+/**
+ * Windowed dedup: "drop if seen in the last N minutes (or batches)".
+ *
+ * The window is a ring of num_gens generations, each a streaming BitTree,
+ * plus a union tree of all of them. An insert records every elem in the
+ * current generation (so a repeated elem stays in the window); the elems
+ * new to the generation are then inserted to the union, and those new to
+ * the union are new to the window. So an elem costs one or two BitTree
+ * inserts, whatever the number of generations.
+ *
+ * Advancing drops the oldest generation by freeing its branches in bulk,
+ * and rebuilds the union branches it held from the other generations, so
+ * the memory is bounded by what the window saw.
+ *
+ * With gen_span set, bitmap_window_set_time() advances one generation per
+ * gen_span time units (any unit, e.g. seconds of event time), so an elem
+ * is remembered for at least (num_gens - 1) * gen_span and at most
+ * num_gens * gen_span. The first call only sets the clock, and the elems
+ * inserted before it stay in the current generation. Otherwise, call
+ * bitmap_window_advance(), e.g. per batch.
+ */
+#define WINDOW_MAX_GENS     64
+#define WINDOW_BLOCK        65536   /* Elems filtered per step without an output array */
+
+typedef struct {
+    bitmap_tree *gens;      /* Ring of generations */
+    bitmap_tree seen;       /* Union of the generations */
+    uint32_t num_gens;
+    uint32_t current;       /* The generation receiving the inserts */
+    uint64_t gen_span;      /* Time units per generation, 0 - manual */
+    uint64_t gen_id;        /* Time / gen_span of the current generation */
+    int is_timed;           /* Set by the first bitmap_window_set_time() */
+    uint64_t num_expired;   /* Generations dropped so far */
+    uint32_t *block;        /* Scratch for the inserts without output */
+} bitmap_window;
+
+int bitmap_window_init(bitmap_window *win, uint32_t num_gens, uint64_t gen_span);
+void bitmap_window_free(bitmap_window *win);
+int bitmap_window_advance(bitmap_window *win);
+int bitmap_window_set_time(bitmap_window *win, uint64_t now);
+uint64_t bitmap_window_insert_arr(bitmap_window *win, const uint32_t *input_arr, const uint64_t num_elems, uint32_t *output_arr, int *err_flag);
+int bitmap_window_contains(const bitmap_window *win, uint32_t elem);
+uint64_t bitmap_window_mem_bytes(const bitmap_window *win);
+
+#endif
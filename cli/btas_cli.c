@@ -0,0 +1,823 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+
+/**
+ * btas: a sort -u / uniq style filter of unsigned integers built on BTAS.
+ *
+ * Build (from the repository root):
+ *   gcc -O3 -Wall cli/btas_cli.c btas.c data_io.c -lpthread -lm -o btas
+ *
+ * Run ./btas --help for the usage.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <inttypes.h>
+#include "../btas.h"
+
+#define CLI_BLOCK_ELEMS     1048576 /* Elems read and processed per block */
+#define CLI_TEXT_BUF_SIZE   4194304
+#define CLI_OUT_BUF_SIZE    4194304
+
+#define CLI_MODE_UNIQ       0   /* Uniques in the order of first occurrence */
+#define CLI_MODE_SORTED     1   /* Uniques in ascending order */
+#define CLI_MODE_COUNT      2   /* Number of uniques */
+#define CLI_MODE_DUPS       3   /* Values occurring more than once */
+
+#define CLI_ENGINE_BITTREE  0   /* Streaming BitTree */
+#define CLI_ENGINE_BTAS_DYN 1
+#define CLI_ENGINE_BTAS_STC 2
+#define CLI_ENGINE_HTBL_DYN 3
+#define CLI_ENGINE_HTBL     4
+#define CLI_ENGINE_RADIX    5   /* Sorted output only */
+
+/* Exit codes */
+#define CLI_OK              0
+#define CLI_ERR_USAGE       1
+#define CLI_ERR_INPUT       3
+#define CLI_ERR_MEMORY      5
+#define CLI_ERR_OUTPUT      7
+
+typedef struct {
+    int mode;
+    int engine;
+    int is_binary;
+    int out_format;             /* -1 - the input format, 0 - text, 1 - bin */
+    int width;                  /* 32 or 64 */
+    uint64_t mem_budget;        /* Bytes, 0 - unlimited */
+    const char *output_file;    /* NULL - stdout */
+} cli_options;
+
+/* Reads one input (a file or stdin) block by block */
+typedef struct {
+    FILE *file_p;
+    const char *name;
+    int is_binary;
+    int width;
+    char *text_buf;
+    size_t text_len;
+    size_t text_pos;
+    uint64_t value;             /* The number being parsed across buffers */
+    int in_number;
+    uint64_t line;
+} cli_reader;
+
+typedef struct {
+    FILE *file_p;
+    int is_binary;
+    int width;
+    char *buf;
+    size_t used;
+    int failed;
+} cli_writer;
+
+/* An integer with the position of its occurrence (the 64-bit path) */
+typedef struct {
+    uint64_t value;
+    uint64_t index;
+} cli_pair;
+
+static int budget_exceeded = 0;
+
+static void print_usage(void) {
+    printf("Usage: btas [OPTIONS] [FILE ...]\n"
+        "Filter the unique unsigned integers of the FILEs (or stdin, also given as '-').\n\n"
+        "Modes:\n"
+        "  -u, --mode=uniq     Print the unique integers in the order of first occurrence (default)\n"
+        "  -s, --mode=sorted   Print the unique integers in ascending order (sort -nu)\n"
+        "  -c, --mode=count    Print the number of unique integers (sort -u | wc -l)\n"
+        "  -d, --mode=dups     Print the integers occurring more than once, once each,\n"
+        "                      in the order of their second occurrence (uniq -d)\n\n"
+        "Options:\n"
+        "  -o FILE             Write to FILE instead of stdout\n"
+        "  --format=text|bin   text: decimal integers separated by blanks, commas or\n"
+        "                      newlines (default); bin: raw host-order integers\n"
+        "  --out-format=text|bin  Format of the output (default: the input format)\n"
+        "  --width=32|64       Width of the integers (default 32)\n"
+        "  --engine=NAME       bittree (streaming, default), btas_dyn, btas_stc,\n"
+        "                      htbl_dyn or htbl (load the whole input first). 32-bit only.\n"
+        "                      radix: radix sort, for -s and -c. 64-bit -s and -c always\n"
+        "                      use it.\n"
+        "  --threads=N         Number of worker threads (0 - auto)\n"
+        "  --mem-budget=SIZE   Fail instead of using more than SIZE bytes (K/M/G suffix)\n"
+        "  -h, --help          Print this help\n\n"
+        "Exit status: 0 ok, 1 usage error, 3 input error, 5 out of memory or budget,\n"
+        "7 output error.\n");
+}
+
+/* Parse a size with an optional K/M/G (binary) suffix. */
+static int parse_size(const char *string, uint64_t *size) {
+    char digits[32];
+    size_t len = strlen(string);
+    uint64_t shift = 0;
+    if(len == 0 || len >= sizeof(digits)) {
+        return -1;
+    }
+    strcpy(digits, string);
+    switch(toupper((unsigned char)digits[len - 1])) {
+        case 'K': shift = 10; break;
+        case 'M': shift = 20; break;
+        case 'G': shift = 30; break;
+        default: break;
+    }
+    if(shift != 0) {
+        digits[len - 1] = '\0';
+    }
+    if(string_to_u64_num(digits, size) != 0 || *size > (UINT64_MAX >> shift)) {
+        return -1;
+    }
+    *size <<= shift;
+    return 0;
+}
+
+static int parse_engine(const char *name, int *engine) {
+    static const char *names[] = {"bittree", "btas_dyn", "btas_stc", "htbl_dyn", "htbl", "radix"};
+    for(int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if(strcmp(name, names[i]) == 0) {
+            *engine = i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Parse the command line. The non-option arguments are collected
+ *   to files[] (argv pointers).
+ *
+ * @returns
+ *   0 if succeeded
+ *   1 if --help is given
+ *  -1 if an option is illegal
+ */
+static int parse_args(int argc, char **argv, cli_options *opts, const char **files, int *num_files) {
+    uint32_t num_threads = 0;
+    *num_files = 0;
+    for(int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if(strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return 1;
+        }
+        else if(strcmp(arg, "-u") == 0 || strcmp(arg, "--mode=uniq") == 0) {
+            opts->mode = CLI_MODE_UNIQ;
+        }
+        else if(strcmp(arg, "-s") == 0 || strcmp(arg, "--mode=sorted") == 0) {
+            opts->mode = CLI_MODE_SORTED;
+        }
+        else if(strcmp(arg, "-c") == 0 || strcmp(arg, "--mode=count") == 0) {
+            opts->mode = CLI_MODE_COUNT;
+        }
+        else if(strcmp(arg, "-d") == 0 || strcmp(arg, "--mode=dups") == 0) {
+            opts->mode = CLI_MODE_DUPS;
+        }
+        else if(strcmp(arg, "-o") == 0) {
+            if(i + 1 >= argc) {
+                fprintf(stderr, "btas: -o needs a file name.\n");
+                return -1;
+            }
+            opts->output_file = argv[++i];
+        }
+        else if(strcmp(arg, "--format=text") == 0 || strcmp(arg, "--format=bin") == 0) {
+            opts->is_binary = (strcmp(arg, "--format=bin") == 0);
+        }
+        else if(strcmp(arg, "--out-format=text") == 0 || strcmp(arg, "--out-format=bin") == 0) {
+            opts->out_format = (strcmp(arg, "--out-format=bin") == 0);
+        }
+        else if(strcmp(arg, "--width=32") == 0 || strcmp(arg, "--width=64") == 0) {
+            opts->width = (strcmp(arg, "--width=64") == 0) ? 64 : 32;
+        }
+        else if(strncmp(arg, "--engine=", 9) == 0) {
+            if(parse_engine(arg + 9, &opts->engine) != 0) {
+                fprintf(stderr, "btas: unknown engine '%s'.\n", arg + 9);
+                return -1;
+            }
+        }
+        else if(strncmp(arg, "--threads=", 10) == 0) {
+            if(string_to_u32_num(arg + 10, &num_threads) != 0) {
+                fprintf(stderr, "btas: illegal thread number '%s'.\n", arg + 10);
+                return -1;
+            }
+            set_num_threads(num_threads);
+        }
+        else if(strncmp(arg, "--mem-budget=", 13) == 0) {
+            if(parse_size(arg + 13, &opts->mem_budget) != 0) {
+                fprintf(stderr, "btas: illegal memory budget '%s'.\n", arg + 13);
+                return -1;
+            }
+        }
+        else if(arg[0] == '-' && arg[1] != '\0') {
+            fprintf(stderr, "btas: unknown option '%s'. Try 'btas --help'.\n", arg);
+            return -1;
+        }
+        else {
+            files[(*num_files)++] = arg;
+        }
+    }
+    if(opts->engine == CLI_ENGINE_RADIX && opts->mode != CLI_MODE_SORTED && opts->mode != CLI_MODE_COUNT) {
+        fprintf(stderr, "btas: --engine=radix needs --mode=sorted or --mode=count.\n");
+        return -1;
+    }
+    if(opts->width == 64 && opts->engine != CLI_ENGINE_BITTREE && opts->engine != CLI_ENGINE_RADIX) {
+        fprintf(stderr, "btas: --engine applies to 32-bit integers only.\n");
+        return -1;
+    }
+    if(opts->mode == CLI_MODE_DUPS && opts->engine != CLI_ENGINE_BITTREE) {
+        fprintf(stderr, "btas: --mode=dups needs the bittree engine.\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int reader_open(cli_reader *reader, const char *name, const cli_options *opts) {
+    memset(reader, 0, sizeof(cli_reader));
+    reader->name = name;
+    reader->is_binary = opts->is_binary;
+    reader->width = opts->width;
+    reader->line = 1;
+    if(strcmp(name, "-") == 0) {
+        reader->file_p = stdin;
+        reader->name = "stdin";
+    }
+    else if((reader->file_p = fopen(name, "rb")) == NULL) {
+        fprintf(stderr, "btas: cannot open '%s'.\n", name);
+        return -1;
+    }
+    if(!reader->is_binary && (reader->text_buf = (char *)malloc(CLI_TEXT_BUF_SIZE)) == NULL) {
+        if(reader->file_p != stdin) {
+            fclose(reader->file_p);
+        }
+        return 1;
+    }
+    return 0;
+}
+
+static void reader_close(cli_reader *reader) {
+    if(reader->file_p != NULL && reader->file_p != stdin) {
+        fclose(reader->file_p);
+    }
+    free(reader->text_buf);
+    reader->file_p = NULL;
+    reader->text_buf = NULL;
+}
+
+/* Finish the number being parsed, checking the width. */
+static int reader_emit(cli_reader *reader, void *block, size_t *num_elems) {
+    if(reader->width == 32) {
+        if(reader->value > UINT32_MAX) {
+            fprintf(stderr, "btas: %s:%" PRIu64 ": integer out of the 32-bit range.\n", reader->name, reader->line);
+            return -1;
+        }
+        ((uint32_t *)block)[(*num_elems)++] = (uint32_t)reader->value;
+    }
+    else {
+        ((uint64_t *)block)[(*num_elems)++] = reader->value;
+    }
+    reader->value = 0;
+    reader->in_number = 0;
+    return 0;
+}
+
+/**
+ * @brief Read up to max_elems integers to block.
+ *
+ * @returns
+ *   0 if integers are read (*num_elems > 0) or the input ended (*num_elems == 0)
+ *  -1 if the input is illegal or failed to read
+ */
+static int reader_next(cli_reader *reader, void *block, size_t max_elems, size_t *num_elems) {
+    size_t elem_size = (size_t)reader->width / 8;
+    *num_elems = 0;
+    if(reader->is_binary) {
+        size_t num_read = fread(block, 1, max_elems * elem_size, reader->file_p);
+        if(ferror(reader->file_p)) {
+            fprintf(stderr, "btas: failed to read '%s'.\n", reader->name);
+            return -1;
+        }
+        if(num_read % elem_size != 0) {
+            fprintf(stderr, "btas: '%s' is truncated (not a multiple of %u bytes).\n", reader->name, (unsigned)elem_size);
+            return -1;
+        }
+        *num_elems = num_read / elem_size;
+        return 0;
+    }
+    while(*num_elems < max_elems) {
+        if(reader->text_pos == reader->text_len) {
+            reader->text_len = fread(reader->text_buf, 1, CLI_TEXT_BUF_SIZE, reader->file_p);
+            reader->text_pos = 0;
+            if(reader->text_len == 0) {
+                if(ferror(reader->file_p)) {
+                    fprintf(stderr, "btas: failed to read '%s'.\n", reader->name);
+                    return -1;
+                }
+                if(reader->in_number) {
+                    return reader_emit(reader, block, num_elems);
+                }
+                return 0;
+            }
+        }
+        while(reader->text_pos < reader->text_len && *num_elems < max_elems) {
+            char c = reader->text_buf[reader->text_pos++];
+            if(c >= '0' && c <= '9') {
+                if(reader->value > (UINT64_MAX - (uint64_t)(c - '0')) / 10) {
+                    fprintf(stderr, "btas: %s:%" PRIu64 ": integer out of the 64-bit range.\n", reader->name, reader->line);
+                    return -1;
+                }
+                reader->value = reader->value * 10 + (uint64_t)(c - '0');
+                reader->in_number = 1;
+                continue;
+            }
+            if(c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != ',') {
+                fprintf(stderr, "btas: %s:%" PRIu64 ": illegal character '%c'.\n", reader->name, reader->line, c);
+                return -1;
+            }
+            if(reader->in_number && reader_emit(reader, block, num_elems) != 0) {
+                return -1;
+            }
+            reader->line += (c == '\n');
+        }
+    }
+    return 0;
+}
+
+static int writer_open(cli_writer *writer, const cli_options *opts) {
+    writer->is_binary = (opts->out_format < 0) ? opts->is_binary : opts->out_format;
+    writer->width = opts->width;
+    writer->used = 0;
+    writer->failed = 0;
+    writer->file_p = stdout;
+    if((writer->buf = (char *)malloc(CLI_OUT_BUF_SIZE)) == NULL) {
+        return 1;
+    }
+    if(opts->output_file != NULL && (writer->file_p = fopen(opts->output_file, "wb")) == NULL) {
+        fprintf(stderr, "btas: cannot open '%s' for writing.\n", opts->output_file);
+        free(writer->buf);
+        return -1;
+    }
+    return 0;
+}
+
+static void writer_flush(cli_writer *writer) {
+    if(writer->used != 0 && !writer->failed && fwrite(writer->buf, 1, writer->used, writer->file_p) != writer->used) {
+        writer->failed = 1;
+    }
+    writer->used = 0;
+}
+
+static void writer_put(cli_writer *writer, uint64_t value) {
+    if(writer->used + 24 > CLI_OUT_BUF_SIZE) {
+        writer_flush(writer);
+    }
+    if(writer->is_binary) {
+        if(writer->width == 32) {
+            uint32_t value_u32 = (uint32_t)value;
+            memcpy(writer->buf + writer->used, &value_u32, sizeof(uint32_t));
+            writer->used += sizeof(uint32_t);
+        }
+        else {
+            memcpy(writer->buf + writer->used, &value, sizeof(uint64_t));
+            writer->used += sizeof(uint64_t);
+        }
+        return;
+    }
+    char digits[20];
+    int num_digits = 0;
+    do {
+        digits[num_digits++] = (char)('0' + value % 10);
+        value /= 10;
+    } while(value != 0);
+    while(num_digits > 0) {
+        writer->buf[writer->used++] = digits[--num_digits];
+    }
+    writer->buf[writer->used++] = '\n';
+}
+
+static void writer_put_u32_arr(cli_writer *writer, const uint32_t *arr, uint64_t num_elems) {
+    for(uint64_t i = 0; i < num_elems; i++) {
+        writer_put(writer, arr[i]);
+    }
+}
+
+/* The count is always printed as text. */
+static void writer_put_count(cli_writer *writer, uint64_t count) {
+    int is_binary = writer->is_binary;
+    writer->is_binary = 0;
+    writer_put(writer, count);
+    writer->is_binary = is_binary;
+}
+
+static int writer_close(cli_writer *writer) {
+    writer_flush(writer);
+    if(writer->file_p != stdout) {
+        writer->failed |= (fclose(writer->file_p) != 0);
+    }
+    else {
+        writer->failed |= (fflush(stdout) != 0);
+    }
+    free(writer->buf);
+    if(writer->failed) {
+        fprintf(stderr, "btas: failed to write the output.\n");
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t tree_bytes(const bitmap_tree *tree) {
+    return (uint64_t)tree->num_branches * BITMAP_BRANCH_SIZE + (uint64_t)tree->bitmap_base_size * sizeof(bitmap_base);
+}
+
+static int check_budget(const cli_options *opts, uint64_t bytes) {
+    if(opts->mem_budget != 0 && bytes > opts->mem_budget) {
+        fprintf(stderr, "btas: the memory budget (%" PRIu64 " bytes) is exceeded.\n", opts->mem_budget);
+        budget_exceeded = 1;
+        return -1;
+    }
+    return 0;
+}
+
+/* Write the integers of a BitTree in ascending order. */
+static void write_tree_sorted(cli_writer *writer, const bitmap_tree *tree) {
+    for(uint32_t h16 = 0; h16 < tree->bitmap_base_size; h16++) {
+        const uint8_t *branch = tree->bitmap_head[h16].ptr_branch;
+        if(branch == NULL) {
+            continue;
+        }
+        for(uint32_t byte_index = 0; byte_index < BITMAP_BRANCH_SIZE; byte_index++) {
+            for(uint8_t bits = branch[byte_index], bit_position = 0; bits != 0; bit_position++) {
+                if(check_bit(bits, bit_position)) {
+                    writer_put(writer, ((uint64_t)h16 << 16) | (byte_index << 3) | bit_position);
+                    bits &= (uint8_t)~(0x80 >> bit_position);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Stream 32-bit integers through BitTrees: "seen" records every
+ *   integer, "dups" the ones printed by --mode=dups.
+ *
+ * @returns
+ *   The exit code
+ */
+static int run_bittree(const cli_options *opts, const char **files, int num_files, cli_writer *writer) {
+    bitmap_tree seen, dups;
+    cli_reader reader;
+    size_t num_read = 0;
+    int err_flag = 0, ret = CLI_OK;
+    uint32_t *block = (uint32_t *)malloc(CLI_BLOCK_ELEMS * sizeof(uint32_t));
+    uint32_t *new_elems = (uint32_t *)malloc(CLI_BLOCK_ELEMS * sizeof(uint32_t));
+    if(block == NULL || new_elems == NULL || bitmap_tree_init(&seen) != 0) {
+        free(block);
+        free(new_elems);
+        return CLI_ERR_MEMORY;
+    }
+    if(bitmap_tree_init(&dups) != 0) {
+        bitmap_tree_free(&seen);
+        free(block);
+        free(new_elems);
+        return CLI_ERR_MEMORY;
+    }
+    for(int f = 0; f < num_files && ret == CLI_OK; f++) {
+        int open_flag = reader_open(&reader, files[f], opts);
+        if(open_flag != 0) {
+            ret = (open_flag < 0) ? CLI_ERR_INPUT : CLI_ERR_MEMORY;
+            break;
+        }
+        while(ret == CLI_OK) {
+            if(reader_next(&reader, block, CLI_BLOCK_ELEMS, &num_read) != 0) {
+                ret = CLI_ERR_INPUT;
+                break;
+            }
+            if(num_read == 0) {
+                break;
+            }
+            if(opts->mode == CLI_MODE_DUPS) {
+                for(size_t i = 0; i < num_read && err_flag == 0; i++) {
+                    if(bitmap_tree_insert_arr(&seen, block + i, 1, NULL, &err_flag) == 0 && err_flag == 0 &&
+                        bitmap_tree_insert_arr(&dups, block + i, 1, NULL, &err_flag) == 1) {
+                        writer_put(writer, block[i]);
+                    }
+                }
+            }
+            else {
+                uint64_t num_new = bitmap_tree_insert_arr(&seen, block, num_read, (opts->mode == CLI_MODE_UNIQ) ? new_elems : NULL, &err_flag);
+                if(opts->mode == CLI_MODE_UNIQ) {
+                    writer_put_u32_arr(writer, new_elems, num_new);
+                }
+            }
+            if(err_flag != 0) {
+                ret = CLI_ERR_MEMORY;
+            }
+            else if(check_budget(opts, tree_bytes(&seen) + tree_bytes(&dups) + 2 * CLI_BLOCK_ELEMS * sizeof(uint32_t)) != 0) {
+                ret = CLI_ERR_MEMORY;
+            }
+        }
+        reader_close(&reader);
+    }
+    if(ret == CLI_OK) {
+        if(opts->mode == CLI_MODE_COUNT) {
+            writer_put_count(writer, seen.num_elems);
+        }
+        else if(opts->mode == CLI_MODE_SORTED) {
+            write_tree_sorted(writer, &seen);
+        }
+    }
+    bitmap_tree_free(&seen);
+    bitmap_tree_free(&dups);
+    free(block);
+    free(new_elems);
+    return ret;
+}
+
+/**
+ * @brief Read all the inputs to one array of (width / 8)-byte integers.
+ *
+ * @returns
+ *   The exit code
+ */
+static int load_inputs(const cli_options *opts, const char **files, int num_files, void **arr, uint64_t *num_elems) {
+    size_t elem_size = (size_t)opts->width / 8, num_read = 0;
+    uint64_t capacity = CLI_BLOCK_ELEMS;
+    cli_reader reader;
+    char *tmp_realloc = NULL;
+    char *values = (char *)malloc(capacity * elem_size);
+    *arr = NULL;
+    *num_elems = 0;
+    if(values == NULL) {
+        return CLI_ERR_MEMORY;
+    }
+    for(int f = 0; f < num_files; f++) {
+        int open_flag = reader_open(&reader, files[f], opts);
+        if(open_flag != 0) {
+            free(values);
+            return (open_flag < 0) ? CLI_ERR_INPUT : CLI_ERR_MEMORY;
+        }
+        for(;;) {
+            if(*num_elems + CLI_BLOCK_ELEMS > capacity) {
+                if(check_budget(opts, capacity * 2 * elem_size) != 0 || (tmp_realloc = (char *)realloc(values, capacity * 2 * elem_size)) == NULL) {
+                    reader_close(&reader);
+                    free(values);
+                    return CLI_ERR_MEMORY;
+                }
+                values = tmp_realloc;
+                capacity *= 2;
+            }
+            if(reader_next(&reader, values + *num_elems * elem_size, CLI_BLOCK_ELEMS, &num_read) != 0) {
+                reader_close(&reader);
+                free(values);
+                return CLI_ERR_INPUT;
+            }
+            if(num_read == 0) {
+                break;
+            }
+            *num_elems += num_read;
+        }
+        reader_close(&reader);
+    }
+    *arr = values;
+    return CLI_OK;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t value_a = *(const uint32_t *)a, value_b = *(const uint32_t *)b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+static int compare_pair_value(const void *a, const void *b) {
+    const cli_pair *pair_a = (const cli_pair *)a, *pair_b = (const cli_pair *)b;
+    if(pair_a->value != pair_b->value) {
+        return (pair_a->value > pair_b->value) ? 1 : -1;
+    }
+    return (pair_a->index > pair_b->index) - (pair_a->index < pair_b->index);
+}
+
+static int compare_pair_index(const void *a, const void *b) {
+    const cli_pair *pair_a = (const cli_pair *)a, *pair_b = (const cli_pair *)b;
+    return (pair_a->index > pair_b->index) - (pair_a->index < pair_b->index);
+}
+
+/**
+ * @brief Load the 32-bit inputs and run an in-memory engine.
+ *
+ * @returns
+ *   The exit code
+ */
+static int run_engine_u32(const cli_options *opts, const char **files, int num_files, cli_writer *writer) {
+    void *arr = NULL;
+    uint64_t num_elems = 0, num_uniq = 0;
+    uint32_t *uniq_arr = NULL;
+    int err_flag = 0;
+    int ret = load_inputs(opts, files, num_files, &arr, &num_elems);
+    if(ret != CLI_OK) {
+        return ret;
+    }
+    /* The engines allocate an output as large as the input. */
+    if(check_budget(opts, num_elems * sizeof(uint32_t) * 2) != 0) {
+        free(arr);
+        return CLI_ERR_MEMORY;
+    }
+    if(num_elems == 0) {
+        if(opts->mode == CLI_MODE_COUNT) {
+            writer_put_count(writer, 0);
+        }
+        free(arr);
+        return CLI_OK;
+    }
+    if(opts->mode == CLI_MODE_COUNT) {
+        switch(opts->engine) {
+            case CLI_ENGINE_BTAS_STC: num_uniq = fui_bitmap_stc_count((uint32_t *)arr, num_elems, &err_flag, NULL); break;
+            case CLI_ENGINE_HTBL_DYN: num_uniq = fui_htable_dyn_count((uint32_t *)arr, num_elems, &err_flag, NULL); break;
+            case CLI_ENGINE_HTBL: num_uniq = fui_htable_count((uint32_t *)arr, num_elems, &err_flag, NULL); break;
+            case CLI_ENGINE_RADIX: num_uniq = fui_radix_count((uint32_t *)arr, num_elems, &err_flag, NULL); break;
+            default: num_uniq = fui_bitmap_dyn_count((uint32_t *)arr, num_elems, &err_flag, NULL); break;
+        }
+        free(arr);
+        if(err_flag != 0) {
+            return CLI_ERR_MEMORY;
+        }
+        writer_put_count(writer, num_uniq);
+        return CLI_OK;
+    }
+    switch(opts->engine) {
+        case CLI_ENGINE_BTAS_STC: uniq_arr = fui_bitmap_stc((uint32_t *)arr, num_elems, &num_uniq, &err_flag, NULL); break;
+        case CLI_ENGINE_HTBL_DYN: uniq_arr = fui_htable_dyn((uint32_t *)arr, num_elems, &num_uniq, &err_flag, NULL); break;
+        case CLI_ENGINE_HTBL: uniq_arr = fui_htable((uint32_t *)arr, num_elems, &num_uniq, &err_flag, NULL); break;
+        case CLI_ENGINE_RADIX: uniq_arr = fui_radix((uint32_t *)arr, num_elems, &num_uniq, &err_flag, NULL); break;
+        default: uniq_arr = fui_bitmap_dyn((uint32_t *)arr, num_elems, &num_uniq, &err_flag, NULL); break;
+    }
+    free(arr);
+    if(uniq_arr == NULL) {
+        return CLI_ERR_MEMORY;
+    }
+    if(opts->mode == CLI_MODE_SORTED && opts->engine != CLI_ENGINE_RADIX) {
+        qsort(uniq_arr, num_uniq, sizeof(uint32_t), compare_u32);
+    }
+    writer_put_u32_arr(writer, uniq_arr, num_uniq);
+    free(uniq_arr);
+    return CLI_OK;
+}
+
+/**
+ * @brief Load the 64-bit inputs and sort them with the radix engine, for
+ *   the sorted and count modes, which need no input order.
+ *
+ * @returns
+ *   The exit code
+ */
+static int run_radix_u64(const cli_options *opts, const char **files, int num_files, cli_writer *writer) {
+    void *arr = NULL;
+    uint64_t num_elems = 0, num_uniq = 0, i;
+    int err_flag = 0;
+    int ret = load_inputs(opts, files, num_files, &arr, &num_elems);
+    if(ret != CLI_OK) {
+        return ret;
+    }
+    /* The output and the scratch buffer are as large as the input. */
+    if(check_budget(opts, num_elems * sizeof(uint64_t) * 3) != 0) {
+        free(arr);
+        return CLI_ERR_MEMORY;
+    }
+    if(num_elems == 0) {
+        if(opts->mode == CLI_MODE_COUNT) {
+            writer_put_count(writer, 0);
+        }
+        free(arr);
+        return CLI_OK;
+    }
+    uint64_t *uniq_arr = fui_radix_u64((uint64_t *)arr, num_elems, &num_uniq, &err_flag, NULL);
+    free(arr);
+    if(uniq_arr == NULL) {
+        return CLI_ERR_MEMORY;
+    }
+    if(opts->mode == CLI_MODE_COUNT) {
+        writer_put_count(writer, num_uniq);
+    }
+    else {
+        for(i = 0; i < num_uniq; i++) {
+            writer_put(writer, uniq_arr[i]);
+        }
+    }
+    free(uniq_arr);
+    return CLI_OK;
+}
+
+/**
+ * @brief Load the 64-bit inputs and filter them by sorting (value, index)
+ *   pairs, as there is no 64-bit BitTree engine yet.
+ *
+ * @returns
+ *   The exit code
+ */
+static int run_sort_u64(const cli_options *opts, const char **files, int num_files, cli_writer *writer) {
+    void *arr = NULL;
+    uint64_t num_elems = 0, num_out = 0, i;
+    int ret = load_inputs(opts, files, num_files, &arr, &num_elems);
+    if(ret != CLI_OK) {
+        return ret;
+    }
+    if(check_budget(opts, num_elems * (sizeof(uint64_t) + sizeof(cli_pair))) != 0) {
+        free(arr);
+        return CLI_ERR_MEMORY;
+    }
+    cli_pair *pairs = (cli_pair *)malloc((num_elems + 1) * sizeof(cli_pair));
+    if(pairs == NULL) {
+        free(arr);
+        return CLI_ERR_MEMORY;
+    }
+    for(i = 0; i < num_elems; i++) {
+        pairs[i].value = ((uint64_t *)arr)[i];
+        pairs[i].index = i;
+    }
+    free(arr);
+    qsort(pairs, num_elems, sizeof(cli_pair), compare_pair_value);
+    /* Keep the first (or, for dups, the second) occurrence of every value. */
+    for(i = 0; i < num_elems; i++) {
+        int is_first = (i == 0 || pairs[i].value != pairs[i - 1].value);
+        int is_second = (!is_first && (i == 1 || pairs[i - 1].value != pairs[i - 2].value));
+        if((opts->mode == CLI_MODE_DUPS) ? is_second : is_first) {
+            pairs[num_out++] = pairs[i];
+        }
+    }
+    if(opts->mode == CLI_MODE_COUNT) {
+        writer_put_count(writer, num_out);
+    }
+    else {
+        if(opts->mode != CLI_MODE_SORTED) {
+            qsort(pairs, num_out, sizeof(cli_pair), compare_pair_index);
+        }
+        for(i = 0; i < num_out; i++) {
+            writer_put(writer, pairs[i].value);
+        }
+    }
+    free(pairs);
+    return CLI_OK;
+}
+
+/**
+ * @brief
+ *  usage: btas [OPTIONS] [FILE ...], see print_usage()
+ *
+ * @returns
+ *   0 : if everything goes well
+ *   1 : illegal options
+ *   3 : failed to open or read an input, or the input is illegal
+ *   5 : out of memory, or the memory budget is exceeded
+ *   7 : failed to write the output
+ */
+int main(int argc, char **argv) {
+    cli_options opts;
+    cli_writer writer;
+    const char *stdin_name = "-";
+    const char **files = (const char **)malloc(sizeof(char *) * (size_t)argc);
+    int num_files = 0, parse_flag, ret;
+    if(files == NULL) {
+        return CLI_ERR_MEMORY;
+    }
+    memset(&opts, 0, sizeof(cli_options));
+    opts.width = 32;
+    opts.out_format = -1;
+    parse_flag = parse_args(argc, argv, &opts, files, &num_files);
+    if(parse_flag != 0) {
+        if(parse_flag == 1) {
+            print_usage();
+        }
+        free(files);
+        return (parse_flag == 1) ? CLI_OK : CLI_ERR_USAGE;
+    }
+    if(num_files == 0) {
+        files[0] = stdin_name;
+        num_files = 1;
+    }
+    ret = writer_open(&writer, &opts);
+    if(ret != 0) {
+        free(files);
+        return (ret < 0) ? CLI_ERR_OUTPUT : CLI_ERR_MEMORY;
+    }
+    if(opts.width == 64 && (opts.mode == CLI_MODE_SORTED || opts.mode == CLI_MODE_COUNT)) {
+        ret = run_radix_u64(&opts, files, num_files, &writer);
+    }
+    else if(opts.width == 64) {
+        ret = run_sort_u64(&opts, files, num_files, &writer);
+    }
+    else if(opts.engine == CLI_ENGINE_BITTREE) {
+        ret = run_bittree(&opts, files, num_files, &writer);
+    }
+    else {
+        ret = run_engine_u32(&opts, files, num_files, &writer);
+    }
+    if(ret == CLI_ERR_MEMORY && !budget_exceeded) {
+        fprintf(stderr, "btas: out of memory.\n");
+    }
+    if(writer_close(&writer) != 0 && ret == CLI_OK) {
+        ret = CLI_ERR_OUTPUT;
+    }
+    free(files);
+    return ret;
+}
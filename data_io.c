@@ -6,11 +6,1525 @@
  * GitHub: https://github.com/zhenrong-wang
  * 
  */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define DATA_IO_MMAP
+#endif
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define DATA_IO_URING
+#endif
+#endif
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#ifdef BTAS_WITH_ZLIB
+#include <zlib.h>
+#endif
+#include <pthread.h>
+#include "btas.h"
 #include "data_io.h"
 
+#if defined(__GNUC__) || defined(__clang__)
+#define popcount_u64(x) ((uint64_t)__builtin_popcountll(x))
+#define ctz_u64(x) ((uint32_t)__builtin_ctzll(x))
+#define bit_width_u32(x) ((x) == 0 ? 0 : (uint32_t)(32 - __builtin_clz(x)))
+#else
+static uint32_t bit_width_u32(uint32_t x) {
+    uint32_t width = 0;
+    for(; x != 0; x >>= 1) {
+        width++;
+    }
+    return width;
+}
+static uint64_t popcount_u64(uint64_t x) {
+    uint64_t count = 0;
+    for(; x != 0; x &= x - 1) {
+        count++;
+    }
+    return count;
+}
+static uint32_t ctz_u64(uint64_t x) {
+    uint32_t count = 0;
+    for(; (x & 1) == 0; x >>= 1) {
+        count++;
+    }
+    return count;
+}
+#endif
+
+/* A read-only view of a whole file, mmap'd if possible. */
+typedef struct {
+    const char *data;
+    size_t size;
+    int is_mapped;
+} file_view;
+
+/* A chunk of a csv view, always starting right after a '\n'. */
+typedef struct {
+    const char *base;
+    size_t chunk_start;
+    size_t chunk_end;
+    uint64_t num_elems;
+    uint32_t *output_arr;
+} csv_chunk;
+
+/**
+ * @brief Map a whole file to memory for reading. Falls back to reading
+ *   the file in TXT_READ_BLOCK blocks if mmap is not available.
+ * 
+ * @returns
+ *  -1 if failed to open the file
+ *   1 if failed to allocate memory
+ *   5 if failed to read the file
+ *   0 if succeeded
+ */
+static int map_file_view(const char *source_file, file_view *view) {
+    view->data = NULL;
+    view->size = 0;
+    view->is_mapped = 0;
+#ifdef DATA_IO_MMAP
+    int fd = open(source_file, O_RDONLY);
+    if(fd < 0) {
+        return -1;
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0) {
+        close(fd);
+        return 5;
+    }
+    if(file_stat.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    void *mapped = mmap(NULL, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped != MAP_FAILED) {
+        madvise(mapped, (size_t)file_stat.st_size, MADV_SEQUENTIAL);
+        view->data = (const char *)mapped;
+        view->size = (size_t)file_stat.st_size;
+        view->is_mapped = 1;
+        return 0;
+    }
+#endif
+    FILE *file_p = fopen(source_file, "rb");
+    if(file_p == NULL) {
+        return -1;
+    }
+    size_t capacity = 0, size = 0, bytes_read = 0;
+    char *buffer = NULL, *buffer_tmp = NULL;
+    do {
+        if(size + TXT_READ_BLOCK > capacity) {
+            capacity = (capacity == 0) ? TXT_READ_BLOCK : (capacity << 1);
+            if((buffer_tmp = (char *)realloc(buffer, capacity)) == NULL) {
+                free(buffer);
+                fclose(file_p);
+                return 1;
+            }
+            buffer = buffer_tmp;
+        }
+        bytes_read = fread(buffer + size, 1, TXT_READ_BLOCK, file_p);
+        size += bytes_read;
+    } while(bytes_read == TXT_READ_BLOCK);
+    if(ferror(file_p)) {
+        free(buffer);
+        fclose(file_p);
+        return 5;
+    }
+    fclose(file_p);
+    view->data = buffer;
+    view->size = size;
+    return 0;
+}
+
+static void unmap_file_view(file_view *view) {
+    if(view->data == NULL) {
+        return;
+    }
+#ifdef DATA_IO_MMAP
+    if(view->is_mapped) {
+        munmap((void *)view->data, view->size);
+        view->data = NULL;
+        return;
+    }
+#endif
+    free((void *)view->data);
+    view->data = NULL;
+}
+
+/* Classify up to 64 bytes: bit k is set if ptr[k] is a digit 0~9. */
+static uint64_t digit_mask_tail(const char *ptr, size_t num_bytes) {
+    uint64_t mask = 0;
+    for(size_t k = 0; k < num_bytes; k++) {
+        if(ptr[k] >= '0' && ptr[k] <= '9') {
+            mask |= ((uint64_t)1 << k);
+        }
+    }
+    return mask;
+}
+
+static uint64_t digit_mask_64(const char *ptr) {
+#if defined(__SSE2__)
+    const __m128i ascii_zero = _mm_set1_epi8('0');
+    const __m128i nine = _mm_set1_epi8(9);
+    uint64_t mask = 0;
+    for(int k = 0; k < 4; k++) {
+        /* A byte is a digit if (byte - '0') <= 9 as an unsigned number. */
+        __m128i shifted = _mm_sub_epi8(_mm_loadu_si128((const __m128i *)(ptr + 16 * k)), ascii_zero);
+        __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(shifted, nine), shifted);
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_digit) << (16 * k);
+    }
+    return mask;
+#else
+    return digit_mask_tail(ptr, 64);
+#endif
+}
+
+/* Convert 8 ascii digits (the first one in the lowest byte) with SWAR. */
+static uint32_t swar_parse_8_digits(uint64_t digits) {
+    digits = (digits & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+    digits = (digits & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+    return (uint32_t)((digits & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32);
+}
+
+/**
+ * @brief Convert the digit run base[token_start, token_end) to an integer.
+ *   A '-' right before the run negates it, as fscanf("%d") would do.
+ *   Values out of the 32bit range wrap around.
+ */
+static uint32_t parse_csv_token(const char *base, size_t token_start, size_t token_end) {
+    size_t token_length = token_end - token_start;
+    uint64_t value = 0;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    if(token_end >= 8) {
+        uint64_t digits = 0, padding = 0;
+        size_t i = token_start;
+        if(token_length > 8) {
+            for(; i < token_end - 8; i++) {
+                value = value * 10 + (uint64_t)(base[i] - '0');
+            }
+            value *= 100000000;
+        }
+        else {
+            /* Replace the bytes before the token with '0's. */
+            padding = ((uint64_t)1 << ((8 - token_length) << 3)) - 1;
+        }
+        memcpy(&digits, base + token_end - 8, sizeof(uint64_t));
+        digits = (digits & ~padding) | (0x3030303030303030ULL & padding);
+        value += swar_parse_8_digits(digits);
+    }
+    else
+#endif
+    {
+        for(size_t i = token_start; i < token_end; i++) {
+            value = value * 10 + (uint64_t)(base[i] - '0');
+        }
+    }
+    if(token_start > 0 && base[token_start - 1] == '-') {
+        value = 0 - value;
+    }
+    return (uint32_t)value;
+}
+
+/* Pass 1: count the digit runs of a chunk. */
+static void *csv_count_chunk(void *arg) {
+    csv_chunk *chunk = (csv_chunk *)arg;
+    const char *ptr = chunk->base + chunk->chunk_start;
+    size_t length = chunk->chunk_end - chunk->chunk_start, pos = 0;
+    uint64_t mask = 0, prev_bit = 0, count = 0;
+    for(pos = 0; pos < length; pos += 64) {
+        mask = (length - pos >= 64) ? digit_mask_64(ptr + pos) : digit_mask_tail(ptr + pos, length - pos);
+        count += popcount_u64(mask & ~((mask << 1) | prev_bit));
+        prev_bit = mask >> 63;
+    }
+    chunk->num_elems = count;
+    return NULL;
+}
+
+/* Pass 2: convert the digit runs of a chunk to its slice of the output. */
+static void *csv_parse_chunk(void *arg) {
+    csv_chunk *chunk = (csv_chunk *)arg;
+    size_t start = chunk->chunk_start, length = chunk->chunk_end - chunk->chunk_start;
+    size_t pos = 0, token_start = 0, num_bytes = 0;
+    uint64_t mask = 0, transitions = 0, in_token = 0, j = 0;
+    for(pos = 0; pos < length; pos += 64) {
+        num_bytes = (length - pos >= 64) ? 64 : (length - pos);
+        mask = (num_bytes == 64) ? digit_mask_64(chunk->base + start + pos) : digit_mask_tail(chunk->base + start + pos, num_bytes);
+        /* Every set bit is where a digit run starts or ends. */
+        transitions = mask ^ ((mask << 1) | in_token);
+        if(num_bytes < 64) {
+            transitions &= ((uint64_t)1 << num_bytes) - 1;
+        }
+        while(transitions != 0) {
+            size_t token_pos = start + pos + ctz_u64(transitions);
+            transitions &= transitions - 1;
+            if(in_token == 0) {
+                token_start = token_pos;
+            }
+            else {
+                chunk->output_arr[j++] = parse_csv_token(chunk->base, token_start, token_pos);
+            }
+            in_token ^= 1;
+        }
+    }
+    if(in_token != 0) {
+        chunk->output_arr[j++] = parse_csv_token(chunk->base, token_start, start + length);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Parse a csv view to an integer array in parallel. The view is
+ *   split into chunks at '\n' boundaries, every chunk is counted, then
+ *   parsed directly to its offset of the output, so the results are
+ *   concatenated in order without extra copies.
+ */
+static uint32_t* parse_csv_view(const file_view *view, uint64_t *num_elems_read, int *err_flag) {
+    uint32_t num_chunks = get_num_threads();
+    uint64_t num_elems_total = 0;
+    if(num_chunks > view->size / CSV_CHUNK_MIN_SIZE) {
+        num_chunks = (uint32_t)(view->size / CSV_CHUNK_MIN_SIZE);
+    }
+    if(num_chunks < 1) {
+        num_chunks = 1;
+    }
+    csv_chunk *chunks = (csv_chunk *)calloc(num_chunks, sizeof(csv_chunk));
+    if(chunks == NULL) {
+        *err_flag = 1;
+        return NULL;
+    }
+    size_t prev_end = 0;
+    for(uint32_t i = 0; i < num_chunks; i++) {
+        size_t chunk_end = view->size;
+        if(i + 1 < num_chunks) {
+            chunk_end = (size_t)((uint64_t)view->size * (i + 1) / num_chunks);
+            if(chunk_end < prev_end) {
+                chunk_end = prev_end;
+            }
+            const char *newline = (const char *)memchr(view->data + chunk_end, '\n', view->size - chunk_end);
+            chunk_end = (newline == NULL) ? view->size : (size_t)(newline - view->data) + 1;
+        }
+        chunks[i].base = view->data;
+        chunks[i].chunk_start = prev_end;
+        chunks[i].chunk_end = chunk_end;
+        prev_end = chunk_end;
+    }
+    run_parallel_tasks(csv_count_chunk, chunks, sizeof(csv_chunk), num_chunks);
+    for(uint32_t i = 0; i < num_chunks; i++) {
+        num_elems_total += chunks[i].num_elems;
+    }
+    uint32_t *array = (uint32_t *)malloc((num_elems_total > 0 ? num_elems_total : 1) * sizeof(uint32_t));
+    if(array == NULL) {
+        free(chunks);
+        *err_flag = 1;
+        return NULL;
+    }
+    uint64_t offset = 0;
+    for(uint32_t i = 0; i < num_chunks; i++) {
+        chunks[i].output_arr = array + offset;
+        offset += chunks[i].num_elems;
+    }
+    run_parallel_tasks(csv_parse_chunk, chunks, sizeof(csv_chunk), num_chunks);
+    free(chunks);
+    *num_elems_read = num_elems_total;
+    return array;
+}
+
+/* A range of an array formatted to csv lines at a fixed file offset. */
+typedef struct {
+    const uint32_t *array;
+    uint64_t range_start;
+    uint64_t range_end;
+    uint64_t file_offset;
+    uint64_t num_bytes;
+    int fd;
+    int err_flag;
+} csv_range;
+
+static const char digit_pairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static uint32_t u32_text_length(uint32_t value) {
+    if(value < 100000) {
+        return (value < 10) ? 1 : (value < 100) ? 2 : (value < 1000) ? 3 : (value < 10000) ? 4 : 5;
+    }
+    return (value < 1000000) ? 6 : (value < 10000000) ? 7 : (value < 100000000) ? 8 : (value < 1000000000) ? 9 : 10;
+}
+
+/* Write a value and a '\n' to dst, 2 digits per step. Returns the end. */
+static char* format_u32_line(char *dst, uint32_t value) {
+    uint32_t length = u32_text_length(value);
+    char *ptr = dst + length;
+    *ptr = '\n';
+    while(value >= 100) {
+        ptr -= 2;
+        memcpy(ptr, digit_pairs + (value % 100) * 2, 2);
+        value /= 100;
+    }
+    if(value >= 10) {
+        ptr -= 2;
+        memcpy(ptr, digit_pairs + value * 2, 2);
+    }
+    else {
+        *(--ptr) = (char)('0' + value);
+    }
+    return dst + length + 1;
+}
+
+#ifdef DATA_IO_MMAP
+/* Pass 1: count the bytes of a range. */
+static void *csv_measure_range(void *arg) {
+    csv_range *range = (csv_range *)arg;
+    uint64_t num_bytes = 0;
+    for(uint64_t i = range->range_start; i < range->range_end; i++) {
+        num_bytes += u32_text_length(range->array[i]) + 1;
+    }
+    range->num_bytes = num_bytes;
+    return NULL;
+}
+
+/* Pass 2: format a range block by block and write it at its offset. */
+static void *csv_write_range(void *arg) {
+    csv_range *range = (csv_range *)arg;
+    uint64_t file_offset = range->file_offset, i = range->range_start;
+    char *buffer = (char *)malloc(CSV_WRITE_BLOCK);
+    if(buffer == NULL) {
+        range->err_flag = 1;
+        return NULL;
+    }
+    while(i < range->range_end) {
+        char *ptr = buffer;
+        /* A line takes 11 bytes at most. */
+        for(; i < range->range_end && ptr + 11 <= buffer + CSV_WRITE_BLOCK; i++) {
+            ptr = format_u32_line(ptr, range->array[i]);
+        }
+        size_t num_bytes = (size_t)(ptr - buffer), bytes_written = 0;
+        while(bytes_written < num_bytes) {
+            ssize_t res = pwrite(range->fd, buffer + bytes_written, num_bytes - bytes_written, (off_t)(file_offset + bytes_written));
+            if(res <= 0) {
+                range->err_flag = 1;
+                free(buffer);
+                return NULL;
+            }
+            bytes_written += (size_t)res;
+        }
+        file_offset += num_bytes;
+    }
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * @brief Export an array to csv in parallel: every thread measures its
+ *   range, the file offsets are the prefix sums of the lengths, then every
+ *   thread formats its range and writes it at the precomputed offset.
+ */
+static int export_csv_parallel(const char *target_file, const uint32_t *array, uint64_t num_elems, uint32_t num_ranges) {
+    csv_range *ranges = (csv_range *)calloc(num_ranges, sizeof(csv_range));
+    if(ranges == NULL) {
+        return 1;
+    }
+    int fd = open(target_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        free(ranges);
+        return -1;
+    }
+    for(uint32_t i = 0; i < num_ranges; i++) {
+        ranges[i].array = array;
+        ranges[i].range_start = num_elems * i / num_ranges;
+        ranges[i].range_end = num_elems * (i + 1) / num_ranges;
+        ranges[i].fd = fd;
+    }
+    run_parallel_tasks(csv_measure_range, ranges, sizeof(csv_range), num_ranges);
+    uint64_t file_offset = 0;
+    for(uint32_t i = 0; i < num_ranges; i++) {
+        ranges[i].file_offset = file_offset;
+        file_offset += ranges[i].num_bytes;
+    }
+    int err_flag = (ftruncate(fd, (off_t)file_offset) == 0) ? 0 : 1;
+    if(err_flag == 0) {
+        run_parallel_tasks(csv_write_range, ranges, sizeof(csv_range), num_ranges);
+        for(uint32_t i = 0; i < num_ranges; i++) {
+            err_flag |= ranges[i].err_flag;
+        }
+    }
+    if(close(fd) != 0) {
+        err_flag = 1;
+    }
+    free(ranges);
+    return err_flag;
+}
+#endif
+
+/* Reader state of a btc file. */
+typedef struct {
+    FILE *file_p;
+    uint64_t num_elems;
+    uint64_t num_decoded;
+    uint64_t checksum;
+    uint64_t sum_a;
+    uint64_t sum_b;
+    uint32_t payload[BTC_BLOCK_ELEMS];
+} btc_reader;
+
+/* Fletcher-64 over 32bit words, reduced once per call (<= 1 block). */
+static void btc_checksum_update(uint64_t *sum_a, uint64_t *sum_b, const uint32_t *values, uint32_t num_values) {
+    uint64_t a = *sum_a, b = *sum_b;
+    for(uint32_t i = 0; i < num_values; i++) {
+        a += values[i];
+        b += a;
+    }
+    *sum_a = a % 0xFFFFFFFF;
+    *sum_b = b % 0xFFFFFFFF;
+}
+
+static void btc_pack_lanes(const uint32_t *offsets, uint32_t bit_width, uint32_t *payload) {
+    memset(payload, 0, bit_width * (BTC_BLOCK_ELEMS / 32) * sizeof(uint32_t));
+    if(bit_width == 0) {
+        return;
+    }
+    for(uint32_t k = 0; k < BTC_BLOCK_ELEMS / 4; k++) {
+        uint32_t bit_pos = k * bit_width, word = bit_pos >> 5, shift = bit_pos & 31;
+        for(uint32_t lane = 0; lane < 4; lane++) {
+            uint32_t offset = offsets[(k << 2) + lane];
+            payload[(word << 2) + lane] |= offset << shift;
+            if(shift + bit_width > 32) {
+                payload[((word + 1) << 2) + lane] |= offset >> (32 - shift);
+            }
+        }
+    }
+}
+
+/* Decode a whole block (BTC_BLOCK_ELEMS values) to output, 4 lanes per step. */
+static void btc_unpack_lanes(const uint32_t *payload, uint32_t bit_width, uint32_t codec, uint32_t base, uint32_t *output) {
+    uint32_t mask = (bit_width == 32) ? 0xFFFFFFFF : (((uint32_t)1 << bit_width) - 1);
+#if defined(__SSE2__)
+    const __m128i mask_vec = _mm_set1_epi32((int)mask);
+    const __m128i base_vec = _mm_set1_epi32((int)base);
+    __m128i offset_vec = _mm_setzero_si128(), acc_vec = base_vec;
+    for(uint32_t k = 0; k < BTC_BLOCK_ELEMS / 4; k++) {
+        if(bit_width != 0) {
+            uint32_t bit_pos = k * bit_width, word = bit_pos >> 5, shift = bit_pos & 31;
+            offset_vec = _mm_srl_epi32(_mm_loadu_si128((const __m128i *)(payload + (word << 2))), _mm_cvtsi32_si128((int)shift));
+            if(shift + bit_width > 32) {
+                offset_vec = _mm_or_si128(offset_vec, _mm_sll_epi32(_mm_loadu_si128((const __m128i *)(payload + ((word + 1) << 2))), _mm_cvtsi32_si128((int)(32 - shift))));
+            }
+            offset_vec = _mm_and_si128(offset_vec, mask_vec);
+        }
+        acc_vec = _mm_add_epi32((codec == BTC_CODEC_DELTA) ? acc_vec : base_vec, offset_vec);
+        _mm_storeu_si128((__m128i *)(output + (k << 2)), acc_vec);
+    }
+#else
+    uint32_t acc[4] = {base, base, base, base};
+    for(uint32_t k = 0; k < BTC_BLOCK_ELEMS / 4; k++) {
+        uint32_t bit_pos = k * bit_width, word = bit_pos >> 5, shift = bit_pos & 31;
+        for(uint32_t lane = 0; lane < 4; lane++) {
+            uint32_t offset = 0;
+            if(bit_width != 0) {
+                offset = payload[(word << 2) + lane] >> shift;
+                if(shift + bit_width > 32) {
+                    offset |= payload[((word + 1) << 2) + lane] << (32 - shift);
+                }
+                offset &= mask;
+            }
+            acc[lane] = ((codec == BTC_CODEC_DELTA) ? acc[lane] : base) + offset;
+            output[(k << 2) + lane] = acc[lane];
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Encode up to BTC_BLOCK_ELEMS values to a block. Sorted blocks are
+ *   delta-encoded if that takes fewer bits than frame-of-reference.
+ * 
+ * @returns
+ *  The number of bytes of the block (header + payload)
+ */
+static size_t btc_encode_block(const uint32_t *values, uint32_t num_values, uint8_t *block) {
+    uint32_t padded[BTC_BLOCK_ELEMS], offsets[BTC_BLOCK_ELEMS];
+    uint32_t min_value = values[0], max_value = values[0], max_delta = 0;
+    uint32_t bit_width = 0, base = 0;
+    uint8_t codec = BTC_CODEC_FOR;
+    int is_sorted = 1;
+    for(uint32_t i = 0; i < BTC_BLOCK_ELEMS; i++) {
+        /* Padding with the last value keeps both the order and the minimum. */
+        padded[i] = (i < num_values) ? values[i] : values[num_values - 1];
+        if(padded[i] < min_value) {
+            min_value = padded[i];
+        }
+        if(padded[i] > max_value) {
+            max_value = padded[i];
+        }
+        if(i > 0 && padded[i] < padded[i - 1]) {
+            is_sorted = 0;
+        }
+    }
+    bit_width = bit_width_u32(max_value - min_value);
+    base = min_value;
+    if(is_sorted) {
+        for(uint32_t i = 4; i < BTC_BLOCK_ELEMS; i++) {
+            if(padded[i] - padded[i - 4] > max_delta) {
+                max_delta = padded[i] - padded[i - 4];
+            }
+        }
+        if(padded[3] - padded[0] > max_delta) {
+            max_delta = padded[3] - padded[0];
+        }
+        if(bit_width_u32(max_delta) < bit_width) {
+            codec = BTC_CODEC_DELTA;
+            bit_width = bit_width_u32(max_delta);
+            base = padded[0];
+        }
+    }
+    for(uint32_t i = 0; i < BTC_BLOCK_ELEMS; i++) {
+        if(codec == BTC_CODEC_DELTA) {
+            offsets[i] = padded[i] - ((i < 4) ? base : padded[i - 4]);
+        }
+        else {
+            offsets[i] = padded[i] - base;
+        }
+    }
+    uint16_t block_elems = (uint16_t)num_values;
+    block[0] = codec;
+    block[1] = (uint8_t)bit_width;
+    memcpy(block + 2, &block_elems, sizeof(uint16_t));
+    memcpy(block + 4, &base, sizeof(uint32_t));
+    btc_pack_lanes(offsets, bit_width, (uint32_t *)(block + BTC_BLOCK_HEADER));
+    return BTC_BLOCK_HEADER + bit_width * (BTC_BLOCK_ELEMS / 32) * sizeof(uint32_t);
+}
+
+/**
+ * @brief Export an array to a btc file.
+ * 
+ * @returns
+ *  -1 if failed to open the file
+ *   1 if failed to write the file
+ *   0 if succeeded
+ */
+static int export_btc(const char *target_file, const uint32_t *array, uint64_t num_elems) {
+    uint8_t header[BTC_HEADER_SIZE] = {0};
+    uint32_t block_words[(BTC_BLOCK_HEADER + BTC_BLOCK_ELEMS * sizeof(uint32_t)) / sizeof(uint32_t)];
+    uint64_t sum_a = 0, sum_b = 0, checksum = 0;
+    uint16_t block_elems = BTC_BLOCK_ELEMS;
+    int is_sorted = 1, err_flag = 0;
+    FILE *file_p = fopen(target_file, "wb+");
+    if(file_p == NULL) {
+        return -1;
+    }
+    if(fwrite(header, 1, BTC_HEADER_SIZE, file_p) != BTC_HEADER_SIZE) {
+        err_flag = 1;
+    }
+    for(uint64_t i = 0; i < num_elems && err_flag == 0; i += BTC_BLOCK_ELEMS) {
+        uint32_t num_values = (num_elems - i < BTC_BLOCK_ELEMS) ? (uint32_t)(num_elems - i) : BTC_BLOCK_ELEMS;
+        for(uint32_t k = (i == 0) ? 1 : 0; k < num_values && is_sorted; k++) {
+            if(array[i + k] < array[i + k - 1]) {
+                is_sorted = 0;
+            }
+        }
+        btc_checksum_update(&sum_a, &sum_b, array + i, num_values);
+        size_t block_size = btc_encode_block(array + i, num_values, (uint8_t *)block_words);
+        if(fwrite(block_words, 1, block_size, file_p) != block_size) {
+            err_flag = 1;
+        }
+    }
+    checksum = (sum_b << 32) | sum_a;
+    memcpy(header, "BTC1", 4);
+    header[4] = sizeof(uint32_t);
+    header[5] = is_sorted ? BTC_FLAG_SORTED : 0;
+    memcpy(header + 6, &block_elems, sizeof(uint16_t));
+    memcpy(header + 8, &num_elems, sizeof(uint64_t));
+    memcpy(header + 16, &checksum, sizeof(uint64_t));
+    if(err_flag == 0 && (fseek(file_p, 0, SEEK_SET) != 0 || fwrite(header, 1, BTC_HEADER_SIZE, file_p) != BTC_HEADER_SIZE)) {
+        err_flag = 1;
+    }
+    if(fclose(file_p) != 0) {
+        err_flag = 1;
+    }
+    return err_flag;
+}
+
+/**
+ * @returns
+ *  -1 if failed to open the file
+ *   3 if the file is truncated
+ *  11 if the header is invalid
+ *   0 if succeeded
+ */
+static int btc_reader_open(btc_reader *reader, const char *source_file) {
+    uint8_t header[BTC_HEADER_SIZE];
+    uint16_t block_elems = 0;
+    memset(reader, 0, sizeof(btc_reader));
+    if((reader->file_p = fopen(source_file, "rb")) == NULL) {
+        return -1;
+    }
+    setvbuf(reader->file_p, NULL, _IOFBF, TXT_READ_BLOCK);
+    if(fread(header, 1, BTC_HEADER_SIZE, reader->file_p) != BTC_HEADER_SIZE) {
+        fclose(reader->file_p);
+        return 3;
+    }
+    memcpy(&block_elems, header + 6, sizeof(uint16_t));
+    memcpy(&reader->num_elems, header + 8, sizeof(uint64_t));
+    memcpy(&reader->checksum, header + 16, sizeof(uint64_t));
+    if(memcmp(header, "BTC1", 4) != 0 || header[4] != sizeof(uint32_t) || block_elems != BTC_BLOCK_ELEMS) {
+        fclose(reader->file_p);
+        return 11;
+    }
+    return 0;
+}
+
+/**
+ * @brief Decode the next block to output, which must be able to hold 
+ *   BTC_BLOCK_ELEMS values. The checksum is verified after the last block.
+ * 
+ * @returns
+ *   3 if the file is truncated
+ *   9 if the checksum mismatches
+ *  11 if the block is invalid
+ *   0 if succeeded
+ */
+static int btc_reader_next(btc_reader *reader, uint32_t *output, uint32_t *num_values) {
+    uint8_t block_header[BTC_BLOCK_HEADER];
+    uint16_t block_elems = 0;
+    uint32_t base = 0;
+    *num_values = 0;
+    if(fread(block_header, 1, BTC_BLOCK_HEADER, reader->file_p) != BTC_BLOCK_HEADER) {
+        return 3;
+    }
+    memcpy(&block_elems, block_header + 2, sizeof(uint16_t));
+    memcpy(&base, block_header + 4, sizeof(uint32_t));
+    if(block_header[0] > BTC_CODEC_DELTA || block_header[1] > 32 || block_elems < 1 || block_elems > BTC_BLOCK_ELEMS || block_elems > reader->num_elems - reader->num_decoded) {
+        return 11;
+    }
+    size_t num_words = block_header[1] * (BTC_BLOCK_ELEMS / 32);
+    if(fread(reader->payload, sizeof(uint32_t), num_words, reader->file_p) != num_words) {
+        return 3;
+    }
+    btc_unpack_lanes(reader->payload, block_header[1], block_header[0], base, output);
+    btc_checksum_update(&reader->sum_a, &reader->sum_b, output, block_elems);
+    reader->num_decoded += block_elems;
+    *num_values = block_elems;
+    if(reader->num_decoded == reader->num_elems && ((reader->sum_b << 32) | reader->sum_a) != reader->checksum) {
+        return 9;
+    }
+    return 0;
+}
+
+static uint32_t* import_btc(const char *source_file, uint64_t *num_elems_read, int *err_flag) {
+    btc_reader reader;
+    uint32_t block[BTC_BLOCK_ELEMS], num_values = 0;
+    if((*err_flag = btc_reader_open(&reader, source_file)) != 0) {
+        return NULL;
+    }
+    uint32_t *array = (uint32_t *)malloc((reader.num_elems > 0 ? reader.num_elems : 1) * sizeof(uint32_t));
+    if(array == NULL) {
+        *err_flag = 1;
+        fclose(reader.file_p);
+        return NULL;
+    }
+    while(reader.num_decoded < reader.num_elems) {
+        uint64_t pos = reader.num_decoded;
+        /* Decode in place unless the padding would overflow the array. */
+        int in_place = (reader.num_elems - pos >= BTC_BLOCK_ELEMS);
+        if((*err_flag = btc_reader_next(&reader, in_place ? (array + pos) : block, &num_values)) != 0) {
+            free(array);
+            fclose(reader.file_p);
+            return NULL;
+        }
+        if(!in_place) {
+            memcpy(array + pos, block, num_values * sizeof(uint32_t));
+        }
+    }
+    fclose(reader.file_p);
+    *num_elems_read = reader.num_elems;
+    return array;
+}
+
+/* A buffer handed from the reader stage to the parse/insert stage. The 
+   STREAM_CARRY_SIZE bytes before data take the tail of the previous one. */
+typedef struct {
+    char *data;
+    size_t size;
+} stream_chunk;
+
+/* A bounded FIFO of chunks. */
+typedef struct {
+    stream_chunk slots[STREAM_NUM_CHUNKS];
+    uint32_t head;
+    uint32_t count;
+    int closed;
+    int drain_on_close; /* Keep popping the queued chunks after closed */
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} chunk_queue;
+
+typedef int (*stream_read_func)(void *source, char *dst, size_t capacity, size_t *size);
+typedef int (*value_sink)(void *sink_ctx, const uint32_t *values, uint64_t num_values);
+
+/* reader thread -> filled -> consumer -> empty -> reader thread */
+typedef struct {
+    chunk_queue filled;
+    chunk_queue empty;
+    char *buffers;
+    stream_read_func read_func;
+    void *source;
+    int reader_err;
+    pthread_t reader;
+} stream_pipe;
+
+#ifdef DATA_IO_URING
+/* A minimal io_uring instance driven by the raw syscalls. */
+typedef struct {
+    int ring_fd;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} uring_queue;
+#endif
+
+/* A plain file read from the reader thread by positional reads. */
+typedef struct {
+#ifdef DATA_IO_MMAP
+    int fd;
+#endif
+    uint64_t file_size;
+    uint64_t offset;
+#ifdef DATA_IO_URING
+    uring_queue ring;
+#endif
+} file_source;
+
+#if defined(DATA_IO_MMAP) && !defined(BTAS_WITH_ZLIB)
+/* A pipe, FIFO or terminal, read in order without zlib. The bytes peeked
+   at to detect gzip are handed out first. */
+typedef struct {
+    int fd;
+    char head[2];
+    size_t head_size;
+} fd_source;
+#endif
+
+typedef struct {
+    uint32_t *array;
+    uint64_t num_elems;
+    uint64_t capacity;
+} array_sink;
+
+typedef struct {
+    bitmap_tree tree;
+    uint32_t *output_arr;
+    uint64_t capacity;
+    uint64_t num_uniq;
+    int with_output;
+} tree_sink;
+
+/* Make sure an output array can take num_new more elems. */
+static int reserve_u32_array(uint32_t **array, uint64_t *capacity, uint64_t num_used, uint64_t num_new) {
+    if(num_used + num_new <= *capacity) {
+        return 0;
+    }
+    uint64_t capacity_target = (*capacity == 0) ? DEDUP_READ_BLOCK : *capacity;
+    while(capacity_target < num_used + num_new) {
+        capacity_target <<= 1;
+    }
+    uint32_t *tmp_realloc = (uint32_t *)realloc(*array, capacity_target * sizeof(uint32_t));
+    if(tmp_realloc == NULL) {
+        return 1;
+    }
+    *array = tmp_realloc;
+    *capacity = capacity_target;
+    return 0;
+}
+
+static int append_to_array(void *sink_ctx, const uint32_t *values, uint64_t num_values) {
+    array_sink *sink = (array_sink *)sink_ctx;
+    if(reserve_u32_array(&sink->array, &sink->capacity, sink->num_elems, num_values) != 0) {
+        return 1;
+    }
+    memcpy(sink->array + sink->num_elems, values, num_values * sizeof(uint32_t));
+    sink->num_elems += num_values;
+    return 0;
+}
+
+static int insert_to_tree(void *sink_ctx, const uint32_t *values, uint64_t num_values) {
+    tree_sink *sink = (tree_sink *)sink_ctx;
+    int err_flag = 0;
+    if(sink->with_output && reserve_u32_array(&sink->output_arr, &sink->capacity, sink->num_uniq, num_values) != 0) {
+        return 1;
+    }
+    sink->num_uniq += bitmap_tree_insert_arr(&sink->tree, values, num_values, sink->with_output ? (sink->output_arr + sink->num_uniq) : NULL, &err_flag);
+    return err_flag;
+}
+
+static void chunk_queue_init(chunk_queue *queue, int drain_on_close) {
+    queue->head = 0;
+    queue->count = 0;
+    queue->closed = 0;
+    queue->drain_on_close = drain_on_close;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+}
+
+static void chunk_queue_destroy(chunk_queue *queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->changed);
+}
+
+/* The queues hold all the chunks of a pipe, so a push never blocks. */
+static void chunk_queue_push(chunk_queue *queue, stream_chunk chunk) {
+    pthread_mutex_lock(&queue->lock);
+    if(!queue->closed && queue->count < STREAM_NUM_CHUNKS) {
+        queue->slots[(queue->head + queue->count) % STREAM_NUM_CHUNKS] = chunk;
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Take a chunk from a queue, blocking until one is available if
+ *   wait is non-zero.
+ * 
+ * @returns
+ *  -1 if the queue is closed
+ *   0 if no chunk is available (only if wait is 0)
+ *   1 if a chunk is taken
+ */
+static int chunk_queue_take(chunk_queue *queue, stream_chunk *chunk, int wait) {
+    pthread_mutex_lock(&queue->lock);
+    while(wait && queue->count == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    if(queue->closed && (queue->count == 0 || !queue->drain_on_close)) {
+        pthread_mutex_unlock(&queue->lock);
+        return -1;
+    }
+    if(queue->count == 0) {
+        pthread_mutex_unlock(&queue->lock);
+        return 0;
+    }
+    *chunk = queue->slots[queue->head];
+    queue->head = (queue->head + 1) % STREAM_NUM_CHUNKS;
+    queue->count--;
+    pthread_mutex_unlock(&queue->lock);
+    return 1;
+}
+
+static void chunk_queue_close(chunk_queue *queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void *stream_reader_thread(void *arg) {
+    stream_pipe *pipe = (stream_pipe *)arg;
+    stream_chunk chunk;
+    size_t size = 0;
+    while(chunk_queue_take(&pipe->empty, &chunk, 1) == 1) {
+        if((pipe->reader_err = pipe->read_func(pipe->source, chunk.data, STREAM_CHUNK_SIZE, &size)) != 0 || size == 0) {
+            break;
+        }
+        chunk.size = size;
+        chunk_queue_push(&pipe->filled, chunk);
+    }
+    chunk_queue_close(&pipe->filled);
+    return NULL;
+}
+
+#ifdef DATA_IO_URING
+static int uring_queue_init(uring_queue *ring, unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    memset(ring, 0, sizeof(uring_queue));
+    long ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(ring_fd < 0) {
+        return -1;
+    }
+    ring->ring_fd = (int)ring_fd;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        if(ring->cq_ring_size > ring->sq_ring_size) {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->cq_ring_size = 0;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    ring->cq_ring = (ring->cq_ring_size == 0) ? ring->sq_ring : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+    ring->sqes = (struct io_uring_sqe *)mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if(ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || (void *)ring->sqes == MAP_FAILED) {
+        if(ring->sq_ring != MAP_FAILED) {
+            munmap(ring->sq_ring, ring->sq_ring_size);
+        }
+        if(ring->cq_ring_size != 0 && ring->cq_ring != MAP_FAILED) {
+            munmap(ring->cq_ring, ring->cq_ring_size);
+        }
+        if((void *)ring->sqes != MAP_FAILED) {
+            munmap(ring->sqes, ring->sqes_size);
+        }
+        close(ring->ring_fd);
+        return -1;
+    }
+    ring->sq_tail = (unsigned *)((char *)ring->sq_ring + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)((char *)ring->sq_ring + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)((char *)ring->sq_ring + params.sq_off.array);
+    ring->cq_head = (unsigned *)((char *)ring->cq_ring + params.cq_off.head);
+    ring->cq_tail = (unsigned *)((char *)ring->cq_ring + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)((char *)ring->cq_ring + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)((char *)ring->cq_ring + params.cq_off.cqes);
+    return 0;
+}
+
+static void uring_queue_exit(uring_queue *ring) {
+    munmap(ring->sqes, ring->sqes_size);
+    if(ring->cq_ring_size != 0) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    munmap(ring->sq_ring, ring->sq_ring_size);
+    close(ring->ring_fd);
+}
+
+static void uring_prep_readv(uring_queue *ring, int fd, const struct iovec *iov, uint64_t offset, uint64_t user_data) {
+    unsigned tail = *ring->sq_tail, index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = 1;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief The io_uring reader stage: keeps up to STREAM_NUM_CHUNKS large
+ *   reads in flight and hands the chunks over in file order as soon as 
+ *   they complete. The kernel reads straight into the chunk buffers.
+ */
+static void *uring_reader_thread(void *arg) {
+    stream_pipe *pipe = (stream_pipe *)arg;
+    file_source *file = (file_source *)pipe->source;
+    uring_queue *ring = &file->ring;
+    stream_chunk slots[STREAM_NUM_CHUNKS], chunk;
+    struct iovec iovecs[STREAM_NUM_CHUNKS];
+    uint64_t offsets[STREAM_NUM_CHUNKS];
+    uint8_t done[STREAM_NUM_CHUNKS];
+    uint64_t next_seq = 0, deliver_seq = 0;
+    unsigned in_flight = 0, to_submit = 0;
+    int stopped = 0;
+    for(;;) {
+        /* Queue a read for every free chunk. Only wait for one if idle. */
+        while(!stopped && file->offset < file->file_size && in_flight < STREAM_NUM_CHUNKS) {
+            int take_res = chunk_queue_take(&pipe->empty, &chunk, in_flight == 0);
+            if(take_res <= 0) {
+                stopped = (take_res < 0);
+                break;
+            }
+            uint32_t slot = (uint32_t)(next_seq % STREAM_NUM_CHUNKS);
+            chunk.size = (file->file_size - file->offset < STREAM_CHUNK_SIZE) ? (size_t)(file->file_size - file->offset) : STREAM_CHUNK_SIZE;
+            slots[slot] = chunk;
+            offsets[slot] = file->offset;
+            done[slot] = 0;
+            iovecs[slot].iov_base = chunk.data;
+            iovecs[slot].iov_len = chunk.size;
+            uring_prep_readv(ring, file->fd, &iovecs[slot], file->offset, next_seq);
+            file->offset += chunk.size;
+            next_seq++;
+            in_flight++;
+            to_submit++;
+        }
+        if(in_flight == 0) {
+            break;
+        }
+        long enter_res = syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if(enter_res < 0) {
+            if(errno == EINTR || errno == EAGAIN) {
+                continue;
+            }
+            pipe->reader_err = 5;
+            break;
+        }
+        to_submit -= (enter_res < (long)to_submit) ? (unsigned)enter_res : to_submit;
+        unsigned head = *ring->cq_head, tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        for(; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            uint32_t slot = (uint32_t)(cqe->user_data % STREAM_NUM_CHUNKS);
+            size_t bytes_read = (cqe->res > 0) ? (size_t)cqe->res : 0;
+            if(cqe->res < 0) {
+                pipe->reader_err = 5;
+            }
+            /* Short reads are rare on regular files; finish them inline. */
+            while(pipe->reader_err == 0 && bytes_read < slots[slot].size) {
+                ssize_t pread_res = pread(file->fd, slots[slot].data + bytes_read, slots[slot].size - bytes_read, (off_t)(offsets[slot] + bytes_read));
+                if(pread_res <= 0 && !(pread_res < 0 && errno == EINTR)) {
+                    pipe->reader_err = 5;
+                }
+                bytes_read += (pread_res > 0) ? (size_t)pread_res : 0;
+            }
+            done[slot] = 1;
+            in_flight--;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        stopped |= (pipe->reader_err != 0);
+        while(deliver_seq < next_seq && done[deliver_seq % STREAM_NUM_CHUNKS]) {
+            if(!stopped) {
+                chunk_queue_push(&pipe->filled, slots[deliver_seq % STREAM_NUM_CHUNKS]);
+            }
+            deliver_seq++;
+        }
+    }
+    chunk_queue_close(&pipe->filled);
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Start a reader thread that fills up to STREAM_NUM_CHUNKS chunks
+ *   ahead of the consumer. The default routine (reader_routine NULL) 
+ *   calls read_func(source, ...) for every chunk.
+ * 
+ * @returns
+ *  1 if failed to allocate the buffers or to create the thread
+ *  0 if succeeded
+ */
+static int stream_pipe_start(stream_pipe *pipe, void *(*reader_routine)(void *), stream_read_func read_func, void *source) {
+    pipe->read_func = read_func;
+    pipe->source = source;
+    pipe->reader_err = 0;
+    pipe->buffers = NULL;
+#ifdef DATA_IO_MMAP
+    /* Page-aligned chunks suit the block layer (and O_DIRECT if wanted). */
+    void *aligned_buffers = NULL;
+    if(posix_memalign(&aligned_buffers, STREAM_DATA_OFFSET, (size_t)STREAM_NUM_CHUNKS * (STREAM_DATA_OFFSET + STREAM_CHUNK_SIZE)) == 0) {
+        pipe->buffers = (char *)aligned_buffers;
+    }
+#else
+    pipe->buffers = (char *)malloc((size_t)STREAM_NUM_CHUNKS * (STREAM_DATA_OFFSET + STREAM_CHUNK_SIZE));
+#endif
+    if(pipe->buffers == NULL) {
+        return 1;
+    }
+    chunk_queue_init(&pipe->filled, 1);
+    chunk_queue_init(&pipe->empty, 0);
+    for(uint32_t i = 0; i < STREAM_NUM_CHUNKS; i++) {
+        stream_chunk chunk;
+        chunk.data = pipe->buffers + (size_t)i * (STREAM_DATA_OFFSET + STREAM_CHUNK_SIZE) + STREAM_DATA_OFFSET;
+        chunk.size = 0;
+        chunk_queue_push(&pipe->empty, chunk);
+    }
+    if(pthread_create(&pipe->reader, NULL, (reader_routine != NULL) ? reader_routine : stream_reader_thread, pipe) != 0) {
+        chunk_queue_destroy(&pipe->filled);
+        chunk_queue_destroy(&pipe->empty);
+        free(pipe->buffers);
+        return 1;
+    }
+    return 0;
+}
+
+/* Stop the reader and release the pipe. Returns the reader error. */
+static int stream_pipe_finish(stream_pipe *pipe) {
+    chunk_queue_close(&pipe->empty);
+    pthread_join(pipe->reader, NULL);
+    chunk_queue_destroy(&pipe->filled);
+    chunk_queue_destroy(&pipe->empty);
+    free(pipe->buffers);
+    return pipe->reader_err;
+}
+
+/* The bytes at the end of a csv region that may belong to a cut token. */
+static size_t csv_tail_size(const char *region, size_t region_size) {
+    size_t tail = 0;
+    while(tail < region_size && region[region_size - 1 - tail] >= '0' && region[region_size - 1 - tail] <= '9') {
+        tail++;
+    }
+    if(tail < region_size && region[region_size - 1 - tail] == '-') {
+        tail++;
+    }
+    return tail;
+}
+
+/* Convert a csv region base[start, end) to values and feed them to a sink. */
+static int sink_csv_region(const char *base, size_t start, size_t end, uint32_t **values, uint64_t *values_capacity, value_sink sink, void *sink_ctx) {
+    csv_chunk chunk;
+    chunk.base = base;
+    chunk.chunk_start = start;
+    chunk.chunk_end = end;
+    csv_count_chunk(&chunk);
+    if(chunk.num_elems == 0) {
+        return 0;
+    }
+    if(reserve_u32_array(values, values_capacity, 0, chunk.num_elems) != 0) {
+        return 1;
+    }
+    chunk.output_arr = *values;
+    csv_parse_chunk(&chunk);
+    return sink(sink_ctx, *values, chunk.num_elems);
+}
+
+/**
+ * @brief Parse the chunks coming out of a pipe (csv text or raw binary
+ *   integers) and feed the values to a sink. A number or an integer cut 
+ *   at the end of a chunk is carried to the head of the next chunk.
+ * 
+ * @returns
+ *  0 if succeeded, or the error of the sink or of the reader
+ */
+static int consume_stream(stream_pipe *pipe, int is_csv, value_sink sink, void *sink_ctx) {
+    stream_chunk chunk;
+    char carry[STREAM_CARRY_SIZE + 1];
+    size_t carry_size = 0;
+    uint32_t *values = NULL;
+    uint64_t values_capacity = 0;
+    int err_flag = 0;
+    while(err_flag == 0 && chunk_queue_take(&pipe->filled, &chunk, 1) == 1) {
+        char *region = chunk.data - carry_size;
+        size_t region_size = carry_size + chunk.size;
+        memcpy(region, carry, carry_size);
+        size_t tail = is_csv ? csv_tail_size(region, region_size) : (region_size & 0x03);
+        if(tail >= STREAM_CARRY_SIZE) {
+            tail = 0; /* An absurdly long number gets split. */
+        }
+        size_t body = region_size - tail;
+        if(is_csv) {
+            /* Keep a stale '-' in front of the region from negating a number. */
+            region[-1] = '\n';
+            err_flag = sink_csv_region(chunk.data - STREAM_CARRY_SIZE, STREAM_CARRY_SIZE - carry_size, STREAM_CARRY_SIZE - carry_size + body, &values, &values_capacity, sink, sink_ctx);
+        }
+        else if(carry_size == 0 && ((uintptr_t)region & 0x03) == 0) {
+            err_flag = sink(sink_ctx, (const uint32_t *)region, body >> 2);
+        }
+        else if((err_flag = reserve_u32_array(&values, &values_capacity, 0, body >> 2)) == 0) {
+            memcpy(values, region, body);
+            err_flag = sink(sink_ctx, values, body >> 2);
+        }
+        memcpy(carry, region + body, tail);
+        carry_size = tail;
+        chunk_queue_push(&pipe->empty, chunk);
+    }
+    if(err_flag == 0 && is_csv && carry_size > 0) {
+        memmove(carry + 1, carry, carry_size);
+        carry[0] = '\n';
+        err_flag = sink_csv_region(carry, 1, carry_size + 1, &values, &values_capacity, sink, sink_ctx);
+    }
+    free(values);
+    int reader_err = stream_pipe_finish(pipe);
+    return (err_flag != 0) ? err_flag : reader_err;
+}
+
+#ifdef DATA_IO_MMAP
+static int read_file_chunk(void *source, char *dst, size_t capacity, size_t *size) {
+    file_source *file = (file_source *)source;
+    size_t bytes_read = 0;
+    while(bytes_read < capacity) {
+        ssize_t pread_res = pread(file->fd, dst + bytes_read, capacity - bytes_read, (off_t)(file->offset + bytes_read));
+        if(pread_res < 0 && errno == EINTR) {
+            continue;
+        }
+        if(pread_res < 0) {
+            *size = 0;
+            return 5;
+        }
+        if(pread_res == 0) {
+            break;
+        }
+        bytes_read += (size_t)pread_res;
+    }
+    file->offset += bytes_read;
+    *size = bytes_read;
+    return 0;
+}
+#else
+static int read_file_chunk(void *source, char *dst, size_t capacity, size_t *size) {
+    *size = fread(dst, 1, capacity, (FILE *)source);
+    return (*size < capacity && ferror((FILE *)source)) ? 5 : 0;
+}
+#endif
+
+#if defined(DATA_IO_MMAP) && !defined(BTAS_WITH_ZLIB)
+static int read_fd_chunk(void *source, char *dst, size_t capacity, size_t *size) {
+    fd_source *stream = (fd_source *)source;
+    size_t bytes_read = 0;
+    if(stream->head_size > 0 && capacity >= stream->head_size) {
+        memcpy(dst, stream->head, stream->head_size);
+        bytes_read = stream->head_size;
+        stream->head_size = 0;
+    }
+    /* Fill the chunk: a pipe returns whatever is buffered at the time. */
+    while(bytes_read < capacity) {
+        ssize_t read_res = read(stream->fd, dst + bytes_read, capacity - bytes_read);
+        if(read_res < 0 && errno == EINTR) {
+            continue;
+        }
+        if(read_res < 0) {
+            *size = 0;
+            return 5;
+        }
+        if(read_res == 0) {
+            break;
+        }
+        bytes_read += (size_t)read_res;
+    }
+    *size = bytes_read;
+    return 0;
+}
+#endif
+
+#ifdef BTAS_WITH_ZLIB
+static int read_gz_chunk(void *source, char *dst, size_t capacity, size_t *size) {
+    int bytes_read = gzread((gzFile)source, dst, (unsigned int)capacity);
+    if(bytes_read < 0) {
+        *size = 0;
+        return 5;
+    }
+    *size = (size_t)bytes_read;
+    return 0;
+}
+#endif
+
+/* Pipes and FIFOs can be read only once, and have no size to map. */
+static int is_regular_file(const char *source_file) {
+#ifdef DATA_IO_MMAP
+    struct stat file_stat;
+    return (stat(source_file, &file_stat) == 0 && S_ISREG(file_stat.st_mode));
+#else
+    (void)source_file;
+    return 1;
+#endif
+}
+
+/* Peeking would consume the head of a pipe, so only regular files are checked. */
+static int is_gzip_file(const char *source_file) {
+    unsigned char magic[2] = {0, 0};
+    if(!is_regular_file(source_file)) {
+        return 0;
+    }
+    FILE *file_p = fopen(source_file, "rb");
+    if(file_p == NULL) {
+        return 0;
+    }
+    size_t bytes_read = fread(magic, 1, 2, file_p);
+    fclose(file_p);
+    return (bytes_read == 2 && magic[0] == 0x1F && magic[1] == 0x8B);
+}
+
+#ifdef DATA_IO_MMAP
+/**
+ * @brief Stream a pipe or FIFO into a sink with plain reads, as it has
+ *   no size for the positional readers. A gzip stream is decompressed 
+ *   (with BTAS_WITH_ZLIB defined). Closes the fd.
+ * 
+ * @returns
+ *  13 if the stream is gzip-compressed but zlib is not built in
+ *   0 if succeeded, or the error of the sink or of the reader
+ */
+static int stream_fd_values(int fd, int is_csv, value_sink sink, void *sink_ctx) {
+    stream_pipe pipe;
+    int err_flag = 0;
+#ifdef BTAS_WITH_ZLIB
+    /* zlib passes a stream that isn't gzip through as it is. */
+    gzFile gz_file = gzdopen(fd, "rb");
+    if(gz_file == NULL) {
+        close(fd);
+        return 1;
+    }
+    gzbuffer(gz_file, STREAM_CHUNK_SIZE);
+    if((err_flag = stream_pipe_start(&pipe, NULL, read_gz_chunk, gz_file)) == 0) {
+        err_flag = consume_stream(&pipe, is_csv, sink, sink_ctx);
+    }
+    gzclose(gz_file);
+    return err_flag;
+#else
+    fd_source stream;
+    stream.fd = fd;
+    stream.head_size = 0;
+    while(stream.head_size < 2) {
+        ssize_t read_res = read(fd, stream.head + stream.head_size, 2 - stream.head_size);
+        if(read_res < 0 && errno == EINTR) {
+            continue;
+        }
+        if(read_res < 0) {
+            close(fd);
+            return 5;
+        }
+        if(read_res == 0) {
+            break;
+        }
+        stream.head_size += (size_t)read_res;
+    }
+    if(stream.head_size == 2 && (unsigned char)stream.head[0] == 0x1F && (unsigned char)stream.head[1] == 0x8B) {
+        close(fd);
+        return 13;
+    }
+    if((err_flag = stream_pipe_start(&pipe, NULL, read_fd_chunk, &stream)) == 0) {
+        err_flag = consume_stream(&pipe, is_csv, sink, sink_ctx);
+    }
+    close(fd);
+    return err_flag;
+#endif
+}
+#endif
+
+/**
+ * @brief Stream a csv or binary file into a sink. A gzip-compressed file
+ *   is decompressed by the reader thread, so inflating, parsing and 
+ *   inserting run as a pipeline.
+ * 
+ * @returns
+ *  -1 if failed to open the file
+ *  13 if the file is gzip-compressed but zlib is not built in
+ *   0 if succeeded, or the error of the sink or of the reader
+ */
+static int stream_file_values(const char *source_file, int is_csv, value_sink sink, void *sink_ctx) {
+    stream_pipe pipe;
+    int err_flag = 0;
+    if(is_gzip_file(source_file)) {
+#ifdef BTAS_WITH_ZLIB
+        gzFile gz_file = gzopen(source_file, "rb");
+        if(gz_file == NULL) {
+            return -1;
+        }
+        gzbuffer(gz_file, STREAM_CHUNK_SIZE);
+        if((err_flag = stream_pipe_start(&pipe, NULL, read_gz_chunk, gz_file)) == 0) {
+            err_flag = consume_stream(&pipe, is_csv, sink, sink_ctx);
+        }
+        gzclose(gz_file);
+        return err_flag;
+#else
+        return 13;
+#endif
+    }
+#ifdef DATA_IO_MMAP
+    file_source file;
+    struct stat file_stat;
+    void *(*reader_routine)(void *) = NULL;
+    if((file.fd = open(source_file, O_RDONLY)) < 0) {
+        return -1;
+    }
+    if(fstat(file.fd, &file_stat) != 0) {
+        close(file.fd);
+        return 5;
+    }
+    if(!S_ISREG(file_stat.st_mode)) {
+        return stream_fd_values(file.fd, is_csv, sink, sink_ctx);
+    }
+    file.file_size = (uint64_t)file_stat.st_size;
+    file.offset = 0;
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+#ifdef DATA_IO_URING
+    /* Fall back to the pread reader if io_uring is unavailable (e.g. 
+       blocked by a container's seccomp profile). */
+    if(uring_queue_init(&file.ring, STREAM_NUM_CHUNKS) == 0) {
+        reader_routine = uring_reader_thread;
+    }
+#endif
+    if((err_flag = stream_pipe_start(&pipe, reader_routine, read_file_chunk, &file)) == 0) {
+        err_flag = consume_stream(&pipe, is_csv, sink, sink_ctx);
+    }
+#ifdef DATA_IO_URING
+    if(reader_routine != NULL) {
+        uring_queue_exit(&file.ring);
+    }
+#endif
+    close(file.fd);
+#else
+    FILE *file_p = fopen(source_file, "rb");
+    if(file_p == NULL) {
+        return -1;
+    }
+    setvbuf(file_p, NULL, _IONBF, 0);
+    if((err_flag = stream_pipe_start(&pipe, NULL, read_file_chunk, file_p)) == 0) {
+        err_flag = consume_stream(&pipe, is_csv, sink, sink_ctx);
+    }
+    fclose(file_p);
+#endif
+    return err_flag;
+}
+
+/**
+ * @brief Stream a file into a BitTree. The uniques are appended to 
+ *   *output_arr (growing on demand) unless output_arr is NULL.
+ * 
+ * @returns
+ *  The number of the unique integers
+ */
+static uint64_t dedup_file_core(const char *source_file, const char* type, uint32_t **output_arr, int *err_flag) {
+    tree_sink sink;
+    sink.output_arr = NULL;
+    sink.capacity = 0;
+    sink.num_uniq = 0;
+    sink.with_output = (output_arr != NULL);
+    if((*err_flag = bitmap_tree_init(&sink.tree)) != 0) {
+        return 0;
+    }
+    if(type != NULL && strcmp(type, "btc") == 0) {
+        btc_reader reader;
+        uint32_t block[BTC_BLOCK_ELEMS], num_values = 0;
+        if((*err_flag = btc_reader_open(&reader, source_file)) == 0) {
+            while(reader.num_decoded < reader.num_elems) {
+                if((*err_flag = btc_reader_next(&reader, block, &num_values)) != 0) {
+                    break;
+                }
+                if((*err_flag = insert_to_tree(&sink, block, num_values)) != 0) {
+                    break;
+                }
+            }
+            fclose(reader.file_p);
+        }
+    }
+    else if(type != NULL && strcmp(type, "csv") == 0 && is_regular_file(source_file) && !is_gzip_file(source_file)) {
+        /* The parallel parser beats a streaming one on a plain csv file. */
+        uint64_t num_elems = 0;
+        uint32_t *array = import_1d_u32(source_file, type, &num_elems, err_flag);
+        if(array != NULL) {
+            *err_flag = insert_to_tree(&sink, array, num_elems);
+            free(array);
+        }
+    }
+    else {
+        *err_flag = stream_file_values(source_file, (type != NULL && strcmp(type, "csv") == 0), insert_to_tree, &sink);
+    }
+    bitmap_tree_free(&sink.tree);
+    if(output_arr != NULL) {
+        *output_arr = sink.output_arr;
+    }
+    return sink.num_uniq;
+}
+
 int export_1d_u32(const char *target_file, const char* type, uint32_t *array, uint64_t num_elems) {
     if(array == NULL || num_elems == 0) {
         return -3;
@@ -20,6 +1534,20 @@ int export_1d_u32(const char *target_file, const char* type, uint32_t *array, ui
     if(type != NULL && strcmp(type, "csv") == 0) {
         file_type_flag = 1;
     }
+    if(type != NULL && strcmp(type, "btc") == 0) {
+        return export_btc(target_file, array, num_elems);
+    }
+#ifdef DATA_IO_MMAP
+    if(file_type_flag == 1) {
+        uint32_t num_ranges = get_num_threads();
+        if(num_ranges > num_elems / CSV_EXPORT_RANGE_MIN) {
+            num_ranges = (uint32_t)(num_elems / CSV_EXPORT_RANGE_MIN);
+        }
+        if(num_ranges > 1) {
+            return export_csv_parallel(target_file, array, num_elems, num_ranges);
+        }
+    }
+#endif
     if(file_type_flag == 0) {
         file_p = fopen(target_file, "wb+");
     }
@@ -38,11 +1566,28 @@ int export_1d_u32(const char *target_file, const char* type, uint32_t *array, ui
         return 0;
     }
     else {
-        for(uint64_t i = 0; i < num_elems; i++) {
-            fprintf(file_p, "%d\n", array[i]);
+        char *buffer = (char *)malloc(CSV_WRITE_BLOCK);
+        if(buffer == NULL) {
+            fclose(file_p);
+            return 1;
         }
-        fclose(file_p);
-        return 0;
+        uint64_t i = 0;
+        int err_flag = 0;
+        while(i < num_elems && err_flag == 0) {
+            char *ptr = buffer;
+            /* A line takes 11 bytes at most. */
+            for(; i < num_elems && ptr + 11 <= buffer + CSV_WRITE_BLOCK; i++) {
+                ptr = format_u32_line(ptr, array[i]);
+            }
+            if(fwrite(buffer, 1, (size_t)(ptr - buffer), file_p) != (size_t)(ptr - buffer)) {
+                err_flag = 1;
+            }
+        }
+        free(buffer);
+        if(fclose(file_p) != 0) {
+            err_flag = 1;
+        }
+        return err_flag;
     }
 }
 
@@ -54,84 +1599,101 @@ uint32_t* import_1d_u32(const char *source_file, const char* type, uint64_t *num
     if(type != NULL && strcmp(type, "csv") == 0) {
         file_type_flag = 1;
     }
-
-    if(file_type_flag == 0) {
-        file_p = fopen(source_file, "rb");
+    if(type != NULL && strcmp(type, "btc") == 0) {
+        return import_btc(source_file, num_elems_read, err_flag);
     }
-    else {
-        file_p = fopen(source_file, "r");
+    if(is_gzip_file(source_file) || !is_regular_file(source_file)) {
+        array_sink sink;
+        sink.array = NULL;
+        sink.num_elems = 0;
+        sink.capacity = 0;
+        if((*err_flag = stream_file_values(source_file, file_type_flag, append_to_array, &sink)) != 0 || 
+           (sink.array == NULL && (sink.array = (uint32_t *)malloc(sizeof(uint32_t))) == NULL)) {
+            *err_flag = (*err_flag != 0) ? *err_flag : 1;
+            free(sink.array);
+            return NULL;
+        }
+        *num_elems_read = sink.num_elems;
+        return sink.array;
     }
+
+    if(file_type_flag == 1) {
+        file_view view;
+        int view_flag = map_file_view(source_file, &view);
+        if(view_flag != 0) {
+            *err_flag = view_flag;
+            return NULL;
+        }
+        uint32_t *array = parse_csv_view(&view, num_elems_read, err_flag);
+        unmap_file_view(&view);
+        return array;
+    }
+
+    file_p = fopen(source_file, "rb");
     if(file_p == NULL) {
         *err_flag = -1;
         return NULL;
     }
-
-    if(file_type_flag == 0) {
-        fseek(file_p, 0, SEEK_END);
-        long file_size = ftell(file_p);
-        rewind(file_p);
-        size_t num_elems_total = file_size / sizeof(uint32_t);
-        uint32_t *array = (uint32_t *)calloc(num_elems_total, sizeof(uint32_t));
-        if(array == NULL) {
-            *err_flag = 1;
-            fclose(file_p);
-            return NULL;
-        }
-        size_t num_elems = fread(array, sizeof(uint32_t), num_elems_total, file_p);
-        *num_elems_read = num_elems;
-        if(num_elems != num_elems_total) {
-            *err_flag = 3;
-            free(array);
-            fclose(file_p);
-            return NULL;
-        }
+    fseek(file_p, 0, SEEK_END);
+    long file_size = ftell(file_p);
+    rewind(file_p);
+    size_t num_elems_total = file_size / sizeof(uint32_t);
+    uint32_t *array = (uint32_t *)calloc(num_elems_total, sizeof(uint32_t));
+    if(array == NULL) {
+        *err_flag = 1;
         fclose(file_p);
-        return array;
+        return NULL;
     }
-    else{
-        size_t i = 0, blocks = 1;
-        char ch;
-        uint32_t *array_tmp = NULL;
-        uint32_t *array = (uint32_t *)calloc(TXT_READ_BLOCK, sizeof(uint32_t));
-        if(array == NULL) {
-            *err_flag = 1;
-            fclose(file_p);
-            return NULL;
-        }
-        while(!feof(file_p)){
-            int scanf_res = fscanf(file_p, "%d%c", array + i, &ch);
-            if(scanf_res < 2) {
-                if(ferror(file_p)){
-                    *err_flag = 5;
-                    free(array);
-                    fclose(file_p);
-                    return NULL;
-                }
-            }
-            if(scanf_res > 0){
-                i++;
-            }
-            if(i % TXT_READ_BLOCK == 0) {
-                blocks++;
-                array_tmp = (uint32_t *)realloc(array, blocks * TXT_READ_BLOCK * sizeof(uint32_t));
-                if(array_tmp == NULL) {
-                    *err_flag = 7;
-                    free(array);
-                    fclose(file_p);
-                    return NULL;
-                }
-                memset(array_tmp + (blocks - 1) * TXT_READ_BLOCK, 0, TXT_READ_BLOCK * sizeof(uint32_t));
-                array = array_tmp;
-            }
-        }
-        fclose(file_p); 
-        *num_elems_read = i;
-        array_tmp = (uint32_t *)realloc(array, i * sizeof(uint32_t));
-        if(array_tmp == NULL) {
-            return array;
-        }
-        else{
-            return array_tmp;
-        }
+    size_t num_elems = fread(array, sizeof(uint32_t), num_elems_total, file_p);
+    *num_elems_read = num_elems;
+    if(num_elems != num_elems_total) {
+        *err_flag = 3;
+        free(array);
+        fclose(file_p);
+        return NULL;
     }
-}
\ No newline at end of file
+    fclose(file_p);
+    return array;
+}
+
+/**
+ * @brief Filter out the unique integers of a file ("bin", "csv" or "btc")
+ *   with a BitTree. The "btc" blocks are decoded straight into the insert
+ *   loop, and "bin" files, pipes and gzip-compressed files (with
+ *   BTAS_WITH_ZLIB defined) are streamed in chunks. A plain "csv" file is
+ *   mapped and parsed in parallel to a full array first, so it takes the
+ *   memory of the whole input.
+ * 
+ * @param [out]
+ *  *num_elems_out is the number of the output unique integers
+ *  *err_flag is for debugging errors:
+ *   -1 failed to open the file, 1 failed to allocate memory, 3 truncated
+ *   file, 5 read error, 7 failed to grow the stem, 9 checksum mismatch, 
+ *   11 invalid btc header or block, 13 gzip input without zlib built in
+ * 
+ * @returns
+ *  The pointer of the allocated output array if succeeded
+ *  NULL if any error happens
+ */
+uint32_t* dedup_file_u32(const char *source_file, const char* type, uint64_t *num_elems_out, int *err_flag) {
+    uint32_t *output_arr = NULL, *final_output_arr = NULL;
+    *num_elems_out = 0;
+    uint64_t num_uniq = dedup_file_core(source_file, type, &output_arr, err_flag);
+    if(*err_flag != 0) {
+        free(output_arr);
+        return NULL;
+    }
+    final_output_arr = (uint32_t *)realloc(output_arr, (num_uniq > 0 ? num_uniq : 1) * sizeof(uint32_t));
+    if(final_output_arr == NULL) {
+        free(output_arr);
+        *err_flag = 1;
+        return NULL;
+    }
+    *num_elems_out = num_uniq;
+    return final_output_arr;
+}
+
+uint64_t dedup_file_u32_count(const char *source_file, const char* type, int *err_flag) {
+    uint64_t num_uniq = dedup_file_core(source_file, type, NULL, err_flag);
+    return (*err_flag != 0) ? 0 : num_uniq;
+}
@@ -12,8 +12,52 @@
 #include <stdint.h>
 
 #define TXT_READ_BLOCK 1048576
+#define CSV_CHUNK_MIN_SIZE 4194304 /* Minimum bytes parsed by a csv thread. */
+#define CSV_WRITE_BLOCK 4194304 /* Bytes formatted before every write. */
+#define CSV_EXPORT_RANGE_MIN 1048576 /* Minimum elems exported by a csv thread. */
+
+/**
+ * The "btc" block-compressed format. All the fields are in the host byte
+ * order, the same as the "bin" format.
+ * 
+ * Header (32 bytes):
+ *   "BTC1" | elem_width (u8) | flags (u8) | block_elems (u16) | 
+ *   num_elems (u64) | checksum (u64, Fletcher-64 of the values) | reserved
+ * Blocks (BTC_BLOCK_ELEMS values, the last one padded):
+ *   codec (u8) | bit_width (u8) | num_elems (u16) | base (u32) | payload
+ * 
+ * The payload holds bit_width * BTC_BLOCK_ELEMS / 32 words. The value i
+ * goes to the lane (i % 4), and each lane is bit-packed in the words 
+ * lane, lane + 4, lane + 8, ..., so 4 values are decoded per SIMD step.
+ * BTC_CODEC_FOR stores (value - base) where base is the block minimum.
+ * BTC_CODEC_DELTA stores (value[i] - value[i - 4]) for sorted blocks, and
+ * value[0~3] - base for the first 4 values.
+ */
+#define BTC_HEADER_SIZE     32
+#define BTC_BLOCK_ELEMS     256
+#define BTC_BLOCK_HEADER    8
+#define BTC_CODEC_FOR       0
+#define BTC_CODEC_DELTA     1
+#define BTC_FLAG_SORTED     0x01
+#define DEDUP_READ_BLOCK    1048576 /* Elems read per block while deduplicating a file. */
+
+/**
+ * Streamed inputs ("bin" or "csv", optionally gzip-compressed) are read by
+ * a reader thread into STREAM_NUM_CHUNKS rotating chunks, which bounds the
+ * memory used ahead of the parse/insert stage. On Linux, plain files are
+ * read through io_uring with all the free chunks in flight (falling back
+ * to a pread thread), so a sequential scan keeps an NVMe queue busy.
+ * 
+ * Define BTAS_WITH_ZLIB (and link with -lz) to read gzip-compressed files.
+ */
+#define STREAM_CHUNK_SIZE   1048576
+#define STREAM_NUM_CHUNKS   8
+#define STREAM_CARRY_SIZE   64
+#define STREAM_DATA_OFFSET  4096 /* Page-aligns chunks, >= STREAM_CARRY_SIZE */
 
 int export_1d_u32(const char *target_file, const char* type, uint32_t *array, uint64_t num_elems);
 uint32_t* import_1d_u32(const char *source_file, const char* type, uint64_t *num_elems_read, int *err_flag);
+uint32_t* dedup_file_u32(const char *source_file, const char* type, uint64_t *num_elems_out, int *err_flag);
+uint64_t dedup_file_u32_count(const char *source_file, const char* type, int *err_flag);
 
 #endif
\ No newline at end of file
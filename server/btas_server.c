@@ -0,0 +1,1167 @@
+/**
+ *
+ * This code is distributed under the license: MIT License
+ * Originally written by Zhenrong WANG
+ * mailto: zhenrongwang@live.com
+ * GitHub: https://github.com/zhenrong-wang
+ *
+ */
+
+/**
+ * btas-server: a RESP (Redis protocol) server holding sets of unsigned
+ * 32-bit integers in streaming BitTrees. It implements the integer-set
+ * subset of the Redis commands:
+ *
+ *   SADD, SISMEMBER, SMISMEMBER, SCARD, DEL, EXISTS, PFADD, PFCOUNT,
+ *   PING, ECHO, FLUSHDB, FLUSHALL, SELECT 0, CLIENT, COMMAND, QUIT,
+ *   MULTI, EXEC, HELLO
+ *
+ * PFADD/PFCOUNT keys are BitTrees too, so PFCOUNT is exact. The arguments
+ * of a command are applied while they arrive, in batches, so a single
+ * command with 100M members (e.g. PFADD key m1 m2 ...) doesn't need to be
+ * buffered. Unlike Redis, a command failing on a bad member keeps the
+ * members applied before it, and the commands of a MULTI run when they are
+ * queued (EXEC returns their replies, DISCARD can't roll them back).
+ *
+ * Every worker thread runs its own epoll loop and accepts connections
+ * from the shared listening socket (EPOLLEXCLUSIVE). Pipelined requests
+ * are answered in order with one write per read.
+ *
+ * Build (from the repository root, Linux only):
+ *   gcc -O3 -Wall server/btas_server.c btas.c data_io.c -lpthread -lm -o btas-server
+ *
+ * Run: ./btas-server [--port=6379] [--bind=127.0.0.1] [--threads=N]
+ */
+#if !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "../btas.h"
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+#define SERVER_DEFAULT_PORT     6379
+#define SERVER_BACKLOG          511
+#define SERVER_MAX_EVENTS       64
+#define SERVER_READ_SIZE        1048576     /* Initial (and minimum) input buffer */
+#define SERVER_MAX_BULK         536870912   /* 512 MiB, as Redis */
+#define SERVER_MAX_INLINE       65536
+#define SERVER_BATCH            4096        /* Members applied per lock */
+#define KEYSPACE_INIT_BUCKETS   1024
+
+#define KEY_TYPE_SET    0
+#define KEY_TYPE_HLL    1
+
+#define CMD_UNKNOWN     0
+#define CMD_PING        1
+#define CMD_ECHO        2
+#define CMD_SADD        3
+#define CMD_SISMEMBER   4
+#define CMD_SMISMEMBER  5
+#define CMD_SCARD       6
+#define CMD_DEL         7
+#define CMD_EXISTS      8
+#define CMD_PFADD       9
+#define CMD_PFCOUNT     10
+#define CMD_FLUSHALL    11
+#define CMD_SELECT      12
+#define CMD_CLIENT      13
+#define CMD_COMMAND     14
+#define CMD_QUIT        15
+#define CMD_MULTI       16
+#define CMD_EXEC        17
+#define CMD_DISCARD     18
+#define CMD_HELLO       19
+
+#define ERR_WRONGTYPE   "WRONGTYPE Operation against a key holding the wrong kind of value"
+#define ERR_NOT_U32     "ERR value is not an unsigned 32-bit integer"
+#define ERR_OOM         "OOM command not allowed when used memory > 'maxmemory'"
+
+typedef struct {
+    const char *name;
+    int id;
+    int64_t min_args;   /* Including the command name */
+    int64_t max_args;   /* -1 - unlimited */
+} server_command;
+
+static const server_command server_commands[] = {
+    {"PING", CMD_PING, 1, 2},
+    {"ECHO", CMD_ECHO, 2, 2},
+    {"SADD", CMD_SADD, 3, -1},
+    {"SISMEMBER", CMD_SISMEMBER, 3, 3},
+    {"SMISMEMBER", CMD_SMISMEMBER, 3, -1},
+    {"SCARD", CMD_SCARD, 2, 2},
+    {"DEL", CMD_DEL, 2, -1},
+    {"UNLINK", CMD_DEL, 2, -1},
+    {"EXISTS", CMD_EXISTS, 2, -1},
+    {"PFADD", CMD_PFADD, 2, -1},
+    {"PFCOUNT", CMD_PFCOUNT, 2, -1},
+    {"FLUSHALL", CMD_FLUSHALL, 1, 2},
+    {"FLUSHDB", CMD_FLUSHALL, 1, 2},
+    {"SELECT", CMD_SELECT, 2, 2},
+    {"CLIENT", CMD_CLIENT, 2, -1},
+    {"COMMAND", CMD_COMMAND, 1, -1},
+    {"QUIT", CMD_QUIT, 1, 1},
+    {"MULTI", CMD_MULTI, 1, 1},
+    {"EXEC", CMD_EXEC, 1, 1},
+    {"DISCARD", CMD_DISCARD, 1, 1},
+    {"HELLO", CMD_HELLO, 1, -1},
+};
+
+#define NUM_SERVER_COMMANDS (sizeof(server_commands) / sizeof(server_command))
+
+/* A key of the keyspace. Users hold the keyspace read lock while using it. */
+typedef struct key_entry {
+    char *name;
+    size_t name_len;
+    uint64_t hash;
+    int type;
+    bitmap_tree tree;
+    pthread_rwlock_t lock;
+    struct key_entry *next;
+} key_entry;
+
+typedef struct {
+    key_entry **buckets;
+    size_t num_buckets;
+    size_t num_keys;
+    pthread_rwlock_t lock;  /* Write-locked to add or remove keys */
+} keyspace;
+
+typedef struct {
+    int fd;
+    char *in_buf;
+    size_t in_cap;
+    size_t in_len;
+    size_t in_pos;
+    char *out_buf;
+    size_t out_cap;
+    size_t out_len;
+    size_t out_sent;
+    int closing;                /* Close once the output is sent */
+    /* The command being received */
+    int64_t args_total;         /* 0 - waiting for a new command */
+    int64_t args_done;
+    const server_command *cmd;
+    char *key;
+    size_t key_len;
+    size_t key_cap;
+    char *key_list;             /* PFCOUNT keys: (u32 length, bytes)... */
+    size_t key_list_len;
+    size_t key_list_cap;
+    uint32_t batch[SERVER_BATCH];
+    uint32_t batch_len;
+    uint64_t result;
+    const char *error;          /* The error reply of a failed command */
+    /* MULTI: commands run when queued, their replies are held for EXEC */
+    int in_multi;
+    int to_multi;               /* Replies of this command go to multi_buf */
+    uint64_t multi_count;
+    char *multi_buf;
+    size_t multi_cap;
+    size_t multi_len;
+} client;
+
+typedef struct {
+    int listen_fd;
+} worker_arg;
+
+static keyspace server_keys;
+
+static uint64_t hash_key(const char *name, size_t name_len) {
+    uint64_t hash = 14695981039346656037ULL; /* FNV-1a */
+    for(size_t i = 0; i < name_len; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int keyspace_init(keyspace *keys) {
+    keys->buckets = (key_entry **)calloc(KEYSPACE_INIT_BUCKETS, sizeof(key_entry *));
+    if(keys->buckets == NULL) {
+        return 5;
+    }
+    keys->num_buckets = KEYSPACE_INIT_BUCKETS;
+    keys->num_keys = 0;
+    pthread_rwlock_init(&keys->lock, NULL);
+    return 0;
+}
+
+/* Find a key. The caller holds the keyspace lock. */
+static key_entry* keyspace_find(const keyspace *keys, const char *name, size_t name_len) {
+    uint64_t hash = hash_key(name, name_len);
+    key_entry *entry = keys->buckets[hash & (keys->num_buckets - 1)];
+    for(; entry != NULL; entry = entry->next) {
+        if(entry->hash == hash && entry->name_len == name_len && memcmp(entry->name, name, name_len) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static void key_entry_free(key_entry *entry) {
+    bitmap_tree_free(&entry->tree);
+    pthread_rwlock_destroy(&entry->lock);
+    free(entry->name);
+    free(entry);
+}
+
+/* Double the buckets if the keys outnumber them. The caller write-locks. */
+static void keyspace_grow(keyspace *keys) {
+    size_t new_size = keys->num_buckets * 2;
+    key_entry **new_buckets = (key_entry **)calloc(new_size, sizeof(key_entry *));
+    if(new_buckets == NULL) {
+        return; /* Keep the chains longer */
+    }
+    for(size_t i = 0; i < keys->num_buckets; i++) {
+        key_entry *entry = keys->buckets[i], *next = NULL;
+        for(; entry != NULL; entry = next) {
+            next = entry->next;
+            entry->next = new_buckets[entry->hash & (new_size - 1)];
+            new_buckets[entry->hash & (new_size - 1)] = entry;
+        }
+    }
+    free(keys->buckets);
+    keys->buckets = new_buckets;
+    keys->num_buckets = new_size;
+}
+
+/* Add a key. The caller write-locks the keyspace. */
+static key_entry* keyspace_add(keyspace *keys, const char *name, size_t name_len, int type) {
+    key_entry *entry = (key_entry *)calloc(1, sizeof(key_entry));
+    if(entry == NULL) {
+        return NULL;
+    }
+    if((entry->name = (char *)malloc(name_len + 1)) == NULL || bitmap_tree_init(&entry->tree) != 0) {
+        free(entry->name);
+        free(entry);
+        return NULL;
+    }
+    memcpy(entry->name, name, name_len);
+    entry->name[name_len] = '\0';
+    entry->name_len = name_len;
+    entry->hash = hash_key(name, name_len);
+    entry->type = type;
+    pthread_rwlock_init(&entry->lock, NULL);
+    if(keys->num_keys >= keys->num_buckets) {
+        keyspace_grow(keys);
+    }
+    entry->next = keys->buckets[entry->hash & (keys->num_buckets - 1)];
+    keys->buckets[entry->hash & (keys->num_buckets - 1)] = entry;
+    keys->num_keys++;
+    return entry;
+}
+
+/**
+ * @brief Look up (and optionally create) a key, and return with the
+ *   keyspace read-locked. Release it with keyspace_release().
+ *
+ * @returns
+ *   0 if succeeded (*entry is NULL if the key doesn't exist and !create)
+ *   1 if the key holds another type (*entry is set)
+ *   5 if failed to create the key
+ */
+static int keyspace_acquire(keyspace *keys, const char *name, size_t name_len, int type, int create, key_entry **entry, int *created) {
+    if(created != NULL) {
+        *created = 0;
+    }
+    for(;;) {
+        pthread_rwlock_rdlock(&keys->lock);
+        *entry = keyspace_find(keys, name, name_len);
+        if(*entry != NULL) {
+            return ((*entry)->type == type) ? 0 : 1;
+        }
+        if(!create) {
+            return 0;
+        }
+        pthread_rwlock_unlock(&keys->lock);
+        pthread_rwlock_wrlock(&keys->lock);
+        if(keyspace_find(keys, name, name_len) == NULL) {
+            if(keyspace_add(keys, name, name_len, type) == NULL) {
+                pthread_rwlock_unlock(&keys->lock);
+                pthread_rwlock_rdlock(&keys->lock);
+                return 5;
+            }
+            if(created != NULL) {
+                *created = 1;
+            }
+        }
+        pthread_rwlock_unlock(&keys->lock);
+    }
+}
+
+static void keyspace_release(keyspace *keys) {
+    pthread_rwlock_unlock(&keys->lock);
+}
+
+static int keyspace_delete(keyspace *keys, const char *name, size_t name_len) {
+    uint64_t hash = hash_key(name, name_len);
+    int deleted = 0;
+    pthread_rwlock_wrlock(&keys->lock);
+    key_entry **link = &keys->buckets[hash & (keys->num_buckets - 1)];
+    for(; *link != NULL; link = &(*link)->next) {
+        key_entry *entry = *link;
+        if(entry->hash == hash && entry->name_len == name_len && memcmp(entry->name, name, name_len) == 0) {
+            *link = entry->next;
+            key_entry_free(entry);
+            keys->num_keys--;
+            deleted = 1;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&keys->lock);
+    return deleted;
+}
+
+static void keyspace_flush(keyspace *keys) {
+    pthread_rwlock_wrlock(&keys->lock);
+    for(size_t i = 0; i < keys->num_buckets; i++) {
+        key_entry *entry = keys->buckets[i], *next = NULL;
+        for(; entry != NULL; entry = next) {
+            next = entry->next;
+            key_entry_free(entry);
+        }
+        keys->buckets[i] = NULL;
+    }
+    keys->num_keys = 0;
+    pthread_rwlock_unlock(&keys->lock);
+}
+
+static uint64_t popcount_bytes(const uint8_t *bytes, size_t num_bytes) {
+    uint64_t count = 0, word;
+    for(size_t i = 0; i + 8 <= num_bytes; i += 8) {
+        memcpy(&word, bytes + i, sizeof(uint64_t));
+#if defined(__GNUC__) || defined(__clang__)
+        count += (uint64_t)__builtin_popcountll(word);
+#else
+        for(; word != 0; word &= word - 1) {
+            count++;
+        }
+#endif
+    }
+    return count;
+}
+
+/* Cardinality of the union of the trees (read-locked by the caller). */
+static uint64_t union_count(key_entry **entries, size_t num_entries) {
+    uint8_t merged[BITMAP_BRANCH_SIZE];
+    uint64_t count = 0;
+    if(num_entries == 1) {
+        return entries[0]->tree.num_elems;
+    }
+    for(uint32_t h16 = 0; h16 < BITMAP_LENGTH_MAX; h16++) {
+        int has_branch = 0;
+        for(size_t i = 0; i < num_entries; i++) {
+            const bitmap_tree *tree = &entries[i]->tree;
+            if(h16 >= tree->bitmap_base_size || tree->bitmap_head[h16].ptr_branch == NULL) {
+                continue;
+            }
+            if(!has_branch) {
+                memcpy(merged, tree->bitmap_head[h16].ptr_branch, BITMAP_BRANCH_SIZE);
+                has_branch = 1;
+                continue;
+            }
+            for(uint32_t j = 0; j < BITMAP_BRANCH_SIZE; j++) {
+                merged[j] |= tree->bitmap_head[h16].ptr_branch[j];
+            }
+        }
+        if(has_branch) {
+            count += popcount_bytes(merged, BITMAP_BRANCH_SIZE);
+        }
+    }
+    return count;
+}
+
+/* Grow a buffer to hold at least needed bytes. */
+static int reserve_buf(char **buf, size_t *cap, size_t needed) {
+    if(needed <= *cap) {
+        return 0;
+    }
+    size_t new_cap = (*cap == 0) ? 256 : *cap;
+    while(new_cap < needed) {
+        new_cap *= 2;
+    }
+    char *tmp_realloc = (char *)realloc(*buf, new_cap);
+    if(tmp_realloc == NULL) {
+        return -1;
+    }
+    *buf = tmp_realloc;
+    *cap = new_cap;
+    return 0;
+}
+
+static void reply_append(client *c, const char *data, size_t len) {
+    char **buf = c->to_multi ? &c->multi_buf : &c->out_buf;
+    size_t *cap = c->to_multi ? &c->multi_cap : &c->out_cap;
+    size_t *buf_len = c->to_multi ? &c->multi_len : &c->out_len;
+    if(reserve_buf(buf, cap, *buf_len + len) != 0) {
+        c->closing = 1; /* Out of memory: drop the connection */
+        return;
+    }
+    memcpy(*buf + *buf_len, data, len);
+    *buf_len += len;
+}
+
+static void reply_format(client *c, const char *prefix, uint64_t value) {
+    char line[32];
+    int len = snprintf(line, sizeof(line), "%s%" PRIu64 "\r\n", prefix, value);
+    reply_append(c, line, (size_t)len);
+}
+
+static void reply_int(client *c, uint64_t value) {
+    reply_format(c, ":", value);
+}
+
+static void reply_simple(client *c, const char *text) {
+    reply_append(c, "+", 1);
+    reply_append(c, text, strlen(text));
+    reply_append(c, "\r\n", 2);
+}
+
+static void reply_error(client *c, const char *text) {
+    reply_append(c, "-", 1);
+    reply_append(c, text, strlen(text));
+    reply_append(c, "\r\n", 2);
+}
+
+static void reply_bulk(client *c, const char *data, size_t len) {
+    reply_format(c, "$", len);
+    reply_append(c, data, len);
+    reply_append(c, "\r\n", 2);
+}
+
+static int parse_member(const char *arg, size_t len, uint32_t *member) {
+    uint64_t value = 0;
+    if(len == 0 || len > 10) {
+        return -1;
+    }
+    for(size_t i = 0; i < len; i++) {
+        if(arg[i] < '0' || arg[i] > '9') {
+            return -1;
+        }
+        value = value * 10 + (uint64_t)(arg[i] - '0');
+    }
+    if(value > UINT32_MAX) {
+        return -1;
+    }
+    *member = (uint32_t)value;
+    return 0;
+}
+
+/* Apply the batched members of SADD, PFADD or SMISMEMBER/SISMEMBER. */
+static void command_flush(client *c) {
+    key_entry *entry = NULL;
+    int created = 0, err_flag = 0;
+    int is_add = (c->cmd->id == CMD_SADD || c->cmd->id == CMD_PFADD);
+    int type = (c->cmd->id == CMD_PFADD) ? KEY_TYPE_HLL : KEY_TYPE_SET;
+    if(c->error != NULL || (c->batch_len == 0 && c->cmd->id != CMD_PFADD)) {
+        c->batch_len = 0;
+        return;
+    }
+    int acquire_flag = keyspace_acquire(&server_keys, c->key, c->key_len, type, is_add, &entry, &created);
+    if(acquire_flag != 0) {
+        keyspace_release(&server_keys);
+        if(c->cmd->id == CMD_SMISMEMBER) {
+            for(uint32_t i = 0; i < c->batch_len; i++) {
+                reply_error(c, (acquire_flag == 1) ? ERR_WRONGTYPE : ERR_OOM);
+            }
+        }
+        c->error = (acquire_flag == 1) ? ERR_WRONGTYPE : ERR_OOM;
+        c->batch_len = 0;
+        return;
+    }
+    if(is_add) {
+        pthread_rwlock_wrlock(&entry->lock);
+        uint64_t num_new = bitmap_tree_insert_arr(&entry->tree, c->batch, c->batch_len, NULL, &err_flag);
+        pthread_rwlock_unlock(&entry->lock);
+        if(c->cmd->id == CMD_PFADD) {
+            c->result |= (uint64_t)(num_new != 0 || created);
+        }
+        else {
+            c->result += num_new;
+        }
+        if(err_flag != 0) {
+            c->error = ERR_OOM;
+        }
+    }
+    else {
+        if(entry != NULL) {
+            pthread_rwlock_rdlock(&entry->lock);
+        }
+        for(uint32_t i = 0; i < c->batch_len; i++) {
+            int found = (entry != NULL) && bitmap_tree_contains(&entry->tree, c->batch[i]);
+            if(c->cmd->id == CMD_SMISMEMBER) {
+                reply_int(c, (uint64_t)found);
+            }
+            else {
+                c->result = (uint64_t)found;
+            }
+        }
+        if(entry != NULL) {
+            pthread_rwlock_unlock(&entry->lock);
+        }
+    }
+    keyspace_release(&server_keys);
+    c->batch_len = 0;
+}
+
+static void command_begin(client *c, int64_t num_args) {
+    c->args_total = num_args;
+    c->args_done = 0;
+    c->cmd = NULL;
+    c->key_len = 0;
+    c->key_list_len = 0;
+    c->batch_len = 0;
+    c->result = 0;
+    c->error = NULL;
+    c->to_multi = c->in_multi;
+}
+
+/* MULTI, EXEC and DISCARD. */
+static void command_multi(client *c) {
+    switch(c->cmd->id) {
+    case CMD_MULTI:
+        if(c->in_multi) {
+            reply_error(c, "ERR MULTI calls can not be nested");
+            break;
+        }
+        c->in_multi = 1;
+        c->multi_count = 0;
+        c->multi_len = 0;
+        reply_simple(c, "OK");
+        break;
+    case CMD_EXEC:
+        if(!c->in_multi) {
+            reply_error(c, "ERR EXEC without MULTI");
+            break;
+        }
+        reply_format(c, "*", c->multi_count);
+        reply_append(c, c->multi_buf, c->multi_len);
+        c->in_multi = 0;
+        break;
+    default:
+        /* The queued commands have run already, so they can't be undone. */
+        if(!c->in_multi) {
+            reply_error(c, "ERR DISCARD without MULTI");
+            break;
+        }
+        c->in_multi = 0;
+        reply_error(c, "ERR DISCARD is not supported: queued commands run when queued");
+        break;
+    }
+}
+
+/* Run the rest of a command whose arguments are all received, and reply. */
+static void command_run(client *c) {
+    const server_command *cmd = c->cmd;
+    if(cmd == NULL) {
+        return; /* Replied already (unknown command or wrong arity) */
+    }
+    if(cmd->id == CMD_SADD || cmd->id == CMD_PFADD || cmd->id == CMD_SISMEMBER || cmd->id == CMD_SMISMEMBER) {
+        command_flush(c);
+    }
+    if(cmd->id == CMD_SMISMEMBER) {
+        return; /* The elements are replied by the flushes */
+    }
+    if(c->error != NULL) {
+        reply_error(c, c->error);
+        return;
+    }
+    switch(cmd->id) {
+    case CMD_PING:
+        if(c->args_done == 1) {
+            reply_simple(c, "PONG");
+        }
+        else {
+            reply_bulk(c, c->key, c->key_len);
+        }
+        break;
+    case CMD_ECHO:
+        reply_bulk(c, c->key, c->key_len);
+        break;
+    case CMD_SCARD: {
+        key_entry *entry = NULL;
+        int acquire_flag = keyspace_acquire(&server_keys, c->key, c->key_len, KEY_TYPE_SET, 0, &entry, NULL);
+        uint64_t num_elems = 0;
+        if(acquire_flag == 0 && entry != NULL) {
+            pthread_rwlock_rdlock(&entry->lock);
+            num_elems = entry->tree.num_elems;
+            pthread_rwlock_unlock(&entry->lock);
+        }
+        keyspace_release(&server_keys);
+        if(acquire_flag != 0) {
+            reply_error(c, ERR_WRONGTYPE);
+        }
+        else {
+            reply_int(c, num_elems);
+        }
+        break;
+    }
+    case CMD_PFCOUNT: {
+        key_entry *entries[64];
+        key_entry **entry_list = entries;
+        size_t num_entries = 0, max_entries = (size_t)(c->args_done - 1);
+        const char *wrong_type = NULL;
+        if(max_entries > 64 && (entry_list = (key_entry **)malloc(max_entries * sizeof(key_entry *))) == NULL) {
+            reply_error(c, ERR_OOM);
+            break;
+        }
+        pthread_rwlock_rdlock(&server_keys.lock);
+        for(size_t pos = 0; pos < c->key_list_len; ) {
+            uint32_t name_len;
+            memcpy(&name_len, c->key_list + pos, sizeof(uint32_t));
+            key_entry *entry = keyspace_find(&server_keys, c->key_list + pos + sizeof(uint32_t), name_len);
+            pos += sizeof(uint32_t) + name_len;
+            if(entry == NULL) {
+                continue;
+            }
+            if(entry->type != KEY_TYPE_HLL) {
+                wrong_type = ERR_WRONGTYPE;
+                break;
+            }
+            int is_dup = 0;
+            for(size_t i = 0; i < num_entries && !is_dup; i++) {
+                is_dup = (entry_list[i] == entry);
+            }
+            if(!is_dup) {
+                entry_list[num_entries++] = entry;
+            }
+        }
+        uint64_t count = 0;
+        if(wrong_type == NULL && num_entries != 0) {
+            for(size_t i = 0; i < num_entries; i++) {
+                pthread_rwlock_rdlock(&entry_list[i]->lock);
+            }
+            count = union_count(entry_list, num_entries);
+            for(size_t i = 0; i < num_entries; i++) {
+                pthread_rwlock_unlock(&entry_list[i]->lock);
+            }
+        }
+        pthread_rwlock_unlock(&server_keys.lock);
+        if(entry_list != entries) {
+            free(entry_list);
+        }
+        if(wrong_type != NULL) {
+            reply_error(c, wrong_type);
+        }
+        else {
+            reply_int(c, count);
+        }
+        break;
+    }
+    case CMD_FLUSHALL:
+        keyspace_flush(&server_keys);
+        reply_simple(c, "OK");
+        break;
+    case CMD_SELECT:
+        if(c->key_len == 1 && c->key[0] == '0') {
+            reply_simple(c, "OK");
+        }
+        else {
+            reply_error(c, "ERR DB index is out of range");
+        }
+        break;
+    case CMD_CLIENT:
+        reply_simple(c, "OK");
+        break;
+    case CMD_COMMAND:
+        reply_append(c, "*0\r\n", 4);
+        break;
+    case CMD_HELLO:
+        /* The replies of this subset are the same in RESP2 and RESP3. */
+        if(c->key_len == 0 || (c->key_len == 1 && (c->key[0] == '2' || c->key[0] == '3'))) {
+            reply_append(c, (c->key_len == 1 && c->key[0] == '3') ? "%3\r\n" : "*6\r\n", 4);
+            reply_bulk(c, "server", 6);
+            reply_bulk(c, "btas", 4);
+            reply_bulk(c, "version", 7);
+            reply_bulk(c, "1.0.0", 5);
+            reply_bulk(c, "proto", 5);
+            reply_int(c, (c->key_len == 1 && c->key[0] == '3') ? 3 : 2);
+        }
+        else {
+            reply_error(c, "NOPROTO unsupported protocol version");
+        }
+        break;
+    case CMD_QUIT:
+        reply_simple(c, "OK");
+        c->closing = 1;
+        break;
+    case CMD_MULTI:
+    case CMD_EXEC:
+    case CMD_DISCARD:
+        command_multi(c);
+        break;
+    default:
+        reply_int(c, c->result); /* SADD, SISMEMBER, DEL, EXISTS, PFADD */
+        break;
+    }
+}
+
+static void command_finish(client *c) {
+    c->args_total = 0;
+    command_run(c);
+    if(c->to_multi) {
+        c->to_multi = 0;
+        c->multi_count++;
+        reply_simple(c, "QUEUED");
+    }
+}
+
+static void command_name(client *c, const char *arg, size_t len) {
+    char name[16];
+    if(len < sizeof(name)) {
+        for(size_t i = 0; i < len; i++) {
+            name[i] = (char)toupper((unsigned char)arg[i]);
+        }
+        name[len] = '\0';
+        for(size_t i = 0; i < NUM_SERVER_COMMANDS; i++) {
+            if(strcmp(name, server_commands[i].name) == 0) {
+                c->cmd = &server_commands[i];
+                break;
+            }
+        }
+    }
+    if(c->cmd != NULL && (c->cmd->id == CMD_MULTI || c->cmd->id == CMD_EXEC || c->cmd->id == CMD_DISCARD)) {
+        c->to_multi = 0;
+    }
+    if(c->cmd == NULL) {
+        char error[96];
+        snprintf(error, sizeof(error), "ERR unknown command '%.*s'", (int)((len < 32) ? len : 32), arg);
+        reply_error(c, error);
+        return;
+    }
+    if(c->args_total < c->cmd->min_args || (c->cmd->max_args > 0 && c->args_total > c->cmd->max_args)) {
+        char error[96];
+        snprintf(error, sizeof(error), "ERR wrong number of arguments for '%s' command", c->cmd->name);
+        reply_error(c, error);
+        c->cmd = NULL;
+    }
+}
+
+/* Handle an argument of the command being received. */
+static void command_arg(client *c, const char *arg, size_t len) {
+    int64_t index = c->args_done++;
+    uint32_t member = 0;
+    if(index == 0) {
+        command_name(c, arg, len);
+    }
+    else if(c->cmd == NULL || c->error != NULL) {
+        /* Skip the rest of a failed command */
+    }
+    else if(c->cmd->id == CMD_DEL || c->cmd->id == CMD_EXISTS) {
+        if(c->cmd->id == CMD_DEL) {
+            c->result += (uint64_t)keyspace_delete(&server_keys, arg, len);
+        }
+        else {
+            key_entry *entry = NULL;
+            keyspace_acquire(&server_keys, arg, len, KEY_TYPE_SET, 0, &entry, NULL);
+            c->result += (entry != NULL);
+            keyspace_release(&server_keys);
+        }
+    }
+    else if(c->cmd->id == CMD_PFCOUNT) {
+        uint32_t name_len = (uint32_t)len;
+        if(reserve_buf(&c->key_list, &c->key_list_cap, c->key_list_len + sizeof(uint32_t) + len) != 0) {
+            c->error = ERR_OOM;
+            return;
+        }
+        memcpy(c->key_list + c->key_list_len, &name_len, sizeof(uint32_t));
+        memcpy(c->key_list + c->key_list_len + sizeof(uint32_t), arg, len);
+        c->key_list_len += sizeof(uint32_t) + len;
+    }
+    else if(index == 1) {
+        /* The key (or the message of PING/ECHO, the db of SELECT, ...) */
+        if(reserve_buf(&c->key, &c->key_cap, len + 1) != 0) {
+            c->error = ERR_OOM;
+            return;
+        }
+        memcpy(c->key, arg, len);
+        c->key_len = len;
+        if(c->cmd->id == CMD_SMISMEMBER) {
+            key_entry *entry = NULL;
+            int acquire_flag = keyspace_acquire(&server_keys, arg, len, KEY_TYPE_SET, 0, &entry, NULL);
+            keyspace_release(&server_keys);
+            if(acquire_flag != 0) {
+                c->error = ERR_WRONGTYPE;
+                reply_error(c, ERR_WRONGTYPE);
+                c->cmd = NULL;
+                return;
+            }
+            reply_format(c, "*", (uint64_t)(c->args_total - 2));
+        }
+    }
+    else if(c->cmd->id == CMD_SADD || c->cmd->id == CMD_PFADD || c->cmd->id == CMD_SISMEMBER || c->cmd->id == CMD_SMISMEMBER) {
+        if(parse_member(arg, len, &member) != 0) {
+            command_flush(c);
+            if(c->cmd->id == CMD_SMISMEMBER) {
+                reply_error(c, ERR_NOT_U32);
+            }
+            else {
+                c->error = ERR_NOT_U32;
+            }
+            return;
+        }
+        c->batch[c->batch_len++] = member;
+        if(c->batch_len == SERVER_BATCH) {
+            command_flush(c);
+        }
+    }
+}
+
+/**
+ * @brief Parse and run the complete commands (RESP arrays of bulk strings
+ *   or inline commands) of the input buffer.
+ *
+ * @returns
+ *   0 if the input is consumed (a partial command may remain)
+ *  -1 if a protocol error occurred
+ */
+static int client_process(client *c) {
+    while(c->in_pos < c->in_len && !c->closing) {
+        char *ptr = c->in_buf + c->in_pos;
+        size_t avail = c->in_len - c->in_pos;
+        char *line_end = (char *)memchr(ptr, '\n', (avail < SERVER_MAX_INLINE) ? avail : SERVER_MAX_INLINE);
+        if(line_end == NULL) {
+            return (avail >= SERVER_MAX_INLINE) ? -1 : 0;
+        }
+        size_t line_len = (size_t)(line_end - ptr) + 1;
+        if(c->args_total == 0 && ptr[0] == '*') {
+            int64_t num_args = strtoll(ptr + 1, NULL, 10);
+            c->in_pos += line_len;
+            if(num_args > 0) {
+                command_begin(c, num_args);
+            }
+            continue;
+        }
+        if(c->args_total == 0) {
+            /* Inline command: arguments separated by blanks */
+            int64_t num_args = 0;
+            size_t i = 0;
+            while(i < line_len) {
+                while(i < line_len && isspace((unsigned char)ptr[i])) {
+                    i++;
+                }
+                num_args += (i < line_len);
+                while(i < line_len && !isspace((unsigned char)ptr[i])) {
+                    i++;
+                }
+            }
+            c->in_pos += line_len;
+            if(num_args == 0) {
+                continue;
+            }
+            command_begin(c, num_args);
+            for(i = 0; i < line_len; ) {
+                size_t start;
+                while(i < line_len && isspace((unsigned char)ptr[i])) {
+                    i++;
+                }
+                start = i;
+                while(i < line_len && !isspace((unsigned char)ptr[i])) {
+                    i++;
+                }
+                if(i > start) {
+                    command_arg(c, ptr + start, i - start);
+                }
+            }
+            command_finish(c);
+            continue;
+        }
+        if(ptr[0] != '$') {
+            return -1;
+        }
+        int64_t bulk_len = strtoll(ptr + 1, NULL, 10);
+        if(bulk_len < 0 || bulk_len > SERVER_MAX_BULK) {
+            return -1;
+        }
+        if(avail < line_len + (size_t)bulk_len + 2) {
+            /* Wait for the whole bulk string, making room for it. */
+            if(c->in_pos > 0) {
+                memmove(c->in_buf, c->in_buf + c->in_pos, avail);
+                c->in_len = avail;
+                c->in_pos = 0;
+            }
+            return reserve_buf(&c->in_buf, &c->in_cap, line_len + (size_t)bulk_len + 2);
+        }
+        command_arg(c, ptr + line_len, (size_t)bulk_len);
+        c->in_pos += line_len + (size_t)bulk_len + 2;
+        if(c->args_done == c->args_total) {
+            command_finish(c);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Send the pending output.
+ *
+ * @returns
+ *   0 if all sent
+ *   1 if the socket is full (wait for EPOLLOUT)
+ *  -1 if the connection failed
+ */
+static int client_flush(client *c) {
+    while(c->out_sent < c->out_len) {
+        ssize_t num_sent = send(c->fd, c->out_buf + c->out_sent, c->out_len - c->out_sent, MSG_NOSIGNAL);
+        if(num_sent < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : -1;
+        }
+        c->out_sent += (size_t)num_sent;
+    }
+    c->out_len = 0;
+    c->out_sent = 0;
+    return 0;
+}
+
+static void client_free(client *c) {
+    close(c->fd);
+    free(c->in_buf);
+    free(c->out_buf);
+    free(c->key);
+    free(c->key_list);
+    free(c->multi_buf);
+    free(c);
+}
+
+/**
+ * @brief Read what's available, run the commands and send the replies.
+ *
+ * @returns
+ *   0 if the connection stays open
+ *  -1 if it is closed
+ */
+static int client_on_readable(client *c) {
+    for(;;) {
+        if(c->in_len == c->in_cap && reserve_buf(&c->in_buf, &c->in_cap, c->in_cap * 2) != 0) {
+            return -1;
+        }
+        ssize_t num_read = recv(c->fd, c->in_buf + c->in_len, c->in_cap - c->in_len, 0);
+        if(num_read == 0) {
+            return -1;
+        }
+        if(num_read < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+        }
+        c->in_len += (size_t)num_read;
+        if(client_process(c) != 0) {
+            reply_error(c, "ERR Protocol error");
+            c->closing = 1;
+        }
+        if(c->in_pos == c->in_len) {
+            c->in_pos = 0;
+            c->in_len = 0;
+        }
+        else if(c->in_pos > c->in_cap / 2) {
+            memmove(c->in_buf, c->in_buf + c->in_pos, c->in_len - c->in_pos);
+            c->in_len -= c->in_pos;
+            c->in_pos = 0;
+        }
+        if(client_flush(c) < 0 || (c->closing && c->out_len == 0)) {
+            return -1;
+        }
+        if(c->closing) {
+            return 0;
+        }
+    }
+}
+
+static client* client_new(int fd) {
+    client *c = (client *)calloc(1, sizeof(client));
+    if(c == NULL) {
+        return NULL;
+    }
+    c->fd = fd;
+    if(reserve_buf(&c->in_buf, &c->in_cap, SERVER_READ_SIZE) != 0) {
+        free(c);
+        return NULL;
+    }
+    return c;
+}
+
+static void client_close(int epoll_fd, client *c) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    client_free(c);
+}
+
+static void accept_clients(int epoll_fd, int listen_fd) {
+    for(;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+            return; /* EAGAIN: another worker took it, or no more */
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        client *c = client_new(fd);
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = c;
+        if(c == NULL || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            if(c != NULL) {
+                client_free(c);
+            }
+            else {
+                close(fd);
+            }
+        }
+    }
+}
+
+static void *worker_loop(void *arg) {
+    int listen_fd = ((worker_arg *)arg)->listen_fd;
+    struct epoll_event events[SERVER_MAX_EVENTS], event;
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(epoll_fd < 0) {
+        fprintf(stderr, "btas-server: epoll_create1 failed: %s\n", strerror(errno));
+        return NULL;
+    }
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = NULL;
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) != 0) {
+        fprintf(stderr, "btas-server: failed to watch the listening socket: %s\n", strerror(errno));
+        close(epoll_fd);
+        return NULL;
+    }
+    for(;;) {
+        int num_events = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if(num_events < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for(int i = 0; i < num_events; i++) {
+            client *c = (client *)events[i].data.ptr;
+            if(c == NULL) {
+                accept_clients(epoll_fd, listen_fd);
+                continue;
+            }
+            int state = 0;
+            if(events[i].events & (EPOLLERR | EPOLLHUP)) {
+                state = -1;
+            }
+            if(state == 0 && (events[i].events & EPOLLOUT)) {
+                state = client_flush(c);
+                if(state == 0 && c->closing) {
+                    state = -1;
+                }
+                else if(state > 0) {
+                    state = 0;
+                }
+            }
+            if(state == 0 && (events[i].events & (EPOLLIN | EPOLLRDHUP)) && !c->closing) {
+                state = client_on_readable(c);
+            }
+            if(state < 0) {
+                client_close(epoll_fd, c);
+                continue;
+            }
+            /* Watch for EPOLLOUT only while there is output pending. */
+            memset(&event, 0, sizeof(event));
+            event.events = (c->out_len > c->out_sent) ? (EPOLLOUT | (c->closing ? 0 : (EPOLLIN | EPOLLRDHUP))) : (EPOLLIN | EPOLLRDHUP);
+            event.data.ptr = c;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &event);
+        }
+    }
+    close(epoll_fd);
+    return NULL;
+}
+
+static int open_listener(const char *bind_addr, uint32_t port) {
+    struct sockaddr_in addr;
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if(inet_pton(AF_INET, bind_addr, &addr.sin_addr) != 1) {
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SERVER_BACKLOG) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief
+ *  usage: ./btas-server [--port=6379] [--bind=127.0.0.1] [--threads=N]
+ *
+ * @returns
+ *   1 : illegal options
+ *   3 : failed to listen
+ *   5 : failed to allocate memory
+ *   Otherwise the server runs until killed
+ */
+int main(int argc, char **argv) {
+    uint32_t port = SERVER_DEFAULT_PORT, num_threads = 0;
+    const char *bind_addr = "127.0.0.1";
+    for(int i = 1; i < argc; i++) {
+        if(strncmp(argv[i], "--port=", 7) == 0 && string_to_u32_num(argv[i] + 7, &port) == 0 && port > 0 && port < 65536) {
+            continue;
+        }
+        if(strncmp(argv[i], "--threads=", 10) == 0 && string_to_u32_num(argv[i] + 10, &num_threads) == 0) {
+            continue;
+        }
+        if(strncmp(argv[i], "--bind=", 7) == 0) {
+            bind_addr = argv[i] + 7;
+            continue;
+        }
+        printf("USAGE: %s [--port=6379] [--bind=127.0.0.1] [--threads=N]\n", argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    set_num_threads(num_threads);
+    num_threads = get_num_threads();
+    if(keyspace_init(&server_keys) != 0) {
+        return 5;
+    }
+    int listen_fd = open_listener(bind_addr, port);
+    if(listen_fd < 0) {
+        fprintf(stderr, "btas-server: failed to listen on %s:%u: %s\n", bind_addr, port, strerror(errno));
+        return 3;
+    }
+    worker_arg *args = (worker_arg *)calloc(num_threads, sizeof(worker_arg));
+    if(args == NULL) {
+        close(listen_fd);
+        return 5;
+    }
+    for(uint32_t i = 0; i < num_threads; i++) {
+        args[i].listen_fd = listen_fd;
+    }
+    printf("btas-server listening on %s:%u with %u worker thread(s).\n", bind_addr, port, num_threads);
+    fflush(stdout);
+    run_parallel_tasks(worker_loop, args, sizeof(worker_arg), num_threads);
+    free(args);
+    close(listen_fd);
+    return 0;
+}